@@ -0,0 +1,169 @@
+#include "engine.h"
+#include "window.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+/*
+ * Renders a stack of screen filling opaque quads, and measures the overdraw and frame time with the objects drawn
+ * in scene order (back-to-front, the worst case), sorted front-to-back, and sorted front-to-back with
+ * a depth prepass.
+ *
+ * Should be run from the resources directory, as the shaders are loaded from shaders/.
+ * The frame time includes waiting for the swapchain, so it is limited by the refresh rate when vsync is enforced.
+ *
+ * usage: overdraw_benchmark [--layers n] [--frames n] [--width n] [--height n]
+ */
+
+using namespace engine;
+using namespace engine::renderer;
+
+namespace {
+
+    struct BenchmarkConfiguration {
+        uint32_t layers = 16;
+        uint32_t frames = 300;
+        uint32_t width = 1280;
+        uint32_t height = 720;
+    };
+
+    struct BenchmarkRun {
+        std::string name;
+        bool sortOpaqueObjects;
+        bool depthPrepass;
+    };
+
+    bool parseArguments(int argc, char *argv[], BenchmarkConfiguration &configuration) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string argument = argv[i];
+            auto value = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+            if (argument == "--layers") {
+                configuration.layers = std::max(value, 1u);
+            } else if (argument == "--frames") {
+                configuration.frames = std::max(value, 1u);
+            } else if (argument == "--width") {
+                configuration.width = value;
+            } else if (argument == "--height") {
+                configuration.height = value;
+            } else {
+                std::cerr << "unknown argument: " << argument << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // quads facing the camera at the origin, added farthest first so that scene order is back-to-front
+    void createStackedQuads(Scene &scene, const BenchmarkConfiguration &configuration) {
+        std::vector<VertexAttributes> vertices{
+                {{-1.0f, -1.0f, 0}, {0, 0}, {0, 0, 1}},
+                {{1.0f,  -1.0f, 0}, {1, 0}, {0, 0, 1}},
+                {{1.0f,  1.0f,  0}, {1, 1}, {0, 0, 1}},
+                {{-1.0f, 1.0f,  0}, {0, 1}, {0, 0, 1}}
+        };
+        std::vector<uint32_t> indices{0, 1, 2, 2, 3, 0};
+        scene.meshes.emplace_back(std::make_unique<Mesh>(vertices, indices));
+        Mesh &mesh = *scene.meshes.back();
+
+        const unsigned char pixel[]{255, 255, 255, 255};
+        scene.textures.emplace_back(std::make_unique<Texture>(pixel, 1, 1));
+
+        Shader &shader = scene.createShader("shader_vert.spv", "shader_frag.spv");
+        scene.materials.emplace_back(std::make_unique<Material>(shader, *scene.textures.back(), RenderQueue::Opaque));
+        Material &material = *scene.materials.back();
+
+        // slightly larger than the view frustum (vertical field of view of 60 degrees) at each distance
+        float aspect = static_cast<float>(configuration.width) / static_cast<float>(configuration.height);
+        float halfHeightPerDistance = std::tan(glm::radians(30.0f)) * 1.1f;
+        for (uint32_t i = 0; i < configuration.layers; i++) {
+            float distance = 2.0f + static_cast<float>(configuration.layers - 1 - i) * 0.5f;
+            scene.objects.emplace_back(std::make_unique<Object>("Layer " + std::to_string(i), mesh, material));
+            Object &object = *scene.objects.back();
+            object.localPosition = {0, 0, -distance};
+            object.localScale = {halfHeightPerDistance * distance * aspect, halfHeightPerDistance * distance, 1};
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchmarkConfiguration benchmarkConfiguration;
+    try {
+        if (!parseArguments(argc, argv, benchmarkConfiguration)) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "invalid argument: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        Window window("Overdraw benchmark", static_cast<int>(benchmarkConfiguration.width),
+                      static_cast<int>(benchmarkConfiguration.height));
+
+        EngineConfiguration configuration{
+                .window = window.glfwWindow,
+                .debug = false,
+                .applicationName = "Overdraw benchmark",
+                .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+                .measureOverdraw = true,
+                .createScene = [&](Scene &scene) {
+                    createStackedQuads(scene, benchmarkConfiguration);
+                },
+        };
+        Engine renderingEngine(configuration);
+        renderingEngine.camera->position = {0, 0, 0}; // looking down the negative z axis
+
+        if (!renderingEngine.overdrawCounter) {
+            std::cerr << "overdraw can't be measured on this device" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::vector<BenchmarkRun> runs{
+                {"scene order (back-to-front)", false, false},
+                {"front-to-back", true, false},
+                {"front-to-back with depth prepass", true, true},
+        };
+
+        std::cout << "overdraw benchmark" << std::endl
+                  << "layers: " << benchmarkConfiguration.layers
+                  << ", resolution: " << benchmarkConfiguration.width << "x" << benchmarkConfiguration.height
+                  << ", frames: " << benchmarkConfiguration.frames << std::endl;
+
+        for (const auto &run: runs) {
+            renderingEngine.sortOpaqueObjects = run.sortOpaqueObjects;
+            renderingEngine.depthPrepass = run.depthPrepass;
+
+            // the results are read when a frame slot gets reused, so the first frames report the previous run
+            for (uint32_t i = 0; i < 10; i++) {
+                glfwPollEvents();
+                renderingEngine.render();
+                if (i == 0) {
+                    // the pipelines of the run get queued in the first frame, and are drawn with once created
+                    renderingEngine.pipelineBuilder->waitForPipelines();
+                }
+            }
+
+            double overdraw = 0.0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < benchmarkConfiguration.frames; i++) {
+                glfwPollEvents();
+                renderingEngine.render();
+                overdraw += renderingEngine.overdrawCounter->statistics.overdraw;
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            auto frames = static_cast<double>(benchmarkConfiguration.frames);
+            double frameTime = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+            std::cout << run.name << ": overdraw: " << overdraw / frames
+                      << ", frame time: " << frameTime << " ms" << std::endl;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,471 @@
+#include "engine.h"
+
+#include "glm/gtc/constants.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+
+/*
+ * Renders a procedurally generated scene of spheres headless for a fixed number of frames, and writes the frame
+ * time percentiles, recorded draw commands, pipeline statistics of each pass, memory use and the memory of the
+ * transient render graph images with and without aliasing as JSON, so that runs can be compared between changes.
+ *
+ * The number of objects, meshes and materials can be scaled independently. The overlap is the fraction of the
+ * visible objects that is stacked behind other objects (0 lays them out next to each other, close to 1 stacks them
+ * all on the same spot), and the visible fraction sets how many objects are in front of the camera instead of
+ * behind it.
+ *
+ * With software occlusion culling, the objects of the front layer of the grid are the occluders.
+ *
+ * With occlusion culling, the frames are followed by frames with the culling disabled, so that the gpu time of
+ * drawing everything can be compared with the time of culling and drawing what is visible.
+ *
+ * The last measured frame is read back, its checksum is written to the results, so that a change that should not
+ * affect the image can be checked, and it can be written to a PPM image with --dump.
+ *
+ * Should be run from the resources directory, as the shaders are loaded from shaders/.
+ *
+ * usage: scene_benchmark [--objects n] [--meshes n] [--materials n] [--overlap 0..1] [--visible 0..1]
+ *                        [--frames n] [--warmup n] [--width n] [--height n] [--seed n]
+ *                        [--occlusion-culling 0|1] [--unculled-frames n] [--software-occlusion-culling 0|1]
+ *                        [--cache-command-buffers 0|1] [--output path] [--dump path]
+ */
+
+using namespace engine;
+using namespace engine::renderer;
+
+namespace {
+
+    struct BenchmarkConfiguration {
+        uint32_t objects = 10000;
+        uint32_t meshes = 16;
+        uint32_t materials = 64;
+        float overlap = 0.5f;
+        float visible = 1.0f;
+        uint32_t frames = 1000;
+        uint32_t warmup = 60;
+        uint32_t width = 1280;
+        uint32_t height = 720;
+        uint32_t seed = 1234;
+        bool occlusionCulling = false;
+        uint32_t unculledFrames = 300;
+        bool softwareOcclusionCulling = false;
+        bool cacheCommandBuffers = false;
+        std::string output = "scene_benchmark.json";
+        std::string dump; // not written when empty
+    };
+
+    struct FrameTimes {
+        double mean;
+        double p50;
+        double p90;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    bool parseArguments(int argc, char *argv[], BenchmarkConfiguration &configuration) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string argument = argv[i];
+            std::string value = argv[i + 1];
+            if (argument == "--output") {
+                configuration.output = value;
+            } else if (argument == "--dump") {
+                configuration.dump = value;
+            } else if (argument == "--overlap") {
+                configuration.overlap = std::clamp(std::stof(value), 0.0f, 1.0f);
+            } else if (argument == "--visible") {
+                configuration.visible = std::clamp(std::stof(value), 0.0f, 1.0f);
+            } else if (argument == "--objects") {
+                configuration.objects = static_cast<uint32_t>(std::stoul(value));
+            } else if (argument == "--meshes") {
+                configuration.meshes = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+            } else if (argument == "--materials") {
+                configuration.materials = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+            } else if (argument == "--frames") {
+                configuration.frames = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+            } else if (argument == "--warmup") {
+                configuration.warmup = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+            } else if (argument == "--width") {
+                configuration.width = static_cast<uint32_t>(std::stoul(value));
+            } else if (argument == "--height") {
+                configuration.height = static_cast<uint32_t>(std::stoul(value));
+            } else if (argument == "--seed") {
+                configuration.seed = static_cast<uint32_t>(std::stoul(value));
+            } else if (argument == "--occlusion-culling") {
+                configuration.occlusionCulling = std::stoul(value) != 0;
+            } else if (argument == "--unculled-frames") {
+                configuration.unculledFrames = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+            } else if (argument == "--software-occlusion-culling") {
+                configuration.softwareOcclusionCulling = std::stoul(value) != 0;
+            } else if (argument == "--cache-command-buffers") {
+                configuration.cacheCommandBuffers = std::stoul(value) != 0;
+            } else {
+                std::cerr << "unknown argument: " << argument << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // unit sphere, counter-clockwise when looking at it from the outside
+    std::unique_ptr<Mesh> createSphere(uint32_t rings, uint32_t segments) {
+        std::vector<VertexAttributes> vertices;
+        std::vector<uint32_t> indices;
+        for (uint32_t ring = 0; ring <= rings; ring++) {
+            float phi = glm::pi<float>() * static_cast<float>(ring) / static_cast<float>(rings);
+            for (uint32_t segment = 0; segment <= segments; segment++) {
+                float theta = 2.0f * glm::pi<float>() * static_cast<float>(segment) / static_cast<float>(segments);
+                glm::vec3 position{std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)};
+                glm::vec2 uv{static_cast<float>(segment) / static_cast<float>(segments),
+                             static_cast<float>(ring) / static_cast<float>(rings)};
+                vertices.push_back({position, uv, position});
+            }
+        }
+        for (uint32_t ring = 0; ring < rings; ring++) {
+            for (uint32_t segment = 0; segment < segments; segment++) {
+                uint32_t a = ring * (segments + 1) + segment; // top left
+                uint32_t b = a + segments + 1; // bottom left
+                indices.insert(indices.end(), {a, b + 1, b, a, a + 1, b + 1});
+            }
+        }
+        return std::make_unique<Mesh>(vertices, indices);
+    }
+
+    /*
+     * The visible objects are laid out on a grid that fills the screen at each depth, with a layer of the grid
+     * for each time the grid is full, so that a larger overlap gives fewer cells and more layers behind each other.
+     * Invisible objects are placed behind the camera, so that they are only culled.
+     */
+    void createScene(Scene &scene, const BenchmarkConfiguration &configuration) {
+        std::mt19937 random(configuration.seed);
+
+        // the tessellation increases with each mesh, so that meshes are not interchangeable
+        for (uint32_t i = 0; i < configuration.meshes; i++) {
+            scene.meshes.emplace_back(createSphere(6 + i * 2, 8 + i * 4));
+        }
+
+        // a texture for each material, so that each material has its own descriptor set
+        std::uniform_int_distribution<int> color(64, 255);
+        Shader &shader = scene.createShader("shader_vert.spv", "shader_frag.spv");
+        Shader &testShader = scene.createShader("shader_test_vert.spv", "shader_test_frag.spv");
+        for (uint32_t i = 0; i < configuration.materials; i++) {
+            const unsigned char pixel[]{static_cast<unsigned char>(color(random)),
+                                        static_cast<unsigned char>(color(random)),
+                                        static_cast<unsigned char>(color(random)), 255};
+            scene.textures.emplace_back(std::make_unique<Texture>(pixel, 1, 1));
+            // alternating between two shaders, so that the pipeline changes as well
+            scene.materials.emplace_back(std::make_unique<Material>(i % 2 == 0 ? shader : testShader,
+                                                                    *scene.textures.back(), RenderQueue::Opaque));
+        }
+
+        auto visibleObjects = static_cast<uint32_t>(std::round(configuration.visible *
+                                                               static_cast<float>(configuration.objects)));
+        auto cells = std::max(1u, static_cast<uint32_t>(std::ceil(static_cast<float>(visibleObjects) *
+                                                                  (1.0f - configuration.overlap))));
+        auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(cells))));
+        auto rows = (cells + columns - 1) / columns;
+
+        // the grid fills the view frustum (vertical field of view of 60 degrees) at each distance
+        float aspect = static_cast<float>(configuration.width) / static_cast<float>(configuration.height);
+        float halfHeightPerDistance = std::tan(glm::radians(30.0f));
+        float cellWidth = 2.0f * halfHeightPerDistance * aspect / static_cast<float>(columns);
+        float cellHeight = 2.0f * halfHeightPerDistance / static_cast<float>(rows);
+        float radiusPerDistance = 0.5f * std::min(cellWidth, cellHeight);
+
+        std::uniform_int_distribution<uint32_t> meshIndex(0, configuration.meshes - 1);
+        std::uniform_int_distribution<uint32_t> materialIndex(0, configuration.materials - 1);
+        for (uint32_t i = 0; i < configuration.objects; i++) {
+            Mesh &mesh = *scene.meshes[meshIndex(random)];
+            Material &material = *scene.materials[materialIndex(random)];
+            scene.objects.emplace_back(std::make_unique<Object>("Object " + std::to_string(i), mesh, material));
+            Object &object = *scene.objects.back();
+
+            uint32_t cell = i % cells;
+            uint32_t layer = i / cells;
+            float distance = 10.0f + static_cast<float>(layer) * 2.0f;
+            glm::vec2 position{
+                    (static_cast<float>(cell % columns) + 0.5f) * cellWidth - halfHeightPerDistance * aspect,
+                    (static_cast<float>(cell / columns) + 0.5f) * cellHeight - halfHeightPerDistance,
+            };
+            object.localPosition = {position * distance, i < visibleObjects ? -distance : distance};
+            object.localScale = glm::vec3{radiusPerDistance * distance};
+            object.occluder = layer == 0 && i < visibleObjects;
+        }
+    }
+
+    // nearest rank percentiles
+    FrameTimes getFrameTimes(std::vector<double> times) {
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](double p) {
+            auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(times.size())));
+            return times[std::clamp(rank, size_t{1}, times.size()) - 1];
+        };
+        return {
+                .mean = std::accumulate(times.begin(), times.end(), 0.0) / static_cast<double>(times.size()),
+                .p50 = percentile(0.5),
+                .p90 = percentile(0.9),
+                .p95 = percentile(0.95),
+                .p99 = percentile(0.99),
+                .max = times.back(),
+        };
+    }
+
+    // 64-bit FNV-1a
+    uint64_t getChecksum(const std::vector<uint8_t> &data) {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint8_t byte: data) {
+            hash = (hash ^ byte) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // binary PPM, which has no alpha channel, the pixels are 4 bytes in the order of the format
+    bool writePpm(const std::string &path, const std::vector<uint8_t> &pixels, VkExtent2D extent, VkFormat format) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+        file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+        std::vector<uint8_t> row(extent.width * 3);
+        for (uint32_t y = 0; y < extent.height; y++) {
+            for (uint32_t x = 0; x < extent.width; x++) {
+                const uint8_t *pixel = &pixels[(y * extent.width + x) * 4];
+                row[x * 3 + 0] = pixel[bgra ? 2 : 0];
+                row[x * 3 + 1] = pixel[1];
+                row[x * 3 + 2] = pixel[bgra ? 0 : 2];
+            }
+            file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size()));
+        }
+        return static_cast<bool>(file);
+    }
+
+    // summed over all memory heaps
+    void getMemoryUsage(VkDeviceSize &allocated, VkDeviceSize &used) {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &memoryProperties);
+        std::vector<VmaBudget> budgets(memoryProperties.memoryHeapCount);
+        vmaGetHeapBudgets(context->allocator, budgets.data());
+
+        allocated = 0;
+        used = 0;
+        for (const auto &budget: budgets) {
+            allocated += budget.statistics.allocationBytes;
+            used += budget.usage;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchmarkConfiguration benchmarkConfiguration;
+    try {
+        if (!parseArguments(argc, argv, benchmarkConfiguration)) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "invalid argument: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        EngineConfiguration configuration{
+                .window = nullptr,
+                .debug = false,
+                .applicationName = "Scene benchmark",
+                .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+                .occlusionCulling = benchmarkConfiguration.occlusionCulling,
+                .softwareOcclusionCulling = benchmarkConfiguration.softwareOcclusionCulling,
+                .pipelineStatistics = true,
+                .createScene = [&](Scene &scene) {
+                    createScene(scene, benchmarkConfiguration);
+                },
+                .cacheCommandBuffers = benchmarkConfiguration.cacheCommandBuffers,
+                .headlessExtent = {benchmarkConfiguration.width, benchmarkConfiguration.height},
+        };
+        Engine renderingEngine(configuration);
+        renderingEngine.camera->position = {0, 0, 0}; // looking down the negative z axis
+
+        for (uint32_t i = 0; i < benchmarkConfiguration.warmup; i++) {
+            renderingEngine.render();
+            if (i == 0) {
+                // the pipelines get queued in the first frame, and are drawn with once created
+                renderingEngine.pipelineBuilder->waitForPipelines();
+            }
+        }
+
+        std::vector<double> times;
+        times.reserve(benchmarkConfiguration.frames);
+        DrawStatistics total{};
+        OcclusionCullingStatistics cullingTotal{};
+        for (uint32_t i = 0; i < benchmarkConfiguration.frames; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            renderingEngine.render();
+            auto end = std::chrono::high_resolution_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+            // cached command buffers are not recorded again, so they report the commands of their last recording
+            const DrawStatistics &statistics = renderingEngine.drawStatistics;
+            total.drawCalls += statistics.drawCalls;
+            total.pipelineBinds += statistics.pipelineBinds;
+            total.descriptorSetBinds += statistics.descriptorSetBinds;
+            total.dynamicStateChanges += statistics.dynamicStateChanges;
+            total.pushConstants += statistics.pushConstants;
+
+            // read with a delay of the frames in flight, which doesn't matter for the average
+            if (renderingEngine.occlusionCuller) {
+                const OcclusionCullingStatistics &culling = renderingEngine.occlusionCuller->statistics;
+                cullingTotal.testedObjects += culling.testedObjects;
+                cullingTotal.occludedEarly += culling.occludedEarly;
+                cullingTotal.occludedLate += culling.occludedLate;
+                cullingTotal.cullingTime += culling.cullingTime;
+                cullingTotal.drawTime += culling.drawTime;
+            }
+        }
+
+        // the last measured frame, before the frames without culling are drawn
+        std::vector<uint8_t> pixels = renderingEngine.readFrame();
+        uint64_t checksum = getChecksum(pixels);
+        // of the measured frames, the unculled frames compile a graph without the culling passes
+        RenderGraphStatistics renderGraphStatistics = renderingEngine.renderGraph->statistics;
+        if (!benchmarkConfiguration.dump.empty() &&
+            !writePpm(benchmarkConfiguration.dump, pixels, renderingEngine.swapchain->extent,
+                      renderingEngine.swapchain->surfaceFormat.format)) {
+            std::cerr << "could not write frame: " << benchmarkConfiguration.dump << std::endl;
+        }
+
+        // the same scene drawn without culling, after a warmup so that no culled frames are read anymore
+        if (renderingEngine.occlusionCuller) {
+            renderingEngine.occlusionCuller->enabled = false;
+            for (uint32_t i = 0; i < benchmarkConfiguration.warmup; i++) {
+                renderingEngine.render();
+            }
+            for (uint32_t i = 0; i < benchmarkConfiguration.unculledFrames; i++) {
+                renderingEngine.render();
+                cullingTotal.unculledDrawTime += renderingEngine.occlusionCuller->statistics.unculledDrawTime;
+            }
+            renderingEngine.occlusionCuller->enabled = true;
+        }
+        FrameTimes frameTimes = getFrameTimes(times);
+        VkDeviceSize allocatedBytes;
+        VkDeviceSize usedBytes;
+        getMemoryUsage(allocatedBytes, usedBytes);
+
+        std::ofstream file(benchmarkConfiguration.output);
+        if (!file) {
+            std::cerr << "could not write results: " << benchmarkConfiguration.output << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto frames = static_cast<double>(benchmarkConfiguration.frames);
+        file << "{\n"
+             << "  \"configuration\": {"
+             << "\"objects\": " << benchmarkConfiguration.objects
+             << ", \"meshes\": " << benchmarkConfiguration.meshes
+             << ", \"materials\": " << benchmarkConfiguration.materials
+             << ", \"overlap\": " << benchmarkConfiguration.overlap
+             << ", \"visible\": " << benchmarkConfiguration.visible
+             << ", \"frames\": " << benchmarkConfiguration.frames
+             << ", \"warmup\": " << benchmarkConfiguration.warmup
+             << ", \"width\": " << benchmarkConfiguration.width
+             << ", \"height\": " << benchmarkConfiguration.height
+             << ", \"seed\": " << benchmarkConfiguration.seed
+             << ", \"occlusionCulling\": " << (renderingEngine.occlusionCuller ? "true" : "false")
+             << ", \"softwareOcclusionCulling\": " << (renderingEngine.softwareOcclusionCuller ? "true" : "false")
+             << ", \"cacheCommandBuffers\": " << (renderingEngine.cacheCommandBuffers ? "true" : "false")
+             << "},\n"
+             << "  \"frameTimeMs\": {"
+             << "\"mean\": " << frameTimes.mean
+             << ", \"p50\": " << frameTimes.p50
+             << ", \"p90\": " << frameTimes.p90
+             << ", \"p95\": " << frameTimes.p95
+             << ", \"p99\": " << frameTimes.p99
+             << ", \"max\": " << frameTimes.max
+             << "},\n"
+             << "  \"perFrame\": {"
+             << "\"drawCalls\": " << static_cast<double>(total.drawCalls) / frames
+             << ", \"pipelineBinds\": " << static_cast<double>(total.pipelineBinds) / frames
+             << ", \"descriptorSetBinds\": " << static_cast<double>(total.descriptorSetBinds) / frames
+             << ", \"dynamicStateChanges\": " << static_cast<double>(total.dynamicStateChanges) / frames
+             << ", \"pushConstants\": " << static_cast<double>(total.pushConstants) / frames
+             << "},\n"
+             << "  \"memory\": {"
+             << "\"allocatedBytes\": " << allocatedBytes
+             << ", \"usedBytes\": " << usedBytes
+             << "},\n"
+             // as a string, as JSON numbers can't hold 64-bit integers exactly
+             << "  \"frame\": {"
+             << "\"checksum\": \"" << std::hex << checksum << std::dec << "\""
+             << "},\n"
+             << "  \"renderGraph\": {"
+             << "\"transientImages\": " << renderGraphStatistics.transientImages
+             << ", \"transientMemoryBytes\": " << renderGraphStatistics.transientMemory
+             << ", \"unaliasedTransientMemoryBytes\": " << renderGraphStatistics.unaliasedTransientMemory
+             << "},\n";
+        // averages in milliseconds, 0 when the device does not support timestamps
+        if (renderingEngine.occlusionCuller) {
+            auto unculledFrames = static_cast<double>(benchmarkConfiguration.unculledFrames);
+            double cullingTime = cullingTotal.cullingTime / frames;
+            double drawTime = cullingTotal.drawTime / frames;
+            double unculledDrawTime = cullingTotal.unculledDrawTime / unculledFrames;
+            file << "  \"occlusionCulling\": {"
+                 << "\"testedObjects\": " << static_cast<double>(cullingTotal.testedObjects) / frames
+                 << ", \"occludedEarly\": " << static_cast<double>(cullingTotal.occludedEarly) / frames
+                 << ", \"occludedLate\": " << static_cast<double>(cullingTotal.occludedLate) / frames
+                 << ", \"cullingTimeMs\": " << cullingTime
+                 << ", \"drawTimeMs\": " << drawTime
+                 << ", \"unculledDrawTimeMs\": " << unculledDrawTime
+                 << ", \"gpuTimeSavedMs\": " << unculledDrawTime - (drawTime + cullingTime)
+                 << "},\n";
+        }
+        // of the last frame
+        if (renderingEngine.softwareOcclusionCuller) {
+            const SoftwareOcclusionStatistics &statistics = renderingEngine.softwareOcclusionCuller->statistics;
+            file << "  \"softwareOcclusionCulling\": {"
+                 << "\"occluderTriangles\": " << statistics.occluderTriangles
+                 << ", \"testedObjects\": " << statistics.testedObjects
+                 << ", \"occludedObjects\": " << statistics.occludedObjects
+                 << ", \"rasterizeTimeMs\": " << statistics.rasterizeTime
+                 << ", \"testTimeMs\": " << statistics.testTime
+                 << "},\n";
+        }
+        file << "  \"pipelineStatistics\": [";
+        // of the last frame that was read, empty when pipeline statistics queries are not supported
+        if (renderingEngine.pipelineStatistics) {
+            const auto &results = renderingEngine.pipelineStatistics->results;
+            for (size_t i = 0; i < results.size(); i++) {
+                const PipelineStatistics &statistics = results[i];
+                file << (i == 0 ? "\n" : ",\n")
+                     << "    {\"name\": \"" << statistics.name << "\""
+                     << ", \"inputAssemblyVertices\": " << statistics.inputAssemblyVertices
+                     << ", \"inputAssemblyPrimitives\": " << statistics.inputAssemblyPrimitives
+                     << ", \"vertexShaderInvocations\": " << statistics.vertexShaderInvocations
+                     << ", \"clippingInvocations\": " << statistics.clippingInvocations
+                     << ", \"clippingPrimitives\": " << statistics.clippingPrimitives
+                     << ", \"fragmentShaderInvocations\": " << statistics.fragmentShaderInvocations
+                     << ", \"computeShaderInvocations\": " << statistics.computeShaderInvocations << "}";
+            }
+        }
+        file << "\n  ]\n"
+             << "}\n";
+
+        std::cout << "scene benchmark" << std::endl
+                  << "objects: " << benchmarkConfiguration.objects
+                  << ", meshes: " << benchmarkConfiguration.meshes
+                  << ", materials: " << benchmarkConfiguration.materials
+                  << ", frames: " << benchmarkConfiguration.frames << std::endl
+                  << "frame time: mean: " << frameTimes.mean << " ms, p50: " << frameTimes.p50
+                  << " ms, p99: " << frameTimes.p99 << " ms" << std::endl
+                  << "wrote results to " << benchmarkConfiguration.output << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
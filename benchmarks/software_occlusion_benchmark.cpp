@@ -0,0 +1,181 @@
+#include "software_occlusion.h"
+#include "thread_pool.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+/*
+ * Measures the time it takes to rasterize a wall of box occluders into the software depth buffer and to test
+ * a field of candidate boxes against it, for checking the occluder budget against the 1 ms target.
+ *
+ * usage: software_occlusion_benchmark [--occluders n] [--candidates n] [--width n] [--height n]
+ *                                     [--iterations n] [--threads n]
+ */
+
+using namespace engine;
+using namespace engine::renderer;
+
+namespace {
+
+    struct BenchmarkConfiguration {
+        uint32_t occluders = 256;
+        uint32_t candidates = 10000;
+        uint32_t width = 320;
+        uint32_t height = 192;
+        uint32_t iterations = 1000;
+        uint32_t threads = ThreadPool::defaultThreadCount();
+    };
+
+    // unit cube from -1 to 1, counter-clockwise when looking at a face from the outside
+    void createBox(std::vector<VertexAttributes> &vertices, std::vector<uint32_t> &indices) {
+        const glm::vec3 normals[]{{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        for (const auto &normal: normals) {
+            glm::vec3 tangent = normal.x != 0 ? glm::vec3{0, 0, 1} : glm::vec3{1, 0, 0};
+            glm::vec3 bitangent = glm::cross(normal, tangent);
+
+            auto first = static_cast<uint32_t>(vertices.size());
+            vertices.push_back({normal - tangent - bitangent, {0, 0}, normal});
+            vertices.push_back({normal + tangent - bitangent, {1, 0}, normal});
+            vertices.push_back({normal + tangent + bitangent, {1, 1}, normal});
+            vertices.push_back({normal - tangent + bitangent, {0, 1}, normal});
+            indices.insert(indices.end(), {first, first + 1, first + 2, first + 2, first + 3, first});
+        }
+    }
+
+    bool parseArguments(int argc, char *argv[], BenchmarkConfiguration &configuration) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string argument = argv[i];
+            auto value = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+            if (argument == "--occluders") {
+                configuration.occluders = value;
+            } else if (argument == "--candidates") {
+                configuration.candidates = value;
+            } else if (argument == "--width") {
+                configuration.width = value;
+            } else if (argument == "--height") {
+                configuration.height = value;
+            } else if (argument == "--iterations") {
+                configuration.iterations = std::max(value, 1u);
+            } else if (argument == "--threads") {
+                configuration.threads = value;
+            } else {
+                std::cerr << "unknown argument: " << argument << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchmarkConfiguration configuration;
+    try {
+        if (!parseArguments(argc, argv, configuration)) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "invalid argument: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<VertexAttributes> vertices;
+    std::vector<uint32_t> indices;
+    createBox(vertices, indices);
+    Bounds bounds{{-1, -1, -1}, {1, 1, 1}};
+
+    // camera at the origin, looking down the negative z axis
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f),
+                                            static_cast<float>(configuration.width) /
+                                            static_cast<float>(configuration.height),
+                                            0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3{0, 0, 0}, glm::vec3{0, 0, -1}, glm::vec3{0, 1, 0});
+    glm::mat4 viewProjection = projection * view;
+
+    // a wall of thin boxes at z = -20 that covers the center of the screen, like the walls of a building
+    std::vector<Occluder> occluders;
+    auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(configuration.occluders))));
+    float wallSize = 24.0f;
+    float cellSize = wallSize / static_cast<float>(std::max(columns, 1u));
+    for (uint32_t i = 0; i < configuration.occluders; i++) {
+        float x = -wallSize * 0.5f + (static_cast<float>(i % columns) + 0.5f) * cellSize;
+        float y = -wallSize * 0.5f + (static_cast<float>(i / columns) + 0.5f) * cellSize;
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3{x, y, -20.0f}) *
+                              glm::scale(glm::mat4(1.0f), glm::vec3{cellSize * 0.5f, cellSize * 0.5f, 0.25f});
+        occluders.push_back(Occluder{&vertices, &indices, transform});
+    }
+
+    // candidates both in front of the wall (always visible) and behind it (mostly occluded)
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> horizontal(-12.0f, 12.0f);
+    std::uniform_real_distribution<float> depth(-100.0f, -5.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.0f);
+    std::vector<OcclusionCandidate> candidates;
+    for (uint32_t i = 0; i < configuration.candidates; i++) {
+        float z = depth(random);
+        float scale = size(random);
+        glm::vec3 position{horizontal(random) * -z / 20.0f, horizontal(random) * -z / 20.0f, z};
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position) *
+                              glm::scale(glm::mat4(1.0f), glm::vec3{scale});
+        candidates.push_back(OcclusionCandidate{bounds, transform});
+    }
+
+    ThreadPool threadPool(configuration.threads);
+    SoftwareOcclusionCuller culler(threadPool, configuration.width, configuration.height);
+    std::vector<uint8_t> visibility;
+
+    // warm up, so that allocations are not part of the measurements
+    culler.rasterize(occluders, viewProjection);
+    culler.test(candidates, viewProjection, visibility);
+
+    float total = 0.0f;
+    float minimum = std::numeric_limits<float>::max();
+    float maximum = 0.0f;
+    float rasterizeTotal = 0.0f;
+    float testTotal = 0.0f;
+    for (uint32_t i = 0; i < configuration.iterations; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        culler.rasterize(occluders, viewProjection);
+        culler.test(candidates, viewProjection, visibility);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        float time = std::chrono::duration<float, std::milli>(end - start).count();
+        total += time;
+        minimum = std::min(minimum, time);
+        maximum = std::max(maximum, time);
+        rasterizeTotal += culler.statistics.rasterizeTime;
+        testTotal += culler.statistics.testTime;
+    }
+
+    // objects in front of the wall can never be occluded
+    uint32_t incorrectlyOccluded = 0;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (candidates[i].transform[3].z > -19.0f && visibility[i] == 0) {
+            incorrectlyOccluded++;
+        }
+    }
+
+    auto iterations = static_cast<float>(configuration.iterations);
+    float average = total / iterations;
+    std::cout << "software occlusion benchmark" << std::endl
+              << "resolution: " << configuration.width << "x" << configuration.height
+              << ", threads: " << threadPool.getThreadCount() + 1
+              << ", iterations: " << configuration.iterations << std::endl
+              << "occluders: " << configuration.occluders
+              << ", occluder triangles: " << culler.statistics.occluderTriangles
+              << ", candidates: " << culler.statistics.testedObjects
+              << ", occluded: " << culler.statistics.occludedObjects
+              << ", incorrectly occluded: " << incorrectlyOccluded << std::endl
+              << "rasterizing: " << rasterizeTotal / iterations << " ms"
+              << ", testing: " << testTotal / iterations << " ms" << std::endl
+              << "total: " << average << " ms (min: " << minimum << " ms, max: " << maximum << " ms)"
+              << ", budget of 1 ms: " << (average < 1.0f ? "met" : "exceeded") << std::endl;
+
+    return incorrectlyOccluded == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
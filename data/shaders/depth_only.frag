@@ -0,0 +1,5 @@
+#version 450
+
+// no color output, the depth prepass only writes depth
+void main() {
+}
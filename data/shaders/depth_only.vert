@@ -0,0 +1,26 @@
+#version 450
+
+// vertex attributes, only the position is used
+layout(location = 0) in vec3 v_Position;
+
+// changes once per frame
+layout(set = 0, binding = 0) uniform cameraBuffer {
+    mat4 VP;
+} Camera;
+
+// the transform of each object in the scene
+layout(std430, set = 2, binding = 0) readonly buffer objectTransformsBuffer {
+    mat4 Model[];
+} ObjectTransforms;
+
+layout( push_constant ) uniform pushConstantsBuffer {
+  uint ObjectIndex;
+} PushConstant;
+
+// must match the material vertex shaders, otherwise the depth test with equal depth fails in the main pass
+invariant gl_Position;
+
+void main() {
+    mat4 mvp = Camera.VP * ObjectTransforms.Model[PushConstant.ObjectIndex];
+    gl_Position = mvp * vec4(v_Position, 1);
+}
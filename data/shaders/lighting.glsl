@@ -0,0 +1,9 @@
+// shared by shaders that use simple directional lighting
+
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.5, 1, 0.25));
+const float AMBIENT = 0.2;
+
+float getLighting(vec3 normal) {
+    float diffuse = max(dot(normalize(normal), LIGHT_DIRECTION), 0);
+    return AMBIENT + (1 - AMBIENT) * diffuse;
+}
@@ -0,0 +1,5 @@
+#version 450
+
+// no color output, the occlusion query only counts the samples that pass the depth test
+void main() {
+}
@@ -0,0 +1,12 @@
+#version 450
+
+// bounding box of the queried object, only the position is used
+layout(location = 0) in vec3 v_Position;
+
+layout( push_constant ) uniform pushConstantsBuffer {
+    mat4 MVP; // includes the transform from the unit cube to the bounds
+} PushConstant;
+
+void main() {
+    gl_Position = PushConstant.MVP * vec4(v_Position, 1);
+}
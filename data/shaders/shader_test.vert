@@ -5,19 +5,28 @@ layout(location = 0) in vec3 v_Position;
 layout(location = 1) in vec2 v_UV;
 layout(location = 2) in vec3 v_Normal;
 
-layout(binding = 0) uniform cameraBuffer {
+// changes once per frame
+layout(set = 0, binding = 0) uniform cameraBuffer {
     mat4 VP;
 } Camera;
 
+// the transform of each object in the scene
+layout(std430, set = 2, binding = 0) readonly buffer objectTransformsBuffer {
+    mat4 Model[];
+} ObjectTransforms;
+
 layout( push_constant ) uniform pushConstantsBuffer {
-  mat4 Model;
+  uint ObjectIndex;
 } PushConstant;
 
 // output
 layout(location = 0) out vec2 out_UV;
 
+// the depth prepass computes the position the same way, so that its depth matches exactly
+invariant gl_Position;
+
 void main() {
-    mat4 mvp = Camera.VP * PushConstant.Model;
+    mat4 mvp = Camera.VP * ObjectTransforms.Model[PushConstant.ObjectIndex];
     gl_Position = mvp * vec4(v_Position, 1);
     out_UV = v_UV;
 }
\ No newline at end of file
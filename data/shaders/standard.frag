@@ -0,0 +1,67 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require // for the unsized texture array
+#endif
+
+#include "lighting.glsl"
+
+// keywords:
+// TEXTURED (define): samples the material texture, otherwise draws the uv coordinates
+// ALPHA_TEST (define): discards fragments with a texture alpha below the alpha cutoff
+// LIT (specialization constant 0): simple directional lighting
+// BINDLESS (define, enabled by the engine): reads the texture from the bindless texture array
+layout(constant_id = 0) const bool LIT = false;
+
+// material parameters, reflected by the engine, zero unless the engine sets a default for the shader
+struct MaterialParameters {
+    vec4 Tint; // blended over the color by its alpha
+    float AlphaCutoff;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer materialParametersBuffer {
+    MaterialParameters Parameters[];
+} Materials;
+
+// the indices are the same for the whole draw, so no nonuniformEXT is needed
+layout( push_constant ) uniform pushConstantsBuffer {
+  uint ObjectIndex;
+  uint TextureIndex;
+  uint MaterialIndex;
+} PushConstant;
+
+#ifdef BINDLESS
+layout(set = 1, binding = 0) uniform sampler2D u_Textures[];
+#define u_Texture u_Textures[PushConstant.TextureIndex]
+#else
+layout(set = 1, binding = 0) uniform sampler2D u_Texture;
+#endif
+
+layout(location = 0) in vec2 v_UV;
+layout(location = 1) in vec3 v_Normal;
+layout(location = 0) out vec4 out_Color;
+
+void main() {
+    MaterialParameters parameters = Materials.Parameters[PushConstant.MaterialIndex];
+
+#ifdef TEXTURED
+    vec4 color = texture(u_Texture, v_UV);
+#else
+    vec4 color = vec4(v_UV, 0.5, 1);
+#endif
+
+#ifdef ALPHA_TEST
+    if (color.a < parameters.AlphaCutoff) {
+        discard;
+    }
+    color.a = 1;
+#endif
+
+    color.rgb = mix(color.rgb, parameters.Tint.rgb, parameters.Tint.a);
+
+    if (LIT) {
+        color.rgb *= getLighting(v_Normal);
+    }
+
+    out_Color = color;
+}
@@ -0,0 +1,34 @@
+#version 450
+
+// vertex attributes:
+layout(location = 0) in vec3 v_Position;
+layout(location = 1) in vec2 v_UV;
+layout(location = 2) in vec3 v_Normal;
+
+// changes once per frame
+layout(set = 0, binding = 0) uniform cameraBuffer {
+    mat4 VP;
+} Camera;
+
+// the transform of each object in the scene
+layout(std430, set = 2, binding = 0) readonly buffer objectTransformsBuffer {
+    mat4 Model[];
+} ObjectTransforms;
+
+layout( push_constant ) uniform pushConstantsBuffer {
+  uint ObjectIndex;
+} PushConstant;
+
+// output
+layout(location = 0) out vec2 out_UV;
+layout(location = 1) out vec3 out_Normal;
+
+// the depth prepass computes the position the same way, so that its depth matches exactly
+invariant gl_Position;
+
+void main() {
+    mat4 model = ObjectTransforms.Model[PushConstant.ObjectIndex];
+    gl_Position = Camera.VP * model * vec4(v_Position, 1);
+    out_UV = v_UV;
+    out_Normal = mat3(model) * v_Normal;
+}
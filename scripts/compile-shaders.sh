@@ -1,18 +1,45 @@
 # argument 1: source shader path (.png 1024x1024)
 # argument 2: target shaders path
+#
+# only recompiles shaders of which the source or one of the included files changed since the last run:
+# glslc writes the included files of each shader to a dependency file, and the contents of these files are hashed
 
 shaders_input_directory=$1
 shaders_output_directory=$2
 
-# delete and recreate shader output directory
-[ -d $shaders_output_directory ] && rm -r $shaders_output_directory
-mkdir $shaders_output_directory
+# the output directory is kept between runs, the dependency files and hashes are stored in .build
+build_directory="$shaders_output_directory"/.build
+mkdir -p $build_directory
 
 spv_extension="spv"
 directory_length=${#shaders_input_directory}
 
+# prints the files listed in a dependency file (target: source include_1 include_2 ...), one per line
+dependencies() {
+  sed -e 's/^[^:]*://' -e 's/\\$//' "$1" | tr ' ' '\n' | grep -v '^$'
+}
+
+# hashes the contents of the source file and the files it included during the last compilation
+content_hash() {
+  source_file=$1
+  dependency_file=$2
+  {
+    echo "$source_file"
+    cat "$source_file"
+    if [ -f "$dependency_file" ]; then
+      for dependency in $(dependencies "$dependency_file"); do
+        echo "$dependency"
+        cat "$dependency" 2> /dev/null
+      done
+    fi
+  } | cksum
+}
+
+compiled=0
+skipped=0
+
 IFS=$'\n'; set -f
-for file in $(find $shaders_input_directory -name "*.vert" -or -name "*.frag"); do
+for file in $(find $shaders_input_directory -name "*.vert" -or -name "*.frag" -or -name "*.comp"); do
   file_name_with_extension="${file:$directory_length+1}" # trim the start of the file path
   file_extension="${file_name_with_extension##*.}"
 
@@ -22,10 +49,41 @@ for file in $(find $shaders_input_directory -name "*.vert" -or -name "*.frag");
   output_file_name="$output_file_name"_"$file_extension"."$spv_extension" # add file extension and vert / frag identifier
 
   output_file_path="$shaders_output_directory"/"$output_file_name"
+  dependency_file_path="$build_directory"/"$output_file_name".d
+  hash_file_path="$build_directory"/"$output_file_name".hash
 
-  glslc $file -o $output_file_path
+  hash=$(content_hash $file $dependency_file_path)
+  if [ -f $output_file_path ] && [ -f $hash_file_path ] && [ "$(cat $hash_file_path)" = "$hash" ]; then
+    skipped=$((skipped + 1))
+  else
+    if glslc -MD -MF $dependency_file_path $file -o $output_file_path; then
+      # hashed again, as the included files could have changed
+      content_hash $file $dependency_file_path > $hash_file_path
+      compiled=$((compiled + 1))
+      echo "compiled shader to: ${output_file_path}"
+    else
+      rm -f $hash_file_path
+      exit 1
+    fi
+  fi
 
-  echo "compiled shader to: ${output_file_path}"
+  # the sources are also copied, so that shader variants can be compiled at runtime. Unchanged sources are not
+  # copied, so that their modification time only changes when they are edited, which triggers hot reloading
+  source_file_path="$shaders_output_directory"/source/"$file_name_with_extension"
+  mkdir -p "$(dirname "$source_file_path")"
+  cmp -s $file $source_file_path || cp $file $source_file_path
 
 done
-unset IFS; set +f
\ No newline at end of file
+
+# included files (e.g. .glsl) are copied as well, for resolving includes at runtime
+for file in $(find $shaders_input_directory -name "*.glsl"); do
+  source_file_path="$shaders_output_directory"/source/"${file:$directory_length+1}"
+  mkdir -p "$(dirname "$source_file_path")"
+  cmp -s $file $source_file_path || cp $file $source_file_path
+done
+unset IFS; set +f
+
+# marks the output directory as up to date for the build system
+touch $shaders_output_directory
+
+echo "compiled ${compiled} shaders, ${skipped} shaders were up to date"
@@ -5,6 +5,7 @@
 #include <engine.h>
 #include <editor.h>
 
+#include <array>
 #include <unordered_map>
 
 #include <glm/glm.hpp>
@@ -24,7 +25,12 @@ namespace sphere {
                     .window = window->glfwWindow,
                     .debug = true,
                     .applicationName = "Sphere",
-                    .applicationVersion = VK_MAKE_VERSION(1, 0, 0)
+                    .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+                    .occlusionCulling = true,
+                    .extendedDynamicState = true,
+                    .hotReloadShaders = true,
+                    .bindlessTextures = true,
+                    .framePacing = true
             };
 
             engine = std::make_unique<engine::Engine>(configuration);
@@ -44,6 +50,7 @@ namespace sphere {
         void run() {
             GLFWwindow *glfwWindow = window->glfwWindow;
             while (!glfwWindowShouldClose(glfwWindow)) {
+                engine->waitForFrameStart();
                 glfwPollEvents();
                 updateCameraPosition();
                 engine->render();
@@ -59,6 +66,14 @@ namespace sphere {
         const float speed = 0.1f;
         const float turnSpeed = 0.05f;
 
+        // switched with P, the latency of each mode is printed with the frame pacing statistics
+        const std::array<VkPresentModeKHR, 3> presentModes{
+                VK_PRESENT_MODE_FIFO_KHR,
+                VK_PRESENT_MODE_MAILBOX_KHR,
+                VK_PRESENT_MODE_IMMEDIATE_KHR
+        };
+        size_t presentModeIndex = 0;
+
         void updateCameraPosition() {
             glm::vec3 &cameraPosition = engine->camera->position;
             glm::quat &cameraRotation = engine->camera->rotation;
@@ -104,6 +119,26 @@ namespace sphere {
             } else if (action == GLFW_RELEASE) {
                 isPressed = false;
             }
+
+            if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+                application->presentModeIndex = (application->presentModeIndex + 1) % application->presentModes.size();
+                application->engine->setPresentMode(application->presentModes[application->presentModeIndex]);
+            }
+
+            // starts a capture, pressing T again writes it as a Chrome trace
+            if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+                engine::renderer::Profiler &profiler = *application->engine->profiler;
+                if (profiler.enabled) {
+                    profiler.stop();
+                    try {
+                        profiler.writeTrace("sphere_trace.json");
+                    } catch (const std::exception &e) {
+                        std::cerr << e.what() << std::endl;
+                    }
+                } else {
+                    profiler.start();
+                }
+            }
         }
     };
 }
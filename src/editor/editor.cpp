@@ -65,6 +65,58 @@ namespace editor {
             ImGui::End();
         }
 
+        // counters of the last frame that was read, to compare batching and culling changes
+        if (ImGui::Begin("Pipeline statistics")) {
+            engine::renderer::PipelineStatisticsQueries *pipelineStatistics = engine::engine->pipelineStatistics.get();
+            if (pipelineStatistics == nullptr) {
+                ImGui::Text("Not enabled, see EngineConfiguration::pipelineStatistics");
+            } else {
+                ImGui::Checkbox("Per draw bucket", &pipelineStatistics->perDrawBucket);
+                if (ImGui::BeginTable("Pipeline statistics", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    for (const char *column: {"Scope", "Vertices", "Primitives", "Vertex invocations",
+                                              "Clipped primitives", "Fragment invocations", "Compute invocations"}) {
+                        ImGui::TableSetupColumn(column);
+                    }
+                    ImGui::TableHeadersRow();
+                    for (const auto &statistics: pipelineStatistics->results) {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(statistics.name);
+                        for (uint64_t value: {statistics.inputAssemblyVertices, statistics.inputAssemblyPrimitives,
+                                              statistics.vertexShaderInvocations, statistics.clippingPrimitives,
+                                              statistics.fragmentShaderInvocations,
+                                              statistics.computeShaderInvocations}) {
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%llu", static_cast<unsigned long long>(value));
+                        }
+                    }
+                    ImGui::EndTable();
+                }
+            }
+
+            ImGui::End();
+        }
+
+        // disabling the culling draws all objects, which measures the gpu time the culling saves
+        if (ImGui::Begin("Occlusion culling")) {
+            engine::renderer::OcclusionCuller *occlusionCuller = engine::engine->occlusionCuller.get();
+            if (occlusionCuller == nullptr) {
+                ImGui::Text("Not enabled, see EngineConfiguration::occlusionCulling");
+            } else {
+                const engine::renderer::OcclusionCullingStatistics &statistics = occlusionCuller->statistics;
+                ImGui::Checkbox("Enabled", &occlusionCuller->enabled);
+                ImGui::Text("Tested objects: %u", statistics.testedObjects);
+                ImGui::Text("Occluded (early): %u", statistics.occludedEarly);
+                ImGui::Text("Occluded (late): %u", statistics.occludedLate);
+                ImGui::Text("Culling: %.3f ms", statistics.cullingTime);
+                ImGui::Text("Drawing: %.3f ms", statistics.drawTime);
+                ImGui::Text("Drawing without culling: %.3f ms", statistics.unculledDrawTime);
+                ImGui::Text("Gpu time saved: %.3f ms", statistics.gpuTimeSaved);
+            }
+
+            ImGui::End();
+        }
+
         projectBrowser.render();
 
         // we need the following systems:
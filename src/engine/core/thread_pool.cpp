@@ -0,0 +1,96 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace engine {
+
+    ThreadPool::ThreadPool(uint32_t threadCount) {
+        threads.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    uint32_t ThreadPool::defaultThreadCount() {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        return std::max(hardwareThreads, 2u) - 1;
+    }
+
+    uint32_t ThreadPool::getThreadCount() const {
+        return static_cast<uint32_t>(threads.size());
+    }
+
+    void ThreadPool::submit(std::function<void()> &&job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace_back(std::move(job));
+        }
+        condition.notify_one();
+    }
+
+    void ThreadPool::work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &function) {
+        if (count == 0) {
+            return;
+        }
+
+        // shared, because workers that pick up their job after all work is done still touch the counters
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> remaining;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        auto state = std::make_shared<State>();
+        state->remaining = count;
+
+        auto run = [state, count, &function]() {
+            size_t i;
+            while ((i = state->next.fetch_add(1)) < count) {
+                function(i);
+                if (state->remaining.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->done.notify_all();
+                }
+            }
+        };
+
+        size_t helperCount = std::min(threads.size(), count - 1);
+        for (size_t i = 0; i < helperCount; i++) {
+            submit(run);
+        }
+        run();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&state]() { return state->remaining == 0; });
+    }
+}
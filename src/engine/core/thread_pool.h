@@ -0,0 +1,47 @@
+#ifndef SPHERE_THREAD_POOL_H
+#define SPHERE_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+    /*
+     * A fixed amount of worker threads that execute jobs from a shared queue.
+     *
+     * parallelFor lets the calling thread participate in the work, so that it doesn't sit idle
+     * while waiting for the workers to finish.
+     */
+    class ThreadPool {
+
+    public:
+        // by default, one worker for each hardware thread except the calling thread
+        explicit ThreadPool(uint32_t threadCount = defaultThreadCount());
+        ~ThreadPool();
+
+        // adds a job to the queue, does not wait for it to complete
+        void submit(std::function<void()> &&job);
+
+        // calls function(i) for i in [0, count) across the workers and the calling thread, returns when all are done
+        void parallelFor(size_t count, const std::function<void(size_t)> &function);
+
+        [[nodiscard]] uint32_t getThreadCount() const;
+
+        static uint32_t defaultThreadCount();
+
+    private:
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> jobs;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+
+        void work();
+    };
+}
+
+#endif //SPHERE_THREAD_POOL_H
@@ -30,16 +30,30 @@ namespace engine {
 
     static void framebufferResizeCallback(GLFWwindow *window, int width, int height) {
         engine->framebufferResized = true;
-        engine->render();
+        // keeps drawing while the window is being resized, as the event loop is blocked on some platforms.
+        // render() waits for events itself while the window is minimized, which should not render again
+        if (!engine->rendering) {
+            engine->render();
+        }
         // std::cout << "frame buffer resized to x: " << width << ", y: " << height << std::endl;
     }
 
-    Engine::Engine(EngineConfiguration &engineConfiguration) {
+    Engine::Engine(EngineConfiguration &engineConfiguration) : depthPrepass(engineConfiguration.depthPrepass),
+                                                               cacheCommandBuffers(engineConfiguration.cacheCommandBuffers),
+                                                               hotReloadShaders(engineConfiguration.hotReloadShaders),
+                                                               framesInFlight(std::max(engineConfiguration.framesInFlight, 1u)) {
         assert((engine == nullptr) && "Only one engine can exist at one time");
         engine = this;
 
         std::cout << "created engine" << std::endl;
 
+        std::vector<const char *> enabledOptionalDeviceExtensions = optionalDeviceExtensions;
+        if (engineConfiguration.window != nullptr) {
+            enabledOptionalDeviceExtensions.insert(enabledOptionalDeviceExtensions.end(),
+                                                   optionalPresentDeviceExtensions.begin(),
+                                                   optionalPresentDeviceExtensions.end());
+        }
+
         renderer::VulkanConfiguration configuration{
                 .window = engineConfiguration.window,
 
@@ -53,24 +67,82 @@ namespace engine {
                 .preferredSurfaceFormats = {},
                 .requiredInstanceExtensions = {},
                 .requiredInstanceLayers = {},
-                .requiredDeviceExtensions = requiredDeviceExtensions,
+                // the swapchain extension is only needed for presenting
+                .requiredDeviceExtensions = engineConfiguration.window != nullptr ? requiredDeviceExtensions
+                                                                                  : std::vector<const char *>{},
+                .optionalDeviceExtensions = enabledOptionalDeviceExtensions,
         };
         context = std::make_unique<renderer::VulkanContext>(configuration);
-        swapchain = std::make_unique<renderer::Swapchain>(renderer::preferredSurfaceFormats);
-        renderPass = std::make_unique<renderer::RenderPass>(swapchain->surfaceFormat.format, depthImageFormat);
-        descriptorSetBuilder = std::make_unique<renderer::DescriptorSetBuilder>();
-        pipelineBuilder = std::make_unique<renderer::PipelineBuilder>(*swapchain);
+        deletionQueue = std::make_unique<renderer::DeletionQueue>(framesInFlight);
+        profiler = std::make_unique<renderer::Profiler>(framesInFlight);
+        renderGraph = std::make_unique<renderer::RenderGraph>();
+        if (engineConfiguration.profiling) {
+            profiler->start();
+        }
+        if (context->isHeadless()) {
+            swapchain = std::make_unique<renderer::Swapchain>(renderer::preferredSurfaceFormats[0].format,
+                                                              engineConfiguration.headlessExtent, framesInFlight);
+        } else {
+            swapchain = std::make_unique<renderer::Swapchain>(renderer::preferredSurfaceFormats,
+                                                              engineConfiguration.presentMode);
+        }
+        // the attachments are transitioned between the passes by the render graph
+        renderer::RenderPassConfiguration renderPassConfiguration{
+                .colorInitialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .colorFinalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        };
+        renderPass = std::make_unique<renderer::RenderPass>(swapchain->surfaceFormat.format, depthImageFormat,
+                                                            renderPassConfiguration);
+        descriptorSetBuilder = std::make_unique<renderer::DescriptorSetBuilder>(framesInFlight);
+        threadPool = std::make_unique<ThreadPool>();
+        pipelineBuilder = std::make_unique<renderer::PipelineBuilder>(*swapchain, threadPool.get());
+        pipelineBuilder->extendedDynamicState = engineConfiguration.extendedDynamicState;
+        transformBuffer = std::make_unique<renderer::TransformBuffer>(framesInFlight);
+        frameDescriptors = std::make_unique<renderer::FrameDescriptors>(framesInFlight);
+        materialBuffer = std::make_unique<renderer::MaterialBuffer>(framesInFlight);
+        shaderCompiler = std::make_unique<renderer::ShaderCompiler>();
+
+        if (engineConfiguration.bindlessTextures) {
+            if (context->features.descriptorIndexing) {
+                bindlessTextures = std::make_unique<renderer::BindlessTextures>();
+            } else {
+                std::cout << "descriptor indexing is not supported, bindless textures are disabled" << std::endl;
+            }
+        }
 
-        glfwSetFramebufferSizeCallback(configuration.window, framebufferResizeCallback);
+        // drawn with while the pipelines of a material are being created, so it is created before anything else
+        fallbackShader = std::make_unique<renderer::Shader>("shader_vert.spv", "shader_frag.spv",
+                                                            renderPass->renderPass);
+        if (bindlessTextures) {
+            std::vector<std::string> defines{"TEXTURED", renderer::ShaderVariants::bindlessKeyword};
+            bindlessFallbackShader = std::make_unique<renderer::Shader>(
+                    shaderCompiler->getModule("standard.vert", defines),
+                    shaderCompiler->getModule("standard.frag", defines),
+                    renderPass->renderPass);
+        }
+        for (auto *shader: {fallbackShader.get(), bindlessFallbackShader.get()}) {
+            if (shader == nullptr) {
+                continue;
+            }
+            for (auto queue: {renderer::RenderQueue::Opaque, renderer::RenderQueue::Transparent}) {
+                shader->getPipeline(queue, false);
+                shader->getPipeline(queue, true);
+            }
+        }
+        pipelineBuilder->waitForPipelines();
+
+        if (!context->isHeadless()) {
+            glfwSetFramebufferSizeCallback(configuration.window, framebufferResizeCallback);
+        }
 
-        createDepthImage();
-        swapchain->createFramebuffers(renderPass->renderPass, depthImageView);
         camera = std::make_unique<renderer::Camera>(*swapchain);
 
         commandPool = renderer::createCommandPool();
 
-        std::vector<VkCommandBuffer> commandBuffers = renderer::createCommandBuffers(commandPool, MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        std::vector<VkCommandBuffer> commandBuffers = renderer::createCommandBuffers(commandPool, framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
             FrameData frameData{
                     .commandBuffer = commandBuffers[i],
             };
@@ -79,14 +151,65 @@ namespace engine {
         }
 
         scene = std::make_unique<renderer::Scene>(renderPass->renderPass);
-        // bind the camera buffer with the materials
-        for (auto const &material : scene->materials) {
-            renderer::bindBuffer(material->descriptorSet, camera->cameraDataBuffer.buffer, 0);
+        if (engineConfiguration.createScene) {
+            engineConfiguration.createScene(*scene);
+        } else {
+            scene->loadDemoScene();
+        }
+
+        if (engineConfiguration.occlusionCulling) {
+            VkQueueFlags queueFlags = context->queueFamiliesData.graphicsQueueFamilyData->properties.queueFlags;
+            if (queueFlags & VK_QUEUE_COMPUTE_BIT) {
+                occlusionCuller = std::make_unique<renderer::OcclusionCuller>(swapchain->surfaceFormat.format,
+                                                                              depthImageFormat,
+                                                                              swapchain->extent,
+                                                                              framesInFlight,
+                                                                              scene->objects.size());
+            } else {
+                std::cout << "graphics queue does not support compute, occlusion culling is disabled" << std::endl;
+            }
+        }
+
+        if (engineConfiguration.softwareOcclusionCulling) {
+            softwareOcclusionCuller = std::make_unique<renderer::SoftwareOcclusionCuller>(*threadPool);
+        }
+
+        if (engineConfiguration.occlusionQueries) {
+            occlusionQueries = std::make_unique<renderer::OcclusionQueries>(swapchain->surfaceFormat.format,
+                                                                            depthImageFormat,
+                                                                            framesInFlight);
         }
+
+        if (engineConfiguration.measureOverdraw) {
+            if (context->features.occlusionQueryPrecise) {
+                overdrawCounter = std::make_unique<renderer::OverdrawCounter>(framesInFlight);
+            } else {
+                std::cout << "precise occlusion queries are not supported, overdraw is not measured" << std::endl;
+            }
+        }
+
+        if (engineConfiguration.pipelineStatistics) {
+            if (context->features.pipelineStatisticsQuery) {
+                pipelineStatistics = std::make_unique<renderer::PipelineStatisticsQueries>(framesInFlight);
+            } else {
+                std::cout << "pipeline statistics queries are not supported, passes are not counted" << std::endl;
+            }
+        }
+
+        framePacer = std::make_unique<renderer::FramePacer>(framesInFlight, swapchain->presentMode);
+        framePacer->enabled = engineConfiguration.framePacing;
+
+        if (cacheCommandBuffers && !canCacheCommandBuffers()) {
+            std::cout << "command buffers are recorded each frame, as occlusion culling or queries are used" << std::endl;
+        }
+
+        // the pipelines of the renderer features have been created, the pipelines of the scene are still queued
+        pipelineBuilder->printStatistics();
     }
 
     Engine::~Engine() {
         vkDeviceWaitIdle(context->device);
+        deletionQueue.reset();
 
         for (auto const &frameData: frames) {
             frameData.destroy();
@@ -94,13 +217,26 @@ namespace engine {
 
         vkDestroyCommandPool(context->device, commandPool, nullptr);
 
-        // destroy depth image
-        vkDestroyImageView(context->device, depthImageView, nullptr);
-        vmaDestroyImage(context->allocator, depthImage, depthImageAllocation);
-
         camera.reset();
 
+        renderGraph.reset();
+        occlusionCuller.reset();
+        occlusionQueries.reset();
+        overdrawCounter.reset();
+        pipelineStatistics.reset();
+        framePacer.reset();
+        profiler.reset();
+        softwareOcclusionCuller.reset();
+        // finishes the queued pipelines
+        threadPool.reset();
         scene.reset();
+        shaderCompiler.reset();
+        fallbackShader.reset();
+        bindlessFallbackShader.reset();
+        bindlessTextures.reset();
+        materialBuffer.reset();
+        frameDescriptors.reset();
+        transformBuffer.reset();
         pipelineBuilder.reset();
         descriptorSetBuilder.reset();
         renderPass.reset();
@@ -110,7 +246,23 @@ namespace engine {
         std::cout << "destroyed engine" << std::endl;
     }
 
+    void Engine::waitForFrameStart() {
+        PROFILE_ZONE("wait for frame start");
+        framePacer->beginFrame(swapchain->swapchain);
+    }
+
+    void Engine::setPresentMode(VkPresentModeKHR presentMode) {
+        if (swapchain->isHeadless()) {
+            return; // nothing is presented
+        }
+        swapchain->preferredPresentMode = presentMode;
+        framebufferResized = true;
+    }
+
     void Engine::render() {
+        if (!framePacer->frameStarted) {
+            waitForFrameStart();
+        }
 //        // render imgui
 //        {
 //            ImGui_ImplVulkan_NewFrame();
@@ -119,84 +271,419 @@ namespace engine {
 //            renderImgui(); // std::function call
 //            ImGui::Render();
 //        }
+        PROFILE_ZONE("Engine::render");
+        rendering = true;
         camera->updateCameraData();
         scene->update();
+        scene->updateTransforms();
+
+        // done before waiting for the frame in flight, so that it overlaps with the gpu
+        if (softwareOcclusionCuller) {
+            softwareOcclusionCuller->cull(scene->objects, camera->getCameraData().VP);
+        }
+        {
+            PROFILE_ZONE("build draw list");
+            renderer::buildDrawList(scene->objects, camera->position, sortOpaqueObjects, drawList);
+        }
+        // checking the modification times every frame is not needed for editing shaders
+        if (hotReloadShaders && frameCount % 30 == 0) {
+            for (const auto &[oldPath, newPath]: shaderCompiler->reloadModules()) {
+                pipelineBuilder->reloadShader(oldPath, newPath);
+            }
+        }
+        pipelineBuilder->applyOptimizedPipelines();
+        pipelineBuilder->applyReloadedPipelines();
+        updateRecordingVersion();
+
         drawFrame();
+        framePacer->endFrame();
+        rendering = false;
+
+        frameCount++;
+        if (occlusionCuller && frameCount % 300 == 0) {
+            occlusionCuller->printStatistics();
+        }
+        if (softwareOcclusionCuller && frameCount % 300 == 0) {
+            softwareOcclusionCuller->printStatistics();
+        }
+        if (occlusionQueries && frameCount % 300 == 0) {
+            occlusionQueries->printStatistics();
+        }
+        if (overdrawCounter && frameCount % 300 == 0) {
+            overdrawCounter->printStatistics();
+        }
+        if (pipelineStatistics && frameCount % 300 == 0) {
+            pipelineStatistics->printStatistics();
+        }
+        if (frameCount % 300 == 0) {
+            renderGraph->printStatistics();
+            framePacer->printStatistics();
+            transformBuffer->printStatistics();
+            materialBuffer->printStatistics();
+            descriptorSetBuilder->printStatistics();
+            if (profiler->enabled) {
+                profiler->printStatistics();
+            }
+            shaderCompiler->printStatistics();
+            for (auto const &variants: scene->shaderVariants) {
+                variants->printStatistics();
+            }
+            std::cout << "draws: draw calls: " << drawStatistics.drawCalls
+                      << ", pipeline binds: " << drawStatistics.pipelineBinds
+                      << ", descriptor set binds: " << drawStatistics.descriptorSetBinds
+                      << ", dynamic state changes: " << drawStatistics.dynamicStateChanges
+                      << ", push constants: " << drawStatistics.pushConstants << std::endl;
+        }
+        if (canCacheCommandBuffers() && frameCount % 300 == 0) {
+            std::cout << "command buffers: recorded: " << commandBufferStatistics.recorded
+                      << ", reused: " << commandBufferStatistics.reused << std::endl;
+            commandBufferStatistics = {};
+        }
+    }
+
+    /*
+     * The camera and transforms are read from buffers, so the recorded commands only depend on
+     * the scene structure, the draw order, the drawing options, the available pipelines and the framebuffers.
+     */
+    void Engine::updateRecordingVersion() {
+        uint64_t completedPipelines = pipelineBuilder->getCompletedPipelineCount();
+        if (scene->getVersion() != recordedSceneVersion ||
+            completedPipelines != recordedCompletedPipelines ||
+            depthPrepass != recordedDepthPrepass ||
+            profiler->enabled != recordedProfiling ||
+            (pipelineStatistics && pipelineStatistics->perDrawBucket != recordedPerDrawBucket) ||
+            drawList.opaque != recordedDrawList.opaque ||
+            drawList.transparent != recordedDrawList.transparent) {
+            recordingVersion++;
+            recordedSceneVersion = scene->getVersion();
+            recordedCompletedPipelines = completedPipelines;
+            recordedDepthPrepass = depthPrepass;
+            recordedProfiling = profiler->enabled;
+            recordedPerDrawBucket = pipelineStatistics && pipelineStatistics->perDrawBucket;
+            recordedDrawList = drawList;
+        }
+    }
+
+    bool Engine::canCacheCommandBuffers() const {
+        return cacheCommandBuffers && !occlusionCuller && !softwareOcclusionCuller && !occlusionQueries;
+    }
+
+    /*
+     * Returns a command buffer that contains the commands for drawing the current frame,
+     * which only gets recorded when the cached command buffer is out of date.
+     */
+    VkCommandBuffer Engine::getCommandBuffer(FrameData &frameData, uint32_t imageIndex) {
+        if (!canCacheCommandBuffers()) {
+            vkResetCommandBuffer(frameData.commandBuffer, 0);
+            recordCommandBuffer(frameData.commandBuffer, imageIndex);
+            return frameData.commandBuffer;
+        }
+
+        if (frameData.cachedCommandBuffers.size() != swapchain->getImageCount()) {
+            if (!frameData.cachedCommandBuffers.empty()) {
+                for (VkCommandBuffer cmd: frameData.cachedCommandBuffers) {
+                    profiler->forget(cmd);
+                    if (pipelineStatistics) {
+                        pipelineStatistics->forget(cmd);
+                    }
+                }
+                vkFreeCommandBuffers(context->device, commandPool,
+                                     static_cast<uint32_t>(frameData.cachedCommandBuffers.size()),
+                                     frameData.cachedCommandBuffers.data());
+            }
+            frameData.cachedCommandBuffers = renderer::createCommandBuffers(commandPool, swapchain->getImageCount());
+            frameData.cachedVersions.assign(swapchain->getImageCount(), 0);
+        }
+
+        VkCommandBuffer cmd = frameData.cachedCommandBuffers[imageIndex];
+        if (frameData.cachedVersions[imageIndex] != recordingVersion) {
+            vkResetCommandBuffer(cmd, 0);
+            recordCommandBuffer(cmd, imageIndex);
+            frameData.cachedVersions[imageIndex] = recordingVersion;
+            commandBufferStatistics.recorded++;
+        } else {
+            commandBufferStatistics.reused++;
+        }
+        return cmd;
     }
 
     void Engine::drawFrame() {
-        const FrameData &frameData = frames[currentFrameIndex];
+        FrameData &frameData = frames[currentFrameIndex];
         VkResult result;
-        vkWaitForFences(context->device, 1, &frameData.inFlightFence, VK_TRUE, UINT64_MAX);
+        PROFILE_ZONE("Engine::drawFrame");
+        {
+            PROFILE_ZONE("wait for frame in flight");
+            auto waitStart = std::chrono::steady_clock::now();
+            vkWaitForFences(context->device, 1, &frameData.inFlightFence, VK_TRUE, UINT64_MAX);
+            framePacer->addBlockedTime(std::chrono::steady_clock::now() - waitStart);
+        }
+        deletionQueue->beginFrame(currentFrameIndex);
+        profiler->readResults(currentFrameIndex);
 
-        uint32_t imageIndex;
-        result = vkAcquireNextImageKHR(context->device,
-                                       swapchain->swapchain,
-                                       UINT64_MAX,
-                                       frameData.imageAvailableSemaphore,
-                                       VK_NULL_HANDLE,
-                                       &imageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        if (occlusionCuller) {
+            occlusionCuller->readResults(currentFrameIndex);
+            occlusionCuller->reserve(scene->objects.size());
+        }
+
+        if (occlusionQueries) {
+            // the previous frame is read as well when it has already completed, so that results are one frame latent
+            occlusionQueries->readResults(currentFrameIndex);
+            uint32_t previousFrameIndex = (currentFrameIndex + framesInFlight - 1) % framesInFlight;
+            if (vkGetFenceStatus(context->device, frames[previousFrameIndex].inFlightFence) == VK_SUCCESS) {
+                occlusionQueries->readResults(previousFrameIndex);
+            }
+            occlusionQueries->reserve(scene->objects.size());
+        }
+
+        if (overdrawCounter) {
+            overdrawCounter->readResults(currentFrameIndex);
+        }
+
+        if (pipelineStatistics) {
+            pipelineStatistics->readResults(currentFrameIndex);
+        }
 
+        {
+            PROFILE_ZONE("update buffers");
+            descriptorSetBuilder->resetTransientDescriptorSets(currentFrameIndex);
+            transformBuffer->update(currentFrameIndex, scene->objects);
+            frameDescriptors->update(currentFrameIndex, camera->getCameraData());
+            materialBuffer->update(currentFrameIndex, scene->materials);
+        }
+
+        // blocks when all images are queued for presentation, e.g. with FIFO when the gpu is ahead of the display
+        uint32_t imageIndex;
+        if (swapchain->isHeadless()) {
+            // each frame in flight has its own image, which its fence guards
+            imageIndex = currentFrameIndex;
         } else {
-            renderer::checkResult(result);
+            PROFILE_ZONE("acquire image");
+            auto acquireStart = std::chrono::steady_clock::now();
+            result = vkAcquireNextImageKHR(context->device,
+                                           swapchain->swapchain,
+                                           UINT64_MAX,
+                                           frameData.imageAvailableSemaphore,
+                                           VK_NULL_HANDLE,
+                                           &imageIndex);
+            framePacer->addBlockedTime(std::chrono::steady_clock::now() - acquireStart);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                // no image was acquired, so the semaphore is not signaled and the fence stays signaled
+                recreateSwapchain();
+                return;
+            } else if (result != VK_SUBOPTIMAL_KHR) {
+                renderer::checkResult(result);
+            }
         }
 
         vkResetFences(context->device, 1, &frameData.inFlightFence);
 
         // frame buffer must have been created with the same render pass (compatibility)
-        VkFramebuffer &framebuffer = swapchain->framebuffers[imageIndex];
-
-        vkResetCommandBuffer(frameData.commandBuffer, 0);
-        recordCommandBuffer(frameData, framebuffer);
+        VkCommandBuffer commandBuffer = getCommandBuffer(frameData, imageIndex);
 
         VkSemaphore waitSemaphores[] = {frameData.imageAvailableSemaphore};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
         VkSemaphore signalSemaphores[] = {frameData.renderFinishedSemaphore};
 
+        // when headless, nothing is acquired or presented, so there is nothing to wait for or signal
+        uint32_t semaphoreCount = swapchain->isHeadless() ? 0 : 1;
         VkSubmitInfo submitInfo{
                 .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .waitSemaphoreCount = 1,
+                .waitSemaphoreCount = semaphoreCount,
                 .pWaitSemaphores = waitSemaphores,
                 .pWaitDstStageMask = waitStages,
                 .commandBufferCount = 1,
-                .pCommandBuffers = &frameData.commandBuffer,
-                .signalSemaphoreCount = 1,
+                .pCommandBuffers = &commandBuffer,
+                .signalSemaphoreCount = semaphoreCount,
                 .pSignalSemaphores = signalSemaphores,
         };
         renderer::checkResult(vkQueueSubmit(context->graphicsQueue, 1, &submitInfo, frameData.inFlightFence));
+        deletionQueue->endFrame(currentFrameIndex);
+        profiler->submitted(commandBuffer, currentFrameIndex);
+        if (pipelineStatistics) {
+            pipelineStatistics->submitted(commandBuffer, currentFrameIndex);
+        }
+        renderedImageIndex = imageIndex;
+
+        if (!swapchain->isHeadless()) {
+            PROFILE_ZONE("present");
+            VkSwapchainKHR swapchains[] = {swapchain->swapchain};
+
+            // lets the frame pacer wait until this image has been presented
+            uint64_t presentId = framePacer->present();
+            VkPresentIdKHR presentIdInfo{
+                    .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+                    .swapchainCount = 1,
+                    .pPresentIds = &presentId,
+            };
 
-        VkSwapchainKHR swapchains[] = {swapchain->swapchain};
-
-        VkPresentInfoKHR presentInfo{
-                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = signalSemaphores,
-                .swapchainCount = 1,
-                .pSwapchains = swapchains,
-                .pImageIndices = &imageIndex,
-                .pResults = nullptr,
-        };
-        result = vkQueuePresentKHR(context->presentQueue, &presentInfo);
-        if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR || framebufferResized) {
-            swapchain->recreate();
-            framebufferResized = false;
-        } else {
-            renderer::checkResult(result);
+            VkPresentInfoKHR presentInfo{
+                    .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                    .pNext = presentId != 0 ? &presentIdInfo : nullptr,
+                    .waitSemaphoreCount = 1,
+                    .pWaitSemaphores = signalSemaphores,
+                    .swapchainCount = 1,
+                    .pSwapchains = swapchains,
+                    .pImageIndices = &imageIndex,
+                    .pResults = nullptr,
+            };
+            result = vkQueuePresentKHR(context->presentQueue, &presentInfo);
+            if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR || framebufferResized) {
+                recreateSwapchain();
+            } else {
+                renderer::checkResult(result);
+            }
         }
-        currentFrameIndex = (currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrameIndex = (currentFrameIndex + 1) % framesInFlight;
     }
 
-    void Engine::recordCommandBuffer(const FrameData &frameData, const VkFramebuffer &framebuffer) {
-        const VkCommandBuffer &cmd = frameData.commandBuffer;
+    std::vector<uint8_t> Engine::readFrame() {
+        return swapchain->readImage(renderedImageIndex);
+    }
 
+    /*
+     * The passes are declared with the resources they use, so that the render graph records the barriers and layout
+     * transitions between them. The swapchain image is left in the layout it is presented or read in.
+     */
+    void Engine::recordCommandBuffer(const VkCommandBuffer &cmd, uint32_t imageIndex) {
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = 0;
         beginInfo.pInheritanceInfo = nullptr;
 
+        PROFILE_ZONE("Engine::recordCommandBuffer");
         renderer::checkResult(vkBeginCommandBuffer(cmd, &beginInfo));
+        profiler->recordBegin(cmd, currentFrameIndex);
+        drawStatistics = {};
+
+        if (occlusionQueries) {
+            occlusionQueries->recordReset(cmd, currentFrameIndex, scene->objects, camera->getCameraData().VP);
+        }
+
+        if (overdrawCounter) {
+            overdrawCounter->recordReset(cmd, currentFrameIndex, swapchain->extent);
+        }
+
+        if (pipelineStatistics) {
+            pipelineStatistics->recordReset(cmd, currentFrameIndex);
+        }
+
+        VkFramebuffer framebuffer; // known once the graph has created the depth image
+        renderGraph->reset();
+
+        // the image is acquired when the submission waits at the color attachment output stage
+        renderer::RenderGraphImage color = renderGraph->importImage(
+                "color", swapchain->getImage(imageIndex), VK_IMAGE_ASPECT_COLOR_BIT,
+                {.layout = VK_IMAGE_LAYOUT_UNDEFINED, .stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
+                renderer::ResourceState{.layout = swapchain->imageLayout,
+                                        .stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT});
+
+        // only used within the frame, the graph waits for the previous frame to be done with it
+        renderer::RenderGraphImage depth = renderGraph->createImage("depth", {
+                .format = depthImageFormat,
+                .extent = swapchain->extent,
+        });
+
+        if (occlusionCuller && occlusionCuller->enabled) {
+            // objects rejected by the early cull that turn out to be visible get drawn in the late pass
+            renderer::RenderGraphBuffer drawCommands = renderGraph->importBuffer(
+                    "draw commands", occlusionCuller->getDrawCommandsBuffer(currentFrameIndex));
+
+            renderGraph->addPass("early cull", [&](const VkCommandBuffer &cmd) {
+                PROFILE_GPU_ZONE(cmd, currentFrameIndex, "early cull");
+                renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd, currentFrameIndex,
+                                                                  "early cull");
+                occlusionCuller->recordEarlyCull(cmd, currentFrameIndex, scene->objects, camera->getCameraData().VP);
+            }).write(drawCommands, renderer::ResourceUsage::StorageCompute);
+
+            renderGraph->addPass("early pass", [&](const VkCommandBuffer &cmd) {
+                PROFILE_GPU_ZONE(cmd, currentFrameIndex, "early pass");
+                renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd, currentFrameIndex,
+                                                                  "early pass");
+                beginRenderPass(cmd, renderPass->renderPass, framebuffer);
+                drawObjects(cmd, true, false);
+                vkCmdEndRenderPass(cmd);
+            }).read(drawCommands, renderer::ResourceUsage::IndirectBuffer)
+                    .write(color, renderer::ResourceUsage::ColorAttachment)
+                    .write(depth, renderer::ResourceUsage::DepthAttachment);
+
+            // builds the depth pyramid from the depth of the early pass
+            renderGraph->addPass("late cull", [&](const VkCommandBuffer &cmd) {
+                PROFILE_GPU_ZONE(cmd, currentFrameIndex, "late cull");
+                renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd, currentFrameIndex,
+                                                                  "late cull");
+                occlusionCuller->recordLateCull(cmd, currentFrameIndex, renderGraph->getImageView(depth));
+            }).read(depth, renderer::ResourceUsage::SampledCompute)
+                    .write(drawCommands, renderer::ResourceUsage::StorageCompute);
+
+            renderGraph->addPass("late pass", [&](const VkCommandBuffer &cmd) {
+                {
+                    PROFILE_GPU_ZONE(cmd, currentFrameIndex, "late pass");
+                    renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd,
+                                                                      currentFrameIndex, "late pass");
+                    beginRenderPass(cmd, occlusionCuller->lateRenderPass->renderPass, framebuffer);
+                    drawObjects(cmd, true, true);
+                    vkCmdEndRenderPass(cmd);
+                }
+                occlusionCuller->recordEnd(cmd, currentFrameIndex);
+            }).read(drawCommands, renderer::ResourceUsage::IndirectBuffer)
+                    .write(color, renderer::ResourceUsage::ColorAttachment)
+                    .write(depth, renderer::ResourceUsage::DepthAttachment);
+        } else {
+            renderGraph->addPass("main pass", [&](const VkCommandBuffer &cmd) {
+                if (occlusionCuller) {
+                    occlusionCuller->recordUnculledBegin(cmd, currentFrameIndex);
+                }
+
+                {
+                    PROFILE_GPU_ZONE(cmd, currentFrameIndex, "main pass");
+                    renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd,
+                                                                      currentFrameIndex, "main pass");
+                    beginRenderPass(cmd, renderPass->renderPass, framebuffer);
+                    drawObjects(cmd, false, false);
+
+                    // imgui
+//            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+
+                    vkCmdEndRenderPass(cmd);
+                }
+
+                if (occlusionCuller) {
+                    occlusionCuller->recordUnculledEnd(cmd, currentFrameIndex);
+                }
+            }).write(color, renderer::ResourceUsage::ColorAttachment)
+                    .write(depth, renderer::ResourceUsage::DepthAttachment);
+        }
+
+        if (occlusionQueries && occlusionQueries->hasObjects(currentFrameIndex)) {
+            // the query results are read back, so the pass is kept even though nothing reads what it draws
+            renderGraph->addPass("occlusion queries", [&](const VkCommandBuffer &cmd) {
+                PROFILE_GPU_ZONE(cmd, currentFrameIndex, "occlusion queries");
+                renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd, currentFrameIndex,
+                                                                  "occlusion queries");
+                drawQueriedObjects(cmd, framebuffer);
+            }).write(color, renderer::ResourceUsage::ColorAttachment)
+                    .write(depth, renderer::ResourceUsage::DepthAttachment)
+                    .sideEffects();
+        }
 
+        renderGraph->compile();
+
+        // the depth image is kept between frames, and only replaced when its size or usage changes
+        VkImageView depthImageView = renderGraph->getImageView(depth);
+        if (depthImageView != framebufferDepthImageView) {
+            swapchain->retireFramebuffers();
+            swapchain->createFramebuffers(renderPass->renderPass, depthImageView);
+            framebufferDepthImageView = depthImageView;
+            recordingVersion++; // the cached command buffers use the old framebuffers
+        }
+        framebuffer = swapchain->framebuffers[imageIndex];
+
+        renderGraph->execute(cmd);
+
+        renderer::checkResult(vkEndCommandBuffer(cmd));
+    }
+
+    void Engine::beginRenderPass(const VkCommandBuffer &cmd, const VkRenderPass &pass, const VkFramebuffer &framebuffer) {
         VkClearValue clearColor = {.color = {{0.757f, 0.953f, 1.0f, 1.0f}}};
         VkClearValue clearDepth = {.depthStencil{.depth = 1.0f}};
         VkClearValue clearValues[] = {
@@ -207,7 +694,7 @@ namespace engine {
 
         VkRenderPassBeginInfo renderPassInfo{
                 .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .renderPass = renderPass->renderPass,
+                .renderPass = pass,
                 .framebuffer = framebuffer,
                 .renderArea = {
                         .offset = {0, 0},
@@ -232,60 +719,269 @@ namespace engine {
                 .offset = {0, 0},
                 .extent = extent};
         vkCmdSetScissor(cmd, 0, 1, &scissor);
+    }
+
+    /*
+     * Objects are drawn in the order of the draw list: opaque objects front-to-back, then transparent objects
+     * back-to-front. With the depth prepass, the opaque objects are first drawn depth-only, so that the color draws
+     * only shade the closest fragment of each pixel.
+     *
+     * When indirect, the draw arguments are read from the draw commands written by the occlusion culler,
+     * which sets the instance count to 0 for objects that should not be drawn in this pass.
+     *
+     * Objects rejected by the software occlusion culler are not recorded at all.
+     */
+    void Engine::drawObjects(const VkCommandBuffer &cmd, bool indirect, bool late) {
+        boundPipeline = VK_NULL_HANDLE;
+        boundPipelineLayout = VK_NULL_HANDLE;
+        boundMaterialDescriptorSet = VK_NULL_HANDLE;
+        boundMaterialSetLayout = VK_NULL_HANDLE;
+        boundDynamicState.reset();
+
+        // the scopes of the pipeline statistics per draw bucket, of the main, early and late pass
+        static constexpr const char *drawBucketNames[3][3]{
+                {"main pass: depth prepass",  "main pass: opaque",  "main pass: transparent"},
+                {"early pass: depth prepass", "early pass: opaque", "early pass: transparent"},
+                {"late pass: depth prepass",  "late pass: opaque",  "late pass: transparent"},
+        };
+        const char *const *bucketNames = drawBucketNames[indirect ? (late ? 2 : 1) : 0];
+
+        if (depthPrepass) {
+            renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd, currentFrameIndex,
+                                                              bucketNames[0], true);
+            for (size_t i: drawList.opaque) {
+                // shaders that discard fragments are left out, as the prepass would write depth for discarded fragments
+                if (shouldDraw(i) && scene->objects[i]->material.shader.depthPrepass && bindObject(cmd, i, true)) {
+                    drawObject(cmd, i, indirect, late);
+                }
+            }
+        }
+
+        uint32_t pass = late ? 1 : 0;
+        if (overdrawCounter) {
+            overdrawCounter->begin(cmd, currentFrameIndex, pass);
+        }
+
+        // with occlusion culling, transparent objects are only drawn after the late pass, as they don't write depth,
+        // so opaque objects that turn out to be visible in the late pass would otherwise be drawn over them
+        const std::vector<size_t> *queues[]{&drawList.opaque, &drawList.transparent};
+        for (size_t queue = 0; queue < 2; queue++) {
+            bool transparent = queue == 1;
+            if (transparent && indirect && !late) {
+                continue;
+            }
+            renderer::PipelineStatisticsScope statisticsScope(pipelineStatistics.get(), cmd, currentFrameIndex,
+                                                              bucketNames[queue + 1], true);
+            for (size_t i: *queues[queue]) {
+                if (!shouldDraw(i) || !bindObject(cmd, i)) {
+                    continue;
+                }
+                if (transparent && indirect) {
+                    // visible in either the early or the late cull, the command of the other has no instances
+                    drawObject(cmd, i, true, false);
+                    drawObject(cmd, i, true, true);
+                } else {
+                    drawObject(cmd, i, indirect, late);
+                }
+            }
+        }
+
+        if (overdrawCounter) {
+            overdrawCounter->end(cmd, currentFrameIndex, pass);
+        }
+    }
 
-        for (const auto &object: scene->objects) {
-            // bind the pipeline
-            renderer::PipelineData *pipelineData = object->material.shader.pipelineData;
+    bool Engine::shouldDraw(size_t objectIndex) {
+        if (softwareOcclusionCuller && !softwareOcclusionCuller->isVisible(objectIndex)) {
+            return false;
+        }
+
+        // drawn in drawQueriedObjects
+        if (occlusionQueries && scene->objects[objectIndex]->occlusionQuery) {
+            return false;
+        }
+        return true;
+    }
+
+    void Engine::drawObject(const VkCommandBuffer &cmd, size_t objectIndex, bool indirect, bool late) {
+        drawStatistics.drawCalls++;
+        if (indirect) {
+            vkCmdDrawIndexedIndirect(cmd,
+                                     occlusionCuller->getDrawCommandsBuffer(currentFrameIndex),
+                                     occlusionCuller->getDrawCommandOffset(objectIndex, late),
+                                     1, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            const auto &object = scene->objects[objectIndex];
+            vkCmdDrawIndexed(cmd, static_cast<uint32_t>(object->mesh.indices.size()), 1, 0, 0, 0);
+        }
+    }
+
+    /*
+     * Draws the objects that use occlusion queries after all other objects, so that the depth buffer contains
+     * everything that could occlude them.
+     */
+    void Engine::drawQueriedObjects(const VkCommandBuffer &cmd, const VkFramebuffer &framebuffer) {
+        bool conditionalRendering = occlusionQueries->mode == renderer::OcclusionQueryMode::ConditionalRendering;
+
+        beginRenderPass(cmd, occlusionQueries->renderPass->renderPass, framebuffer);
+        occlusionQueries->recordQueries(cmd, currentFrameIndex);
+
+        if (conditionalRendering) {
+            // the query results can only be copied outside a render pass
+            vkCmdEndRenderPass(cmd);
+            occlusionQueries->recordPredicates(cmd, currentFrameIndex);
+            beginRenderPass(cmd, occlusionQueries->renderPass->renderPass, framebuffer);
+        }
+
+        // the bounding boxes are drawn with their own pipeline, which has no extended dynamic state
+        boundPipeline = VK_NULL_HANDLE;
+        boundPipelineLayout = VK_NULL_HANDLE;
+        boundMaterialDescriptorSet = VK_NULL_HANDLE;
+        boundMaterialSetLayout = VK_NULL_HANDLE;
+        boundDynamicState.reset();
+        for (const auto *queue: {&drawList.opaque, &drawList.transparent}) {
+            for (size_t i: *queue) {
+                const auto &object = scene->objects[i];
+                if (!object->occlusionQuery) {
+                    continue;
+                }
+
+                if (softwareOcclusionCuller && !softwareOcclusionCuller->isVisible(i)) {
+                    continue;
+                }
+
+                if (conditionalRendering) {
+                    if (!bindObject(cmd, i)) {
+                        continue;
+                    }
+                    occlusionQueries->beginConditionalRendering(cmd, currentFrameIndex, i);
+                    vkCmdDrawIndexed(cmd, static_cast<uint32_t>(object->mesh.indices.size()), 1, 0, 0, 0);
+                    drawStatistics.drawCalls++;
+                    occlusionQueries->endConditionalRendering(cmd, currentFrameIndex, i);
+                } else if (occlusionQueries->isVisible(i) && bindObject(cmd, i)) {
+                    vkCmdDrawIndexed(cmd, static_cast<uint32_t>(object->mesh.indices.size()), 1, 0, 0, 0);
+                    drawStatistics.drawCalls++;
+                }
+            }
+        }
+
+        vkCmdEndRenderPass(cmd);
+    }
+
+    /*
+     * Binds the pipeline, descriptor sets, object index and buffers of an object, so that it can be drawn.
+     * The transform is read from the transform buffer by the vertex shader.
+     *
+     * Returns false when the object should be skipped, because its pipeline is still being created. Color draws
+     * use the fallback shader in the meantime, when its material set layout matches that of the material.
+     * Skipping a depth-only draw is fine, as the color draw still writes depth.
+     */
+    bool Engine::bindObject(const VkCommandBuffer &cmd, size_t objectIndex, bool depthOnly) {
+        renderer::Object &object = *scene->objects[objectIndex];
+
+        // bind the pipeline
+        renderer::AsyncPipeline *pipeline = depthOnly
+                                            ? &object.material.shader.getDepthOnlyPipeline(object.material.doubleSided)
+                                            : object.material.pipeline;
+        bool usesFallback = !pipeline->isReady() && !depthOnly;
+        if (usesFallback) {
+            // the material's set is only compatible with a fallback that declares the same material bindings
+            renderer::Shader &fallback = object.material.shader.bindless ? *bindlessFallbackShader : *fallbackShader;
+            if (fallback.descriptorSetLayout != object.material.shader.descriptorSetLayout) {
+                return false;
+            }
+            pipeline = &fallback.getPipeline(object.material.queue, object.material.doubleSided);
+        }
+        renderer::PipelineData *pipelineData = pipeline->get();
+        if (pipelineData == nullptr) {
+            return false;
+        }
 
-            // should bind descriptor sets that are owned by either the material or shader.
-            // shader has layout, material has descriptor sets themselves.
+        // the sets are ordered by update frequency. Sets stay bound across pipeline layouts that have the same
+        // push constant ranges and the same layouts up to and including that set. The frame and draw set layouts
+        // are the same for all shaders, so only the push constants and the material set layout are compared
+        // (materials of bindless shaders share their set)
+        const renderer::PipelineConfiguration &configuration = pipeline->getConfiguration();
+        VkDescriptorSetLayout materialSetLayout = object.material.shader.descriptorSetLayout;
+        uint32_t firstSet = 0;
+        uint32_t setCount = 0;
+        if (boundPipelineLayout == VK_NULL_HANDLE ||
+            configuration.pushConstantsSize != boundPushConstantsSize ||
+            configuration.pushConstantsStages != boundPushConstantsStages) {
+            setCount = 3;
+        } else if (materialSetLayout != boundMaterialSetLayout) {
+            firstSet = static_cast<uint32_t>(renderer::DescriptorSetFrequency::Material);
+            setCount = 2;
+        } else if (object.material.descriptorSet != boundMaterialDescriptorSet) {
+            firstSet = static_cast<uint32_t>(renderer::DescriptorSetFrequency::Material);
+            setCount = 1;
+        }
+        if (setCount > 0) {
+            VkDescriptorSet descriptorSets[]{
+                    frameDescriptors->getDescriptorSet(currentFrameIndex),
+                    object.material.descriptorSet,
+                    transformBuffer->getDescriptorSet(currentFrameIndex)
+            };
             vkCmdBindDescriptorSets(cmd,
                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
                                     pipelineData->pipelineLayout,
-                                    0,
-                                    1,//static_cast<uint32_t>(object->material.descriptorSets.size()),
-                                    &object->material.descriptorSet,//object->material.descriptorSets.data(),
+                                    firstSet,
+                                    setCount,
+                                    descriptorSets + firstSet,
                                     0,
                                     nullptr);
+            drawStatistics.descriptorSetBinds++;
+        }
+        boundPipelineLayout = pipelineData->pipelineLayout;
+        boundMaterialDescriptorSet = object.material.descriptorSet;
+        boundMaterialSetLayout = materialSetLayout;
+        boundPushConstantsSize = configuration.pushConstantsSize;
+        boundPushConstantsStages = configuration.pushConstantsStages;
+        // materials with identical pipeline state share the pipeline
+        if (pipelineData->pipeline != boundPipeline) {
             vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineData->pipeline);
+            boundPipeline = pipelineData->pipeline;
+            drawStatistics.pipelineBinds++;
+        }
+        if (boundDynamicState != pipeline->getConfiguration()) {
+            pipelineBuilder->setDynamicState(cmd, pipeline->getConfiguration());
+            boundDynamicState = pipeline->getConfiguration();
+            drawStatistics.dynamicStateChanges++;
+        }
 
-            // push transform matrix using push constants
-            glm::mat4x4 transform = object->getTransform();
+        // push the index into the transform buffer using push constants, and the texture index for bindless shaders.
+        // the parameters of the material are laid out for its own shader, so the fallback reads the zeroed block
+        renderer::MaterialPushConstants pushConstants{
+                .objectIndex = static_cast<uint32_t>(objectIndex),
+                .textureIndex = object.material.textureIndex,
+                .materialIndex = usesFallback ? 0 : object.material.materialIndex,
+        };
+        if (configuration.pushConstantsSize > 0) {
             vkCmdPushConstants(cmd,
                                pipelineData->pipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT,
-                               0, sizeof(transform), &transform);
-            VkDeviceSize vertexBufferOffset = 0;
-            vkCmdBindIndexBuffer(cmd, object->mesh.indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-            vkCmdBindVertexBuffers(cmd, 0, 1, &(object->mesh.vertexBuffer->buffer), &vertexBufferOffset);
-            vkCmdDrawIndexed(cmd, static_cast<uint32_t>(object->mesh.indices.size()), 1, 0, 0, 0);
+                               configuration.pushConstantsStages,
+                               0, configuration.pushConstantsSize, &pushConstants);
+            drawStatistics.pushConstants++;
         }
-
-        // imgui
-//        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
-
-        vkCmdEndRenderPass(cmd);
-        renderer::checkResult(vkEndCommandBuffer(cmd));
+        VkDeviceSize vertexBufferOffset = 0;
+        vkCmdBindIndexBuffer(cmd, object.mesh.indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindVertexBuffers(cmd, 0, 1, &(object.mesh.vertexBuffer->buffer), &vertexBufferOffset);
+        return true;
     }
 
-    void Engine::createDepthImage() {
-        VkExtent3D extent = renderer::toExtent3D(swapchain->extent);
-        VkImageCreateInfo imageInfo = renderer::vk_create::image(depthImageFormat, extent,
-                                                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
-
-        VmaAllocationCreateInfo allocationInfo{
-                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-                .usage = VMA_MEMORY_USAGE_GPU_ONLY,
-                .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        };
-        renderer::checkResult(vmaCreateImage(context->allocator,
-                                   &imageInfo, &allocationInfo,
-                                   &depthImage, &depthImageAllocation, nullptr));
-
-        VkImageViewCreateInfo imageViewInfo = renderer::vk_create::imageView(depthImage, depthImageFormat,
-                                                                   VK_IMAGE_ASPECT_DEPTH_BIT);
-        renderer::checkResult(vkCreateImageView(context->device, &imageViewInfo, nullptr, &depthImageView));
-
-        std::cout << "created depth image" << std::endl;
+    /*
+     * The old swapchain, framebuffers and attachments are retired to the deletion queue, so that the frames in flight
+     * can finish with them while the next frame renders to the new ones, without waiting for the device to be idle
+     */
+    void Engine::recreateSwapchain() {
+        swapchain->recreate();
+        // created with the next command buffer, once the render graph has created the depth image of the new size
+        framebufferDepthImageView = VK_NULL_HANDLE;
+        if (occlusionCuller) {
+            occlusionCuller->resize(swapchain->extent);
+        }
+        framePacer->onSwapchainRecreated(swapchain->presentMode);
+        framebufferResized = false;
+        recordingVersion++; // the framebuffers have been recreated
     }
 }
\ No newline at end of file
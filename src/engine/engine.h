@@ -1,6 +1,8 @@
 #ifndef SPHERE_ENGINE_H
 #define SPHERE_ENGINE_H
 
+#include <functional>
+#include <optional>
 #include <string>
 #include <iostream>
 
@@ -15,6 +17,22 @@
 #include "renderer/scene.h"
 #include "renderer/mesh.h"
 #include "renderer/material_system.h"
+#include "renderer/shader_compiler.h"
+#include "renderer/bindless_textures.h"
+#include "renderer/frame_descriptors.h"
+#include "renderer/material_buffer.h"
+#include "renderer/occlusion_culling.h"
+#include "renderer/software_occlusion.h"
+#include "renderer/occlusion_queries.h"
+#include "renderer/draw_list.h"
+#include "renderer/overdraw.h"
+#include "renderer/pipeline_statistics.h"
+#include "renderer/transform_buffer.h"
+#include "renderer/deletion_queue.h"
+#include "renderer/frame_pacer.h"
+#include "renderer/profiler.h"
+#include "renderer/render_graph.h"
+#include "thread_pool.h"
 
 namespace engine {
 
@@ -22,12 +40,68 @@ namespace engine {
     const uint32_t ENGINE_VERSION = VK_MAKE_VERSION(1, 0, 0);
 
     struct EngineConfiguration {
+        // nullptr renders headless into offscreen images of headlessExtent, e.g. with lavapipe on machines without a gpu
         GLFWwindow *window;
 
         bool debug;
 
         const std::string applicationName;
         const uint32_t applicationVersion;
+
+        // two phase Hi-Z occlusion culling, requires compute support on the graphics queue
+        bool occlusionCulling;
+
+        // rasterizes objects marked as occluder on the cpu and skips drawing objects hidden behind them,
+        // does not require compute support
+        bool softwareOcclusionCulling;
+
+        // objects with Object::occlusionQuery set are skipped when their bounding box is occluded,
+        // uses VK_EXT_conditional_rendering when supported
+        bool occlusionQueries;
+
+        // draws the opaque objects depth-only before shading them, so that each pixel is shaded once,
+        // for scenes that are limited by fill rate
+        bool depthPrepass;
+
+        // counts the samples that get shaded each frame, requires precise occlusion queries
+        bool measureOverdraw;
+
+        // counts the vertices, primitives and shader invocations of each pass, see PipelineStatisticsQueries.
+        // Requires the pipelineStatisticsQuery device feature
+        bool pipelineStatistics;
+
+        // populates the empty scene, loads the demo scene when not set
+        std::function<void(renderer::Scene &scene)> createScene;
+
+        // records the command buffers once and reuses them until the scene structure or draw order changes,
+        // not used together with the occlusion cullers and occlusion queries, which record state for each frame
+        bool cacheCommandBuffers;
+
+        // sets the cull mode, depth and blend state of materials for each draw when the device supports it,
+        // so that fewer pipelines have to be created
+        bool extendedDynamicState;
+
+        // recompiles shaders compiled at runtime (e.g. shader variants) when their source or included files change,
+        // such as when the shaders build step copies the edited sources into the shaders directory
+        bool hotReloadShaders;
+
+        // materials of shaders with a BINDLESS variant reference their texture by index into one global
+        // texture array, so that switching between them binds no descriptor sets. Requires descriptor indexing
+        bool bindlessTextures;
+
+        // MAILBOX and IMMEDIATE lower the latency compared to FIFO, falls back to FIFO when not supported
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+        // frames the cpu can record ahead of the gpu, more frames smooth out variance at the cost of latency
+        uint32_t framesInFlight = 2;
+
+        // delays the start of each frame so that input is sampled as late as possible, see FramePacer
+        bool framePacing;
+
+        // records cpu zones and gpu timestamps from the start, see Profiler. Can also be started later
+        bool profiling;
+
+        VkExtent2D headlessExtent = {1280, 720};
     };
 
     /*
@@ -36,6 +110,10 @@ namespace engine {
     struct FrameData {
         VkCommandBuffer commandBuffer;
 
+        // when command buffers are cached, one per swapchain image, as the framebuffer is part of the recording
+        std::vector<VkCommandBuffer> cachedCommandBuffers;
+        std::vector<uint64_t> cachedVersions; // recording version each cached command buffer was recorded with
+
         // synchronization primitives
         VkFence inFlightFence;
         VkSemaphore imageAvailableSemaphore;
@@ -45,6 +123,20 @@ namespace engine {
         void destroy() const;
     };
 
+    struct CommandBufferStatistics {
+        uint32_t recorded;
+        uint32_t reused;
+    };
+
+    // the commands that were recorded, which cached command buffers execute again without recording
+    struct DrawStatistics {
+        uint32_t drawCalls; // including indirect draws that the occlusion culler may set to 0 instances
+        uint32_t pipelineBinds;
+        uint32_t descriptorSetBinds; // vkCmdBindDescriptorSets calls
+        uint32_t dynamicStateChanges; // with extended dynamic state
+        uint32_t pushConstants;
+    };
+
     /*
      * Engine is the main entry point that draws everything.
      */
@@ -55,38 +147,118 @@ namespace engine {
         ~Engine();
 
         std::unique_ptr<renderer::VulkanContext> context;
+        std::unique_ptr<renderer::DeletionQueue> deletionQueue; // objects replaced while frames are in flight
         std::unique_ptr<renderer::Swapchain> swapchain;
         std::unique_ptr<renderer::RenderPass> renderPass;
         std::unique_ptr<renderer::DescriptorSetBuilder> descriptorSetBuilder;
         std::unique_ptr<renderer::PipelineBuilder> pipelineBuilder;
+        std::unique_ptr<renderer::TransformBuffer> transformBuffer;
+        std::unique_ptr<renderer::FrameDescriptors> frameDescriptors;
+        std::unique_ptr<renderer::MaterialBuffer> materialBuffer;
+        std::unique_ptr<renderer::ShaderCompiler> shaderCompiler; // compiles shader variants on first use
+        std::unique_ptr<renderer::Shader> fallbackShader; // used for materials whose pipelines are not ready yet
+        std::unique_ptr<renderer::BindlessTextures> bindlessTextures; // nullptr when not used
+        std::unique_ptr<renderer::Shader> bindlessFallbackShader; // for materials of bindless shaders
         std::unique_ptr<renderer::Camera> camera;
         std::unique_ptr<renderer::Scene> scene;
+        std::unique_ptr<renderer::OcclusionCuller> occlusionCuller; // nullptr when occlusion culling is not used
+        std::unique_ptr<ThreadPool> threadPool; // shared by pipeline creation and software occlusion culling
+        std::unique_ptr<renderer::SoftwareOcclusionCuller> softwareOcclusionCuller; // nullptr when not used
+        std::unique_ptr<renderer::OcclusionQueries> occlusionQueries; // nullptr when not used
+        std::unique_ptr<renderer::OverdrawCounter> overdrawCounter; // nullptr when not used
+        std::unique_ptr<renderer::PipelineStatisticsQueries> pipelineStatistics; // nullptr when not used
+        std::unique_ptr<renderer::FramePacer> framePacer;
+        std::unique_ptr<renderer::Profiler> profiler;
+        std::unique_ptr<renderer::RenderGraph> renderGraph; // built again each time a command buffer is recorded
 
         VkCommandPool commandPool;
-        bool framebufferResized = false;
+        bool framebufferResized = false; // or the present mode changed
+        bool rendering = false; // the resize callback renders, except when it is called from within render()
 
+        bool depthPrepass;
+        bool sortOpaqueObjects = true; // front-to-back, otherwise opaque objects are drawn in scene order
+        bool cacheCommandBuffers;
+        bool hotReloadShaders;
+        CommandBufferStatistics commandBufferStatistics{}; // since the last time the statistics were printed
+        DrawStatistics drawStatistics{}; // of the last recorded command buffer
+
+        // delays the start of the frame when frame pacing is enabled, should be called before sampling input.
+        // Called by render() when it was not called before
+        void waitForFrameStart();
         void render();
 
+        // the swapchain is recreated after the next present, falls back to FIFO when not supported
+        void setPresentMode(VkPresentModeKHR presentMode);
+
+        // headless only, waits for the device and returns the pixels of the last rendered frame,
+        // 4 bytes per pixel in the order of the swapchain format (e.g. BGRA)
+        std::vector<uint8_t> readFrame();
+
     private:
         const std::vector<const char *> requiredDeviceExtensions{
                 VK_KHR_SWAPCHAIN_EXTENSION_NAME
         };
 
-        const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+        const std::vector<const char *> optionalDeviceExtensions{
+                VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME,
+                VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+                VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+                VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME,
+                VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME,
+                VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+        };
+
+        // optional as well, but they require the swapchain extension, so they are left out when headless
+        const std::vector<const char *> optionalPresentDeviceExtensions{
+                VK_KHR_PRESENT_ID_EXTENSION_NAME,
+                VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+        };
+
+        const uint32_t framesInFlight;
         uint32_t currentFrameIndex = 0;
+        uint32_t renderedImageIndex = 0; // of the last submitted frame
         std::vector<FrameData> frames;
+        uint64_t frameCount = 0;
+        renderer::DrawList drawList;
+        VkPipeline boundPipeline = VK_NULL_HANDLE; // while recording, to skip redundant binds
+        VkPipelineLayout boundPipelineLayout = VK_NULL_HANDLE;
+        VkDescriptorSet boundMaterialDescriptorSet = VK_NULL_HANDLE; // set 1, the frame and draw sets follow the layout
+        // what the bound sets stay compatible with, see bindObject
+        VkDescriptorSetLayout boundMaterialSetLayout = VK_NULL_HANDLE;
+        uint32_t boundPushConstantsSize = 0;
+        VkShaderStageFlags boundPushConstantsStages = 0;
+        std::optional<renderer::PipelineConfiguration> boundDynamicState;
+
+        // incremented when anything that is part of the recorded commands changes, invalidating cached command buffers
+        uint64_t recordingVersion = 1;
+        renderer::DrawList recordedDrawList;
+        uint64_t recordedSceneVersion = 0;
+        uint64_t recordedCompletedPipelines = 0;
+        bool recordedDepthPrepass = false;
+        bool recordedProfiling = false; // gpu zones are only written into command buffers recorded while profiling
+        bool recordedPerDrawBucket = false; // of the pipeline statistics
 
         const VkFormat depthImageFormat = VK_FORMAT_D16_UNORM;
-        VkImage depthImage;
-        VkImageView depthImageView;
-        VmaAllocation depthImageAllocation;
+        // the depth image is created by the render graph, the framebuffers are created again when it is replaced
+        VkImageView framebufferDepthImageView = VK_NULL_HANDLE;
 
         // drawing
         void drawFrame();
-        void recordCommandBuffer(const FrameData &frameData, const VkFramebuffer &framebuffer);
+        void updateRecordingVersion();
+        [[nodiscard]] bool canCacheCommandBuffers() const;
+        VkCommandBuffer getCommandBuffer(FrameData &frameData, uint32_t imageIndex);
+        void recordCommandBuffer(const VkCommandBuffer &cmd, uint32_t imageIndex);
+        void beginRenderPass(const VkCommandBuffer &cmd, const VkRenderPass &pass, const VkFramebuffer &framebuffer);
+        void drawObjects(const VkCommandBuffer &cmd, bool indirect, bool late);
+        void drawQueriedObjects(const VkCommandBuffer &cmd, const VkFramebuffer &framebuffer);
+        bool shouldDraw(size_t objectIndex);
+        void drawObject(const VkCommandBuffer &cmd, size_t objectIndex, bool indirect, bool late);
+        bool bindObject(const VkCommandBuffer &cmd, size_t objectIndex, bool depthOnly = false);
+
+        // replaces the swapchain and the attachments and resources that depend on its size
+        void recreateSwapchain();
 
         // to be refactored
-        void createDepthImage();
     };
 
     extern Engine *engine;
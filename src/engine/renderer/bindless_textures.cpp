@@ -0,0 +1,120 @@
+#include "bindless_textures.h"
+
+#include "vulkan_context.h"
+#include "descriptor_sets.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine::renderer {
+
+    BindlessTextures *bindlessTextures;
+
+    BindlessTextures::BindlessTextures(uint32_t capacity) {
+        assert((bindlessTextures == nullptr) && "Only one bindless texture array can exist at one time");
+        bindlessTextures = this;
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+        };
+        VkPhysicalDeviceProperties2 properties{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                .pNext = &indexingProperties,
+        };
+        vkGetPhysicalDeviceProperties2(context->physicalDevice, &properties);
+        this->capacity = std::min({capacity,
+                                   indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                   indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings{
+                {
+                        .binding = 0,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .descriptorCount = this->capacity,
+                        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+                },
+        };
+        std::vector<VkDescriptorBindingFlagsEXT> bindingFlags{
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+        };
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+                .bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+                .pBindingFlags = bindingFlags.data(),
+        };
+        VkDescriptorSetLayoutCreateInfo layoutInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext = &bindingFlagsInfo,
+                .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+                .bindingCount = static_cast<uint32_t>(bindings.size()),
+                .pBindings = bindings.data(),
+        };
+        checkResult(vkCreateDescriptorSetLayout(context->device, &layoutInfo, nullptr, &descriptorSetLayout));
+
+        // sets with update-after-bind bindings have to be allocated from a pool with the same flag
+        std::vector<VkDescriptorPoolSize> poolSizes{
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, this->capacity},
+        };
+        VkDescriptorPoolCreateInfo poolInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+                .maxSets = 1,
+                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                .pPoolSizes = poolSizes.data(),
+        };
+        checkResult(vkCreateDescriptorPool(context->device, &poolInfo, nullptr, &descriptorPool));
+
+        VkDescriptorSetAllocateInfo allocateInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = descriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &descriptorSetLayout,
+        };
+        checkResult(vkAllocateDescriptorSets(context->device, &allocateInfo, &descriptorSet));
+
+        std::cout << "created bindless texture array with capacity: " << this->capacity << std::endl;
+    }
+
+    BindlessTextures::~BindlessTextures() {
+        vkDestroyDescriptorPool(context->device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(context->device, descriptorSetLayout, nullptr);
+    }
+
+    uint32_t BindlessTextures::getIndex(Texture &texture) {
+        auto it = indices.find(&texture);
+        if (it != indices.end()) {
+            return it->second;
+        }
+
+        auto index = static_cast<uint32_t>(indices.size());
+        if (index >= capacity) {
+            throw std::runtime_error("bindless texture array is full");
+        }
+
+        // the index was not used before, so no command buffer in flight reads it
+        VkDescriptorImageInfo imageInfo{
+                .sampler = texture.sampler,
+                .imageView = texture.imageView,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        VkWriteDescriptorSet writeInfo{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = descriptorSet,
+                .dstBinding = 0,
+                .dstArrayElement = index,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &imageInfo,
+        };
+        vkUpdateDescriptorSets(context->device, 1, &writeInfo, 0, nullptr);
+
+        indices.emplace(&texture, index);
+        return index;
+    }
+
+    uint32_t BindlessTextures::getCapacity() const {
+        return capacity;
+    }
+}
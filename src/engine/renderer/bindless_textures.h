@@ -0,0 +1,43 @@
+#ifndef SPHERE_BINDLESS_TEXTURES_H
+#define SPHERE_BINDLESS_TEXTURES_H
+
+#include "vulkan.h"
+#include "texture.h"
+
+#include <unordered_map>
+
+namespace engine::renderer {
+
+    /*
+     * One global material descriptor set that contains an array of all textures, using VK_EXT_descriptor_indexing.
+     * Materials of bindless shaders reference their texture by index, which is pushed together with the object index,
+     * so that drawing with a different material binds no descriptor sets.
+     *
+     * The texture array is partially bound and update-after-bind, so that textures can be added while
+     * command buffers that use the set are in flight.
+     */
+    class BindlessTextures {
+
+    public:
+        // the capacity is clamped to the limits of the device
+        explicit BindlessTextures(uint32_t capacity = 4096);
+        ~BindlessTextures();
+
+        VkDescriptorSetLayout descriptorSetLayout;
+        VkDescriptorSet descriptorSet;
+
+        // adds the texture to the array if it was not added before, throws when the array is full
+        uint32_t getIndex(Texture &texture);
+
+        [[nodiscard]] uint32_t getCapacity() const;
+
+    private:
+        VkDescriptorPool descriptorPool;
+        uint32_t capacity;
+        std::unordered_map<const Texture *, uint32_t> indices;
+    };
+
+    extern BindlessTextures *bindlessTextures; // nullptr when descriptor indexing is not supported
+}
+
+#endif //SPHERE_BINDLESS_TEXTURES_H
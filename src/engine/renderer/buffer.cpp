@@ -3,7 +3,7 @@
 
 namespace engine::renderer {
 
-    Buffer::Buffer(size_t size, VkBufferUsageFlags usage) : size(size), allocator(context->allocator) {
+    Buffer::Buffer(size_t size, VkBufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags) : size(size), allocator(context->allocator) {
         VkBufferCreateInfo bufferInfo{
                 .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                 .size = size, // size in bytes, should be greater than zero
@@ -12,7 +12,7 @@ namespace engine::renderer {
         };
 
         VmaAllocationCreateInfo allocationInfo{
-                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                .flags = allocationFlags,
                 .usage = VMA_MEMORY_USAGE_AUTO,
                 .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         };
@@ -34,4 +34,20 @@ namespace engine::renderer {
         vmaUnmapMemory(allocator, allocation);
     }
 
+    /*
+     * Copies the contents of the buffer into data, buffers that are read from should be created
+     * with VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT
+     */
+    void Buffer::read(void *data) {
+        void *mappedData;
+        vmaMapMemory(allocator, allocation, &mappedData);
+        memcpy(data, mappedData, size);
+        vmaUnmapMemory(allocator, allocation);
+    }
+
+    void *Buffer::getMappedData() const {
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+        return allocationInfo.pMappedData;
+    }
 }
\ No newline at end of file
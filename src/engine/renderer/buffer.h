@@ -11,12 +11,17 @@ namespace engine::renderer {
     class Buffer {
 
     public:
-        explicit Buffer(size_t size, VkBufferUsageFlags usage);
+        explicit Buffer(size_t size, VkBufferUsageFlags usage,
+                        VmaAllocationCreateFlags allocationFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
         ~Buffer();
 
         VkBuffer buffer;
 
         void update(const void *data);
+        void read(void *data);
+
+        // only valid when created with VMA_ALLOCATION_CREATE_MAPPED_BIT, stays mapped until the buffer is destroyed
+        [[nodiscard]] void *getMappedData() const;
 
     private:
         VmaAllocator allocator;
@@ -7,8 +7,7 @@
 namespace engine::renderer {
 
     Camera::Camera(Swapchain &swapchain) :
-            swapchain(swapchain),
-            cameraDataBuffer(sizeof(cameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+            swapchain(swapchain) {
 
     }
 
@@ -33,7 +32,10 @@ namespace engine::renderer {
         glm::mat4 vp = Projection * View;
         cameraData.VP = vp;
 
-        // then update the buffer
-        cameraDataBuffer.update(&cameraData);
+        // the buffer is updated by the frame descriptors, once the frame in flight can be written
+    }
+
+    const CameraData &Camera::getCameraData() const {
+        return cameraData;
     }
 }
\ No newline at end of file
@@ -20,9 +20,9 @@ namespace engine::renderer {
 
         glm::vec3 position;
         glm::quat rotation{0, 0, 0, 1};
-        Buffer cameraDataBuffer;
 
         void updateCameraData();
+        const CameraData &getCameraData() const;
     private:
         Swapchain &swapchain;
 
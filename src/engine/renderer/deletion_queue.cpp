@@ -0,0 +1,37 @@
+#include "deletion_queue.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace engine::renderer {
+
+    DeletionQueue *deletionQueue;
+
+    DeletionQueue::DeletionQueue(uint32_t framesInFlight) {
+        assert((deletionQueue == nullptr) && "Only one deletion queue can exist at one time");
+        deletionQueue = this;
+
+        frames.resize(framesInFlight);
+
+        std::cout << "created deletion queue" << std::endl;
+    }
+
+    DeletionQueue::~DeletionQueue() {
+        for (auto &frame: frames) {
+            frame.flush();
+        }
+        deletionQueue = nullptr;
+    }
+
+    void DeletionQueue::push(std::function<void()> &&destroy) {
+        frames[submittedFrameIndex].push(std::move(destroy));
+    }
+
+    void DeletionQueue::beginFrame(uint32_t frameIndex) {
+        frames[frameIndex].flush();
+    }
+
+    void DeletionQueue::endFrame(uint32_t frameIndex) {
+        submittedFrameIndex = frameIndex;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SPHERE_DELETION_QUEUE_H
+#define SPHERE_DELETION_QUEUE_H
+
+#include "utils.h"
+
+#include <functional>
+#include <vector>
+
+namespace engine::renderer {
+
+    /*
+     * Defers destroying objects that the commands of frames in flight could still use, such as the swapchain,
+     * framebuffers and attachments that get replaced when the window is resized, so that they can be replaced
+     * without waiting for the device to be idle.
+     *
+     * Retired objects are destroyed once the most recently submitted frame has completed, which is when that frame
+     * begins again after waiting for its fence. Then the submissions of all earlier frames have completed as well.
+     */
+    class DeletionQueue {
+
+    public:
+        explicit DeletionQueue(uint32_t framesInFlight);
+        // destroys all retired objects, the device should be idle
+        ~DeletionQueue();
+
+        // destroyed once the most recently submitted frame has completed
+        void push(std::function<void()> &&destroy);
+
+        // destroys the objects that were retired after the previous submission of the frame,
+        // should be called after waiting for the in flight fence of the frame
+        void beginFrame(uint32_t frameIndex);
+
+        // should be called after submitting the frame
+        void endFrame(uint32_t frameIndex);
+
+    private:
+        std::vector<DestroyQueue> frames;
+        uint32_t submittedFrameIndex = 0;
+    };
+
+    extern DeletionQueue *deletionQueue;
+}
+
+#endif //SPHERE_DELETION_QUEUE_H
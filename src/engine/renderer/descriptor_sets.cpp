@@ -1,6 +1,7 @@
 #include "vulkan_context.h"
 #include "descriptor_sets.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
@@ -8,15 +9,56 @@ namespace engine::renderer {
 
     DescriptorSetBuilder *descriptorSetBuilder;
 
-    DescriptorSetBuilder::DescriptorSetBuilder() {
+    DescriptorSetBuilder::DescriptorSetBuilder(uint32_t framesInFlight) {
         assert((descriptorSetBuilder == nullptr) && "Only one descriptor set builder can exist at one time");
         descriptorSetBuilder = this;
 
-        createDescriptorPool();
+        allocator = std::make_unique<DescriptorAllocator>(256);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            transientAllocators.push_back(std::make_unique<DescriptorAllocator>(64));
+        }
     }
 
     DescriptorSetBuilder::~DescriptorSetBuilder() {
-        vkDestroyDescriptorPool(context->device, descriptorPool, nullptr);
+        transientAllocators.clear();
+        allocator.reset();
+        for (const auto &entry: descriptorSetLayouts) {
+            vkDestroyDescriptorSetLayout(context->device, entry.second, nullptr);
+        }
+    }
+
+    static bool isEqual(const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+        return a.binding == b.binding &&
+               a.descriptorType == b.descriptorType &&
+               a.descriptorCount == b.descriptorCount &&
+               a.stageFlags == b.stageFlags &&
+               a.pImmutableSamplers == b.pImmutableSamplers;
+    }
+
+    /*
+     * There are only a few distinct layouts, so a linear search suffices
+     */
+    VkDescriptorSetLayout
+    DescriptorSetBuilder::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+        for (const auto &entry: descriptorSetLayouts) {
+            if (std::equal(entry.first.begin(), entry.first.end(), bindings.begin(), bindings.end(), isEqual)) {
+                return entry.second;
+            }
+        }
+
+        VkDescriptorSetLayout layout = createDescriptorSetLayout(bindings);
+        descriptorSetLayouts.emplace_back(bindings, layout);
+        return layout;
+    }
+
+    const std::vector<VkDescriptorSetLayoutBinding> &DescriptorSetBuilder::getBindings(VkDescriptorSetLayout layout) const {
+        static const std::vector<VkDescriptorSetLayoutBinding> empty;
+        for (const auto &entry: descriptorSetLayouts) {
+            if (entry.second == layout) {
+                return entry.first;
+            }
+        }
+        return empty;
     }
 
     /*
@@ -36,112 +78,211 @@ namespace engine::renderer {
         return descriptorSetLayout;
     }
 
-    VkDescriptorSetLayout createDescriptorSetLayout() {
-        VkDescriptorSetLayoutBinding cameraData{
-                .binding = 0,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = 1,
-                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-                .pImmutableSamplers = nullptr
-        };
+    /*
+     * Creates descriptor sets with a given amount of sets per layout
+     *
+     * input: layout = L1, amount = 3
+     * output: [L1, L1, L1]
+     */
+    std::vector<VkDescriptorSet>
+    DescriptorSetBuilder::createDescriptorSets(VkDescriptorSetLayout layout, size_t amount) {
+        return allocator->allocate(layout, getBindings(layout), amount);
+    }
 
-        VkDescriptorSetLayoutBinding diffuse{
-                .binding = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1,
-                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .pImmutableSamplers = nullptr
-        };
+    VkDescriptorSet DescriptorSetBuilder::createTransientDescriptorSet(uint32_t frameIndex, VkDescriptorSetLayout layout) {
+        return transientAllocators[frameIndex]->allocate(layout, getBindings(layout), 1)[0];
+    }
 
-        std::vector<VkDescriptorSetLayoutBinding> bindings{
-                cameraData,
-                diffuse
-        };
+    void DescriptorSetBuilder::resetTransientDescriptorSets(uint32_t frameIndex) {
+        transientAllocators[frameIndex]->reset();
+    }
 
-        return createDescriptorSetLayout(bindings);
+    void DescriptorSetBuilder::printStatistics() const {
+        DescriptorAllocatorStatistics transient{};
+        for (auto const &transientAllocator: transientAllocators) {
+            const DescriptorAllocatorStatistics &frame = transientAllocator->getStatistics();
+            transient.pools += frame.pools;
+            transient.allocatedSets += frame.allocatedSets;
+            transient.resets += frame.resets;
+        }
+        const DescriptorAllocatorStatistics &persistent = allocator->getStatistics();
+        std::cout << "descriptor sets: persistent: " << persistent.allocatedSets << " in " << persistent.pools
+                  << " pools, transient: " << transient.allocatedSets << " in " << transient.pools
+                  << " pools (" << transient.resets << " resets)" << std::endl;
     }
 
-    void DescriptorSetBuilder::createDescriptorPool() {
-        std::vector<VkDescriptorPoolSize> poolSizes{
-                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1000},
-                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000},
-        };
+    DescriptorAllocator::DescriptorAllocator(uint32_t setsPerPool, uint32_t maxSetsPerPool) :
+            setsPerPool(setsPerPool),
+            maxSetsPerPool(maxSetsPerPool) {
+    }
 
-        VkDescriptorPoolCreateInfo poolInfo{
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-                .maxSets = 1000,
-                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
-                .pPoolSizes = poolSizes.data(),
-        };
-        checkResult(vkCreateDescriptorPool(context->device, &poolInfo, nullptr, &descriptorPool));
-        std::cout << "created descriptor pool" << std::endl;
+    DescriptorAllocator::~DescriptorAllocator() {
+        if (currentPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(context->device, currentPool, nullptr);
+        }
+        for (auto pool: fullPools) {
+            vkDestroyDescriptorPool(context->device, pool, nullptr);
+        }
+        for (auto pool: freePools) {
+            vkDestroyDescriptorPool(context->device, pool, nullptr);
+        }
     }
 
-    /*
-     * Creates descriptor sets with a given amount of sets per layout
-     *
-     * input: layouts = [L1, L2, L3], amount = 2
-     * output: [L1, L2, L3, L1, L2, L3]
-     */
-    std::vector<VkDescriptorSet>
-    DescriptorSetBuilder::createDescriptorSets(VkDescriptorSetLayout layout, size_t amount) {
+    std::vector<VkDescriptorSet> DescriptorAllocator::allocate(VkDescriptorSetLayout layout,
+                                                               const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                                                               size_t amount) {
+        // counted before allocating, so that a new pool also fits these sets
+        for (auto const &binding: bindings) {
+            descriptorCounts[binding.descriptorType] += static_cast<uint64_t>(binding.descriptorCount) * amount;
+        }
+        allocatedSets += amount;
+        statistics.allocatedSets += amount;
 
         std::vector<VkDescriptorSet> descriptorSets(amount);
         std::vector<VkDescriptorSetLayout> layouts(amount, layout);
-
         VkDescriptorSetAllocateInfo allocateInfo{
                 .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = descriptorPool,
                 .descriptorSetCount = static_cast<uint32_t>(amount),
                 .pSetLayouts = layouts.data(),
         };
-        checkResult(vkAllocateDescriptorSets(context->device, &allocateInfo, descriptorSets.data()));
-        std::cout << "created descriptor sets" << std::endl;
+        while (true) {
+            bool createdPool = false;
+            if (currentPool == VK_NULL_HANDLE) {
+                createdPool = freePools.empty();
+                currentPool = getPool(static_cast<uint32_t>(amount));
+            }
+            allocateInfo.descriptorPool = currentPool;
+            VkResult result = vkAllocateDescriptorSets(context->device, &allocateInfo, descriptorSets.data());
+            if (result == VK_SUCCESS) {
+                return descriptorSets;
+            }
 
-        return descriptorSets;
+            // a pool that was created for these sets should fit them, so only then the error is thrown
+            if ((result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) || createdPool) {
+                checkResult(result);
+            }
+            fullPools.push_back(currentPool);
+            currentPool = VK_NULL_HANDLE;
+        }
     }
 
-    void bindImage(VkDescriptorSet &descriptorSet, VkSampler &sampler, VkImageView &imageView, uint32_t dstBinding) {
-        VkDescriptorImageInfo imageInfo{
-                .sampler = sampler,
-                .imageView = imageView,
-                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,// VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    VkDescriptorPool DescriptorAllocator::getPool(uint32_t minSets) {
+        if (!freePools.empty()) {
+            VkDescriptorPool pool = freePools.back();
+            freePools.pop_back();
+            return pool;
+        }
+
+        uint32_t maxSets = std::max(setsPerPool, minSets);
+
+        // the descriptors per set of each type that was used so far, with a minimum for the common types,
+        // so that sets with a layout that was not seen before can still be allocated
+        std::unordered_map<VkDescriptorType, uint32_t> descriptors{
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         16},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         16},
+                {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          16},
+        };
+        for (auto const &[type, count]: descriptorCounts) {
+            auto observed = static_cast<uint32_t>((count * maxSets + allocatedSets - 1) / allocatedSets);
+            descriptors[type] = std::max(descriptors[type], observed);
+        }
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (auto const &[type, count]: descriptors) {
+            poolSizes.push_back({type, count});
+        }
+
+        VkDescriptorPool pool;
+        VkDescriptorPoolCreateInfo poolInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .maxSets = maxSets,
+                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                .pPoolSizes = poolSizes.data(),
         };
+        checkResult(vkCreateDescriptorPool(context->device, &poolInfo, nullptr, &pool));
+        statistics.pools++;
+        std::cout << "created descriptor pool with " << maxSets << " sets" << std::endl;
 
-        VkWriteDescriptorSet writeInfo{
+        // a growing application needs fewer pools
+        setsPerPool = std::min(setsPerPool * 2, maxSetsPerPool);
+        return pool;
+    }
+
+    void DescriptorAllocator::reset() {
+        if (currentPool == VK_NULL_HANDLE && fullPools.empty()) {
+            return;
+        }
+        if (currentPool != VK_NULL_HANDLE) {
+            fullPools.push_back(currentPool);
+            currentPool = VK_NULL_HANDLE;
+        }
+        for (auto pool: fullPools) {
+            checkResult(vkResetDescriptorPool(context->device, pool, 0));
+            freePools.push_back(pool);
+        }
+        fullPools.clear();
+        statistics.resets++;
+    }
+
+    const DescriptorAllocatorStatistics &DescriptorAllocator::getStatistics() const {
+        return statistics;
+    }
+
+    DescriptorWriter &DescriptorWriter::writeBuffer(VkDescriptorSet descriptorSet, uint32_t dstBinding, VkBuffer buffer,
+                                                    VkDescriptorType descriptorType,
+                                                    VkDeviceSize offset, VkDeviceSize range) {
+        VkDescriptorBufferInfo &bufferInfo = bufferInfos.emplace_back(VkDescriptorBufferInfo{
+                .buffer = buffer,
+                .offset = offset,
+                .range = range,
+        });
+        writes.push_back({
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .pNext = nullptr,
                 .dstSet = descriptorSet,
                 .dstBinding = dstBinding,
                 .dstArrayElement = 0,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .pImageInfo = &imageInfo,
-                .pBufferInfo = nullptr,
-                .pTexelBufferView = nullptr,
-        };
-        vkUpdateDescriptorSets(context->device, 1, &writeInfo, 0, nullptr);
+                .descriptorType = descriptorType,
+                .pBufferInfo = &bufferInfo,
+        });
+        return *this;
     }
 
-    void bindBuffer(VkDescriptorSet &descriptorSet, VkBuffer &buffer, uint32_t dstBinding) {
-        VkDescriptorBufferInfo bufferInfo{
-                .buffer = buffer,
-                .offset = 0,
-                .range = VK_WHOLE_SIZE,
-        };
-
-        VkWriteDescriptorSet writeInfo{
+    DescriptorWriter &DescriptorWriter::writeImage(VkDescriptorSet descriptorSet, uint32_t dstBinding,
+                                                   VkSampler sampler, VkImageView imageView,
+                                                   VkImageLayout imageLayout, VkDescriptorType descriptorType) {
+        VkDescriptorImageInfo &imageInfo = imageInfos.emplace_back(VkDescriptorImageInfo{
+                .sampler = sampler,
+                .imageView = imageView,
+                .imageLayout = imageLayout,
+        });
+        writes.push_back({
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .pNext = nullptr,
                 .dstSet = descriptorSet,
                 .dstBinding = dstBinding,
                 .dstArrayElement = 0,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .pImageInfo = nullptr,
-                .pBufferInfo = &bufferInfo,
-                .pTexelBufferView = nullptr,
-        };
-        vkUpdateDescriptorSets(context->device, 1, &writeInfo, 0, nullptr);
+                .descriptorType = descriptorType,
+                .pImageInfo = &imageInfo,
+        });
+        return *this;
+    }
+
+    void DescriptorWriter::update() {
+        if (!writes.empty()) {
+            vkUpdateDescriptorSets(context->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+        writes.clear();
+        bufferInfos.clear();
+        imageInfos.clear();
+    }
+
+    void bindImage(VkDescriptorSet &descriptorSet, VkSampler &sampler, VkImageView &imageView, uint32_t dstBinding,
+                   VkImageLayout imageLayout, VkDescriptorType descriptorType) {
+        DescriptorWriter().writeImage(descriptorSet, dstBinding, sampler, imageView, imageLayout, descriptorType).update();
+    }
+
+    void bindBuffer(VkDescriptorSet &descriptorSet, VkBuffer &buffer, uint32_t dstBinding, VkDescriptorType descriptorType) {
+        DescriptorWriter().writeBuffer(descriptorSet, dstBinding, buffer, descriptorType).update();
     }
-}
\ No newline at end of file
+}
@@ -2,6 +2,10 @@
 #define SPHERE_DESCRIPTOR_SETS_H
 
 #include <vulkan/vulkan.h>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace engine::renderer {
@@ -57,22 +61,123 @@ namespace engine::renderer {
      *
      * Pipeline layout and descriptor sets need to be compatible (so created together)
      */
+    class DescriptorAllocator;
+
     class DescriptorSetBuilder {
 
     public:
-        explicit DescriptorSetBuilder();
+        // each frame in flight gets its own transient pools
+        explicit DescriptorSetBuilder(uint32_t framesInFlight = 1);
         ~DescriptorSetBuilder();
+
+        // allocated for the lifetime of the builder
         std::vector<VkDescriptorSet> createDescriptorSets(VkDescriptorSetLayout layout, size_t amount);
 
+        // valid until the transient sets of the frame are reset, should only be written while recording the frame,
+        // so not for command buffers that are cached across frames
+        VkDescriptorSet createTransientDescriptorSet(uint32_t frameIndex, VkDescriptorSetLayout layout);
+
+        // should only be called when the commands of the given frame have completed
+        void resetTransientDescriptorSets(uint32_t frameIndex);
+
+        // returns the same layout for equal bindings, so that pipeline layouts can be shared (owned by the builder)
+        VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+        // empty for layouts that were not created by the builder
+        [[nodiscard]] const std::vector<VkDescriptorSetLayoutBinding> &getBindings(VkDescriptorSetLayout layout) const;
+
+        void printStatistics() const;
+
+    private:
+        std::vector<std::pair<std::vector<VkDescriptorSetLayoutBinding>, VkDescriptorSetLayout>> descriptorSetLayouts;
+        std::unique_ptr<DescriptorAllocator> allocator;
+        std::vector<std::unique_ptr<DescriptorAllocator>> transientAllocators;
+    };
+
+    struct DescriptorAllocatorStatistics {
+        uint32_t pools;
+        uint64_t allocatedSets;
+        uint32_t resets;
+    };
+
+    /*
+     * Allocates descriptor sets from a chain of pools. When the current pool is out of memory, the next pool is
+     * taken from the pools that were reset, or created with sizes based on the descriptor types of all sets that were
+     * allocated so far, so that pools fit the usage of the application instead of a fixed amount per type.
+     *
+     * Sets can't be freed individually, reset() returns all sets at once (vkResetDescriptorPool) and keeps the pools.
+     */
+    class DescriptorAllocator {
+
+    public:
+        explicit DescriptorAllocator(uint32_t setsPerPool, uint32_t maxSetsPerPool = 4096);
+        ~DescriptorAllocator();
+
+        // the bindings of the layout are used for sizing new pools, and may be empty
+        std::vector<VkDescriptorSet> allocate(VkDescriptorSetLayout layout,
+                                              const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                                              size_t amount);
+        void reset();
+
+        [[nodiscard]] const DescriptorAllocatorStatistics &getStatistics() const;
+
     private:
-        VkDescriptorPool descriptorPool;
+        uint32_t setsPerPool;
+        uint32_t maxSetsPerPool;
+        VkDescriptorPool currentPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> fullPools;
+        std::vector<VkDescriptorPool> freePools;
+
+        // descriptors of each type over all allocated sets, the ratio to allocatedSets sizes new pools
+        std::unordered_map<VkDescriptorType, uint64_t> descriptorCounts;
+        uint64_t allocatedSets = 0;
+        DescriptorAllocatorStatistics statistics{};
+
+        // takes a reset pool, or creates a pool that fits at least the given amount of sets
+        VkDescriptorPool getPool(uint32_t minSets);
+    };
+
+    /*
+     * Collects descriptor writes, so that they are applied with a single vkUpdateDescriptorSets call
+     */
+    class DescriptorWriter {
 
-        void createDescriptorPool();
+    public:
+        DescriptorWriter &writeBuffer(VkDescriptorSet descriptorSet, uint32_t dstBinding, VkBuffer buffer,
+                                      VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                      VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+        DescriptorWriter &writeImage(VkDescriptorSet descriptorSet, uint32_t dstBinding,
+                                     VkSampler sampler, VkImageView imageView,
+                                     VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                     VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+        // applies and clears the collected writes
+        void update();
+
+    private:
+        // deques, so that the writes can point to the infos while more are added
+        std::deque<VkDescriptorBufferInfo> bufferInfos;
+        std::deque<VkDescriptorImageInfo> imageInfos;
+        std::vector<VkWriteDescriptorSet> writes;
+    };
+
+    /*
+     * The descriptor sets of the material pipelines, ordered by how often they change. Binding a set keeps the sets
+     * before it bound, as long as the pipeline layouts are compatible up to that set.
+     */
+    enum class DescriptorSetFrequency : uint32_t {
+        Frame = 0, // camera data and material parameters, bound once per pass (FrameDescriptors)
+        Material = 1, // textures, owned by the material or the bindless texture array
+        Draw = 2 // data indexed by the object index in the push constants (TransformBuffer)
     };
 
-    VkDescriptorSetLayout createDescriptorSetLayout();
-    void bindBuffer(VkDescriptorSet &descriptorSet, VkBuffer &buffer, uint32_t dstBinding);
-    void bindImage(VkDescriptorSet &descriptorSet, VkSampler &sampler, VkImageView &imageView, uint32_t dstBinding);
+    VkDescriptorSetLayout createDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+    // write a single descriptor, use a DescriptorWriter for writing multiple descriptors at once
+    void bindBuffer(VkDescriptorSet &descriptorSet, VkBuffer &buffer, uint32_t dstBinding,
+                    VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    void bindImage(VkDescriptorSet &descriptorSet, VkSampler &sampler, VkImageView &imageView, uint32_t dstBinding,
+                   VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
     extern DescriptorSetBuilder *descriptorSetBuilder;
 }
@@ -0,0 +1,46 @@
+#include "draw_list.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace engine::renderer {
+
+    void buildDrawList(const std::vector<std::unique_ptr<Object>> &objects, const glm::vec3 &cameraPosition,
+                       bool sortOpaque, DrawList &drawList) {
+        // squared distance and object index, so that the transforms are only calculated once per object
+        std::vector<std::pair<float, size_t>> opaque;
+        std::vector<std::pair<float, size_t>> transparent;
+        opaque.reserve(objects.size());
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            const auto &object = objects[i];
+            const Bounds &bounds = object->mesh.bounds;
+            glm::vec3 center = glm::vec3(object->getTransform() * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+            glm::vec3 offset = center - cameraPosition;
+            float distance = glm::dot(offset, offset);
+
+            if (object->material.queue == RenderQueue::Transparent) {
+                transparent.emplace_back(distance, i);
+            } else {
+                opaque.emplace_back(distance, i);
+            }
+        }
+
+        // the index breaks ties, so that the order is stable between frames
+        if (sortOpaque) {
+            std::sort(opaque.begin(), opaque.end());
+        }
+        std::sort(transparent.begin(), transparent.end(), [](const auto &a, const auto &b) {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+
+        drawList.opaque.clear();
+        drawList.transparent.clear();
+        for (const auto &[distance, index]: opaque) {
+            drawList.opaque.push_back(index);
+        }
+        for (const auto &[distance, index]: transparent) {
+            drawList.transparent.push_back(index);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef SPHERE_DRAW_LIST_H
+#define SPHERE_DRAW_LIST_H
+
+#include "scene.h"
+
+#include <vector>
+
+namespace engine::renderer {
+
+    /*
+     * Indices into the objects of the scene, in the order they should be drawn in
+     */
+    struct DrawList {
+        std::vector<size_t> opaque; // front-to-back
+        std::vector<size_t> transparent; // back-to-front, drawn after the opaque objects
+    };
+
+    /*
+     * Splits the objects by the render queue of their material, and sorts them by the distance from the camera to
+     * the center of their bounds. When sortOpaque is false, opaque objects are kept in scene order.
+     */
+    void buildDrawList(const std::vector<std::unique_ptr<Object>> &objects, const glm::vec3 &cameraPosition,
+                       bool sortOpaque, DrawList &drawList);
+}
+
+#endif //SPHERE_DRAW_LIST_H
@@ -0,0 +1,55 @@
+#include "frame_descriptors.h"
+
+#include "vulkan_context.h"
+#include "descriptor_sets.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace engine::renderer {
+
+    FrameDescriptors *frameDescriptors;
+
+    FrameDescriptors::FrameDescriptors(uint32_t framesInFlight) {
+        assert((frameDescriptors == nullptr) && "Only one frame descriptors instance can exist at one time");
+        frameDescriptors = this;
+
+        descriptorSetLayout = descriptorSetBuilder->getDescriptorSetLayout({
+                {
+                        .binding = 0,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                },
+                {
+                        // written by the material buffer
+                        .binding = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                },
+        });
+
+        std::vector<VkDescriptorSet> descriptorSets = descriptorSetBuilder->createDescriptorSets(descriptorSetLayout,
+                                                                                                 framesInFlight);
+        frames.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            FrameResources &frame = frames[i];
+            frame.cameraBuffer = std::make_unique<Buffer>(sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            frame.descriptorSet = descriptorSets[i];
+            bindBuffer(frame.descriptorSet, frame.cameraBuffer->buffer, 0);
+        }
+
+        std::cout << "created frame descriptors" << std::endl;
+    }
+
+    FrameDescriptors::~FrameDescriptors() = default;
+
+    void FrameDescriptors::update(uint32_t frameIndex, const CameraData &cameraData) {
+        frames[frameIndex].cameraBuffer->update(&cameraData);
+    }
+
+    VkDescriptorSet FrameDescriptors::getDescriptorSet(uint32_t frameIndex) const {
+        return frames[frameIndex].descriptorSet;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SPHERE_FRAME_DESCRIPTORS_H
+#define SPHERE_FRAME_DESCRIPTORS_H
+
+#include "vulkan.h"
+#include "buffer.h"
+#include "camera.h"
+
+#include <memory>
+#include <vector>
+
+namespace engine::renderer {
+
+    /*
+     * The descriptor set of the material pipelines that changes once per frame (set 0), containing the camera data
+     * and the material buffer (binding 1, see MaterialBuffer).
+     *
+     * It is bound once per pass, instead of being written into the descriptor set of every material.
+     * Each frame in flight has its own buffer, as the gpu could still read the buffer of the other frame.
+     */
+    class FrameDescriptors {
+
+    public:
+        explicit FrameDescriptors(uint32_t framesInFlight);
+        ~FrameDescriptors();
+
+        VkDescriptorSetLayout descriptorSetLayout; // (owned by the descriptor set builder)
+
+        // should only be called when the commands of the given frame have completed
+        void update(uint32_t frameIndex, const CameraData &cameraData);
+
+        [[nodiscard]] VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const;
+
+    private:
+        struct FrameResources {
+            std::unique_ptr<Buffer> cameraBuffer;
+            VkDescriptorSet descriptorSet;
+        };
+
+        std::vector<FrameResources> frames;
+    };
+
+    extern FrameDescriptors *frameDescriptors;
+}
+
+#endif //SPHERE_FRAME_DESCRIPTORS_H
@@ -0,0 +1,135 @@
+#include "frame_pacer.h"
+
+#include "vulkan_context.h"
+#include <vulkan/vk_enum_string_helper.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace engine::renderer {
+
+    // blocked time that is kept after the frame start, as frame times vary
+    constexpr std::chrono::microseconds margin{1000};
+    // the pacer never delays a frame by more than this, e.g. when the window is occluded and presents block
+    constexpr std::chrono::microseconds maxDelay{50000};
+
+    static float toMilliseconds(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    FramePacer::FramePacer(uint32_t queueDepth, VkPresentModeKHR presentMode) :
+            queueDepth(std::max(queueDepth, 1u)) {
+        // extension functions are not exported by the loader, so they have to be retrieved from the device.
+        // Nothing is presented when headless, so there are no presents to wait for
+        if (context->features.presentWait && !context->isHeadless()) {
+            vkWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                    vkGetDeviceProcAddr(context->device, "vkWaitForPresentKHR"));
+        }
+        statistics.presentMode = presentMode;
+
+        std::cout << "created frame pacer, present wait: " << (vkWaitForPresent ? "supported" : "not supported")
+                  << std::endl;
+    }
+
+    void FramePacer::beginFrame(VkSwapchainKHR swapchain) {
+        Clock::time_point start = Clock::now();
+        if (vkWaitForPresent) {
+            if (enabled && presentId >= queueDepth) {
+                // limits the frames queued for presentation, the timeout is for when the window is occluded
+                waitForPresent(swapchain, presentId - queueDepth + 1, 100000000);
+            } else if (!pendingPresents.empty()) {
+                // only measures, the latency includes the time until this frame started
+                waitForPresent(swapchain, pendingPresents.front().presentId, 0);
+            }
+        }
+        if (enabled && delay > Clock::duration::zero()) {
+            std::this_thread::sleep_for(delay);
+        }
+
+        frameStart = Clock::now();
+        frameDelay = frameStart - start;
+        blocked = Clock::duration::zero();
+        presented = false;
+        frameStarted = true;
+    }
+
+    void FramePacer::waitForPresent(VkSwapchainKHR swapchain, uint64_t id, uint64_t timeout) {
+        // a timeout or an out of date swapchain is not an error, the frame just starts without waiting
+        if (vkWaitForPresent(context->device, swapchain, id, timeout) != VK_SUCCESS) {
+            return;
+        }
+        Clock::time_point presentTime = Clock::now();
+        // ids increase, so all earlier presents have been presented as well, but only the waited one is measured
+        while (!pendingPresents.empty() && pendingPresents.front().presentId <= id) {
+            if (pendingPresents.front().presentId == id) {
+                addLatency(presentTime - pendingPresents.front().frameStart);
+            }
+            pendingPresents.pop_front();
+        }
+    }
+
+    void FramePacer::addBlockedTime(std::chrono::steady_clock::duration duration) {
+        blocked += duration;
+    }
+
+    uint64_t FramePacer::present() {
+        presented = true;
+        if (!vkWaitForPresent) {
+            return 0;
+        }
+        presentId++;
+        pendingPresents.push_back({presentId, frameStart});
+        return presentId;
+    }
+
+    void FramePacer::endFrame() {
+        frameStarted = false;
+        if (!presented) {
+            return;
+        }
+        if (!vkWaitForPresent) {
+            addLatency(Clock::now() - frameStart);
+        }
+        pacedFrames++;
+        delaySum += toMilliseconds(frameDelay);
+        blockedSum += toMilliseconds(blocked);
+        statistics.averageDelay = static_cast<float>(delaySum / pacedFrames);
+        statistics.averageBlockedTime = static_cast<float>(blockedSum / pacedFrames);
+
+        // moves the blocked time to before the frame start, halfway each frame so that single slow frames
+        // don't make the delay oscillate
+        delay += (blocked - margin) / 2;
+        delay = std::clamp<Clock::duration>(delay, Clock::duration::zero(), maxDelay);
+    }
+
+    void FramePacer::addLatency(Clock::duration latency) {
+        float milliseconds = toMilliseconds(latency);
+        statistics.frames++;
+        latencySum += milliseconds;
+        statistics.averageLatency = static_cast<float>(latencySum / statistics.frames);
+        statistics.maxLatency = std::max(statistics.maxLatency, milliseconds);
+    }
+
+    void FramePacer::onSwapchainRecreated(VkPresentModeKHR presentMode) {
+        presentId = 0;
+        pendingPresents.clear();
+        if (presentMode != statistics.presentMode) {
+            statistics = {.presentMode = presentMode};
+            latencySum = 0;
+            delaySum = 0;
+            blockedSum = 0;
+            pacedFrames = 0;
+            delay = Clock::duration::zero();
+        }
+    }
+
+    void FramePacer::printStatistics() const {
+        std::cout << "frame pacing (" << string_VkPresentModeKHR(statistics.presentMode)
+                  << (enabled ? "" : ", disabled") << "): input to present: "
+                  << statistics.averageLatency << " ms (max " << statistics.maxLatency << " ms"
+                  << (vkWaitForPresent ? "" : ", until the present call") << ")"
+                  << ", delay: " << statistics.averageDelay << " ms"
+                  << ", blocked: " << statistics.averageBlockedTime << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef SPHERE_FRAME_PACER_H
+#define SPHERE_FRAME_PACER_H
+
+#include "vulkan.h"
+
+#include <chrono>
+#include <deque>
+
+namespace engine::renderer {
+
+    struct FramePacingStatistics {
+        VkPresentModeKHR presentMode;
+        uint32_t frames; // with a measured latency
+        // in milliseconds, from the start of the frame (when input is sampled) until the image was presented.
+        // Without VK_KHR_present_wait, until vkQueuePresentKHR returned, which excludes the time the image was queued
+        float averageLatency;
+        float maxLatency;
+        float averageDelay; // the frame start was delayed by the pacer, including waiting for earlier presents
+        float averageBlockedTime; // blocked on the frame in flight and on acquiring an image, after input was sampled
+    };
+
+    /*
+     * Delays the start of each frame, so that input is sampled as late as possible while the frame still makes
+     * its display slot.
+     *
+     * Time that the cpu blocks after sampling input (waiting for the frame in flight, or for a swapchain image when
+     * presenting is limited by the display) is latency that could have been spent before sampling input.
+     * The pacer moves that time to before the frame start, keeping a small margin for variance.
+     *
+     * With VK_KHR_present_wait, each present gets an id (VK_KHR_present_id) and the start of a frame additionally
+     * waits until the present that is queueDepth frames older has been presented, which limits how many frames can be
+     * queued for presentation and measures the latency until the image is actually presented.
+     */
+    class FramePacer {
+
+    public:
+        // queueDepth is the amount of frames that can be queued for presentation when present wait is supported
+        explicit FramePacer(uint32_t queueDepth, VkPresentModeKHR presentMode);
+
+        bool enabled = true; // otherwise only measures
+        FramePacingStatistics statistics{};
+        bool frameStarted = false;
+
+        // blocks until the next frame should start, input should be sampled after this
+        void beginFrame(VkSwapchainKHR swapchain);
+
+        // the cpu blocked on the gpu or the presentation engine after the frame started
+        void addBlockedTime(std::chrono::steady_clock::duration duration);
+
+        // the id to chain into the present info, 0 when present wait is not supported
+        uint64_t present();
+
+        void endFrame();
+
+        // present ids are per swapchain, statistics are per present mode
+        void onSwapchainRecreated(VkPresentModeKHR presentMode);
+
+        void printStatistics() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct PendingPresent {
+            uint64_t presentId;
+            Clock::time_point frameStart;
+        };
+
+        PFN_vkWaitForPresentKHR vkWaitForPresent = nullptr;
+        uint32_t queueDepth;
+        uint64_t presentId = 0; // of the last present
+        std::deque<PendingPresent> pendingPresents; // presents whose latency has not been measured yet
+
+        Clock::duration delay{0}; // applied before the frame start
+        Clock::time_point frameStart;
+        Clock::duration frameDelay{0};
+        Clock::duration blocked{0};
+        bool presented = false;
+
+        // sums for the averages
+        double latencySum = 0;
+        double delaySum = 0;
+        double blockedSum = 0;
+        uint32_t pacedFrames = 0;
+
+        void addLatency(Clock::duration latency);
+        void waitForPresent(VkSwapchainKHR swapchain, uint64_t id, uint64_t timeout);
+    };
+}
+
+#endif //SPHERE_FRAME_PACER_H
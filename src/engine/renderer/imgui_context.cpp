@@ -43,7 +43,7 @@ namespace engine::renderer {
         ImGui::CreateContext();
 
         // init Imgui
-        uint32_t imageCount = static_cast<uint32_t>(swapchain.framebuffers.size());
+        uint32_t imageCount = swapchain.getImageCount();
         ImGui_ImplGlfw_InitForVulkan(context->configuration.window, true);
         ImGui_ImplVulkan_InitInfo initInfo{
                 .Instance = context->instance,
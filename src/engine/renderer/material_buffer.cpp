@@ -0,0 +1,105 @@
+#include "material_buffer.h"
+
+#include "descriptor_sets.h"
+#include "frame_descriptors.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace engine::renderer {
+
+    MaterialBuffer *materialBuffer;
+
+    // the zeroed block at the start of the buffer, read by materials without parameters
+    constexpr size_t reservedSize = 256;
+
+    MaterialBuffer::MaterialBuffer(uint32_t framesInFlight, size_t initialCapacity) : size(reservedSize) {
+        assert((materialBuffer == nullptr) && "Only one material buffer can exist at one time");
+        assert((frameDescriptors != nullptr) && "The material buffer is bound in the frame descriptor sets");
+        materialBuffer = this;
+
+        frames.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            createBuffer(frames[i], i, std::max(initialCapacity, reservedSize));
+        }
+
+        std::cout << "created material buffer" << std::endl;
+    }
+
+    MaterialBuffer::~MaterialBuffer() {
+        frames.clear();
+    }
+
+    void MaterialBuffer::createBuffer(FrameResources &frame, uint32_t frameIndex, size_t capacity) {
+        frame.buffer = std::make_unique<Buffer>(capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                                                VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        frame.data = static_cast<uint8_t *>(frame.buffer->getMappedData());
+        frame.capacity = capacity;
+        memset(frame.data, 0, reservedSize);
+
+        // everything has to be written again
+        frame.writtenVersions.clear();
+
+        VkDescriptorSet descriptorSet = frameDescriptors->getDescriptorSet(frameIndex);
+        bindBuffer(descriptorSet, frame.buffer->buffer, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+
+    uint32_t MaterialBuffer::allocate(uint32_t blockSize) {
+        assert(blockSize > 0);
+        auto it = freeBlocks.find(blockSize);
+        if (it != freeBlocks.end() && !it->second.empty()) {
+            uint32_t index = it->second.back();
+            it->second.pop_back();
+            return index;
+        }
+        size_t offset = (size + blockSize - 1) / blockSize * blockSize;
+        size = offset + blockSize;
+        return static_cast<uint32_t>(offset / blockSize);
+    }
+
+    void MaterialBuffer::free(uint32_t index, uint32_t blockSize) {
+        freeBlocks[blockSize].push_back(index);
+    }
+
+    void MaterialBuffer::update(uint32_t frameIndex, const std::vector<std::unique_ptr<Material>> &materials) {
+        FrameResources &frame = frames[frameIndex];
+        if (size > frame.capacity) {
+            // the descriptor set of this frame is not in use, as its commands have completed
+            createBuffer(frame, frameIndex, std::max(size, frame.capacity * 2));
+        }
+
+        statistics.materials = 0;
+        statistics.writtenMaterials = 0;
+        statistics.writtenBytes = 0;
+
+        for (const auto &material: materials) {
+            const std::vector<uint8_t> &parameters = material->getParameters();
+            if (parameters.empty()) {
+                continue;
+            }
+            statistics.materials++;
+
+            size_t offset = material->materialIndex * parameters.size();
+            uint64_t version = material->getParametersVersion();
+            uint64_t &writtenVersion = frame.writtenVersions[offset];
+            if (writtenVersion == version) {
+                continue;
+            }
+            // host coherent memory, so no flush is required
+            memcpy(frame.data + offset, parameters.data(), parameters.size());
+            writtenVersion = version;
+
+            statistics.writtenMaterials++;
+            statistics.writtenBytes += static_cast<uint32_t>(parameters.size());
+        }
+    }
+
+    void MaterialBuffer::printStatistics() const {
+        std::cout << "material buffer: materials: " << statistics.materials
+                  << ", written materials: " << statistics.writtenMaterials
+                  << " (" << statistics.writtenBytes << " bytes)" << std::endl;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SPHERE_MATERIAL_BUFFER_H
+#define SPHERE_MATERIAL_BUFFER_H
+
+#include "vulkan.h"
+#include "buffer.h"
+#include "material_system.h"
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace engine::renderer {
+
+    struct MaterialBufferStatistics {
+        uint32_t materials; // with parameters
+        uint32_t writtenMaterials; // materials whose parameters changed since they were last written into the frame's buffer
+        uint32_t writtenBytes;
+    };
+
+    /*
+     * Contains the parameters of all materials in a persistently mapped storage buffer, so that parameters such as
+     * colors can be changed without creating descriptor sets. Shaders declare their parameters as the
+     * MaterialParameters struct, and read them from an array of these structs using the material index in the
+     * push constants.
+     *
+     * Each material gets a block of the size of its struct, at an offset that is a multiple of that size, so that
+     * the material index is the offset divided by the size. The first block is zeroed, for materials without
+     * parameters.
+     *
+     * Each frame in flight has its own buffer, as the gpu could still read the buffer of the other frame.
+     * Only the parameters that changed since the buffer was last written are copied, which is tracked per block
+     * using the parameters version, which is unique across materials. The blocks of destroyed materials are reused.
+     *
+     * The buffer is bound at binding 1 of the frame descriptor set.
+     */
+    class MaterialBuffer {
+
+    public:
+        explicit MaterialBuffer(uint32_t framesInFlight, size_t initialCapacity = 64 * 1024);
+        ~MaterialBuffer();
+
+        MaterialBufferStatistics statistics{};
+
+        // reserves a block for the parameters of a material, returns the index of the block
+        uint32_t allocate(uint32_t size);
+
+        // the block can be reused right away, as the buffer of a frame is only written once its commands have completed
+        void free(uint32_t index, uint32_t size);
+
+        // should only be called when the commands of the given frame have completed, grows the buffer when required
+        void update(uint32_t frameIndex, const std::vector<std::unique_ptr<Material>> &materials);
+
+        void printStatistics() const;
+
+    private:
+        struct FrameResources {
+            std::unique_ptr<Buffer> buffer;
+            uint8_t *data = nullptr; // persistently mapped
+            size_t capacity = 0;
+
+            // the parameters version that is currently written at each block, by the offset of the block
+            std::unordered_map<size_t, uint64_t> writtenVersions;
+        };
+
+        std::vector<FrameResources> frames;
+        size_t size;
+        std::map<uint32_t, std::vector<uint32_t>> freeBlocks; // indices of the blocks of destroyed materials, by size
+
+        static void createBuffer(FrameResources &frame, uint32_t frameIndex, size_t capacity);
+    };
+
+    extern MaterialBuffer *materialBuffer;
+}
+
+#endif //SPHERE_MATERIAL_BUFFER_H
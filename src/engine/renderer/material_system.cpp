@@ -3,38 +3,304 @@
 #include "vulkan_context.h"
 #include "descriptor_sets.h"
 #include "types.h"
+#include "transform_buffer.h"
+#include "bindless_textures.h"
+#include "frame_descriptors.h"
+#include "material_buffer.h"
+#include "deletion_queue.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <utility>
 
 namespace engine::renderer {
-    Material::Material(const Shader &shader, Texture &texture) : shader(shader), texture(texture) {
 
-        // set descriptor sets
+    static std::vector<char> readFile(const std::string &filename);
+
+    // unique across materials, so that a material that reuses the block of a destroyed material is always written
+    static std::atomic<uint64_t> nextParametersVersion{1};
+
+    // of the pipeline builder job that runs on this thread
+    static thread_local VkPipelineCache threadPipelineCache = VK_NULL_HANDLE;
+
+    /*
+     * Returns whether the value changed, throws when the parameters do not declare the member with the type of the value
+     */
+    static bool writeParameter(const ReflectedStruct &declared, std::vector<uint8_t> &parameters,
+                               const std::string &name, ShaderDataType type, const void *data, size_t size) {
+        const ReflectedMember *member = declared.getMember(name);
+        if (member == nullptr || member->type != type || member->size < size) {
+            throw std::runtime_error("shader has no material parameter " + name + " of the given type");
+        }
+        if (memcmp(parameters.data() + member->offset, data, size) == 0) {
+            return false;
+        }
+        memcpy(parameters.data() + member->offset, data, size);
+        return true;
+    }
+
+    Material::Material(Shader &shader, Texture &texture, RenderQueue queue, bool doubleSided) :
+            shader(shader), texture(texture), queue(queue), doubleSided(doubleSided) {
+        pipeline = &shader.getPipeline(queue, doubleSided);
+
+        if (shader.parameters.size > 0) {
+            parameters = shader.parameterDefaults;
+            materialIndex = materialBuffer->allocate(shader.parameters.size);
+        }
+        parametersVersion = nextParametersVersion++;
+
+        if (shader.bindless) {
+            // materials share the global set, so that switching materials binds no descriptor sets
+            descriptorSet = bindlessTextures->descriptorSet;
+            textureIndex = bindlessTextures->getIndex(texture);
+            return;
+        }
+
+        // the material only has a texture, which is written to each binding of the material set
         descriptorSet = descriptorSetBuilder->createDescriptorSets(shader.descriptorSetLayout, 1)[0];
-        bindImage(descriptorSet, texture.sampler, texture.imageView, 1);
+        DescriptorWriter writer;
+        for (auto const &binding: descriptorSetBuilder->getBindings(shader.descriptorSetLayout)) {
+            if (binding.descriptorType != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || binding.descriptorCount != 1) {
+                throw std::runtime_error("the material set of a shader can only contain single textures");
+            }
+            writer.writeImage(descriptorSet, binding.binding, texture.sampler, texture.imageView);
+        }
+        writer.update();
+    }
+
+    Material::~Material() {
+        if (!parameters.empty()) {
+            materialBuffer->free(materialIndex, static_cast<uint32_t>(parameters.size()));
+        }
+    }
+
+    void Material::setParameter(const std::string &name, float value) {
+        setParameter(name, ShaderDataType::Float, &value, sizeof(value));
+    }
+
+    void Material::setParameter(const std::string &name, int32_t value) {
+        setParameter(name, ShaderDataType::Int, &value, sizeof(value));
+    }
+
+    void Material::setParameter(const std::string &name, uint32_t value) {
+        setParameter(name, ShaderDataType::UInt, &value, sizeof(value));
     }
 
-    Material::~Material() = default;
+    void Material::setParameter(const std::string &name, const glm::vec2 &value) {
+        setParameter(name, ShaderDataType::Vec2, &value, sizeof(value));
+    }
+
+    void Material::setParameter(const std::string &name, const glm::vec3 &value) {
+        setParameter(name, ShaderDataType::Vec3, &value, sizeof(value));
+    }
+
+    void Material::setParameter(const std::string &name, const glm::vec4 &value) {
+        setParameter(name, ShaderDataType::Vec4, &value, sizeof(value));
+    }
+
+    void Material::setParameter(const std::string &name, const glm::mat4 &value) {
+        setParameter(name, ShaderDataType::Mat4, &value, sizeof(value));
+    }
+
+    void Material::setParameter(const std::string &name, ShaderDataType type, const void *data, size_t size) {
+        if (writeParameter(shader.parameters, parameters, name, type, data, size)) {
+            parametersVersion = nextParametersVersion++;
+        }
+    }
+
+    const std::vector<uint8_t> &Material::getParameters() const {
+        return parameters;
+    }
+
+    uint64_t Material::getParametersVersion() const {
+        return parametersVersion;
+    }
+
+    // used for the depth-only pipelines of all shaders
+    static const std::string depthOnlyVertexShaderPath = "depth_only_vert.spv";
+    static const std::string depthOnlyFragmentShaderPath = "depth_only_frag.spv";
+
+    /*
+     * The frame and draw sets are owned by the engine, so a shader can only read the bindings they contain
+     */
+    static void validateBinding(const ReflectedBinding &declared, VkDescriptorSetLayout layout) {
+        for (auto const &binding: descriptorSetBuilder->getBindings(layout)) {
+            if (binding.binding == declared.binding && binding.descriptorType == declared.descriptorType &&
+                (binding.stageFlags & declared.stageFlags) == declared.stageFlags) {
+                return;
+            }
+        }
+        throw std::runtime_error("shader declares binding " + std::to_string(declared.binding) + " of set " +
+                                 std::to_string(declared.set) + ", which the engine does not provide");
+    }
 
     Shader::Shader(const std::string &vertexShaderPath,
                    const std::string &fragmentShaderPath,
-                   VkRenderPass renderPass) : renderPass(renderPass) {
+                   VkRenderPass renderPass,
+                   uint32_t specializationConstants) : vertexShaderPath(vertexShaderPath),
+                                                       fragmentShaderPath(fragmentShaderPath),
+                                                       renderPass(renderPass),
+                                                       specializationConstants(specializationConstants) {
+        // the depth-only modules are included, so that the layouts of the color and depth-only pipelines are equal
+        std::vector<ShaderReflection> modules;
+        for (auto const &path: {vertexShaderPath, fragmentShaderPath,
+                                depthOnlyVertexShaderPath, depthOnlyFragmentShaderPath}) {
+            modules.emplace_back(readFile("shaders/" + path));
+        }
+
+        // bindings that are declared by multiple stages are merged
+        std::map<std::pair<uint32_t, uint32_t>, ReflectedBinding> bindings;
+        for (auto const &module: modules) {
+            for (auto const &binding: module.getBindings()) {
+                auto [it, inserted] = bindings.try_emplace({binding.set, binding.binding}, binding);
+                if (!inserted) {
+                    if (it->second.descriptorType != binding.descriptorType ||
+                        it->second.descriptorCount != binding.descriptorCount) {
+                        throw std::runtime_error("binding " + std::to_string(binding.binding) + " of set " +
+                                                 std::to_string(binding.set) + " differs between shader stages");
+                    }
+                    it->second.stageFlags |= binding.stageFlags;
+                }
+            }
+            uint32_t size = module.getPushConstantsSize();
+            if (size > 0) {
+                pushConstantsSize = std::max(pushConstantsSize, size);
+                pushConstantsStages |= module.stage;
+            }
+        }
+        if (pushConstantsSize > sizeof(MaterialPushConstants)) {
+            throw std::runtime_error("the push constants of a shader should be a prefix of MaterialPushConstants");
+        }
 
-        descriptorSetLayout = createDescriptorSetLayout();
+        std::vector<VkDescriptorSetLayoutBinding> materialBindings;
+        for (auto const &[key, binding]: bindings) {
+            switch (static_cast<DescriptorSetFrequency>(binding.set)) {
+                case DescriptorSetFrequency::Frame:
+                    validateBinding(binding, frameDescriptors->descriptorSetLayout);
+                    break;
+                case DescriptorSetFrequency::Material:
+                    materialBindings.push_back({
+                            .binding = binding.binding,
+                            .descriptorType = binding.descriptorType,
+                            .descriptorCount = binding.descriptorCount,
+                            .stageFlags = binding.stageFlags,
+                    });
+                    break;
+                case DescriptorSetFrequency::Draw:
+                    validateBinding(binding, transformBuffer->descriptorSetLayout);
+                    break;
+                default:
+                    throw std::runtime_error("shader declares set " + std::to_string(binding.set) +
+                                             ", material pipelines have 3 sets");
+            }
+        }
+
+        // an unbounded texture array in the material set is the bindless texture array
+        bindless = std::any_of(materialBindings.begin(), materialBindings.end(),
+                               [](const VkDescriptorSetLayoutBinding &binding) {
+                                   return binding.descriptorCount == 0;
+                               });
+        if (bindless && bindlessTextures == nullptr) {
+            throw std::runtime_error("bindless shaders require the bindless texture array");
+        }
+        // equal bindings get the same layout, so that shaders with the same bindings share pipeline layouts
+        descriptorSetLayout = bindless ? bindlessTextures->descriptorSetLayout
+                                       : descriptorSetBuilder->getDescriptorSetLayout(materialBindings);
+
+        // the parameters are the same in both stages when both declare them
+        for (auto const *module: {&modules[1], &modules[0]}) {
+            if (std::optional<ReflectedStruct> declared = module->getStruct("MaterialParameters")) {
+                parameters = *declared;
+                break;
+            }
+        }
+        parameterDefaults.resize(parameters.size);
+    }
+
+    Shader::~Shader() = default;
+
+    void Shader::setParameterDefault(const std::string &name, float value) {
+        setParameterDefault(name, ShaderDataType::Float, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, int32_t value) {
+        setParameterDefault(name, ShaderDataType::Int, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, uint32_t value) {
+        setParameterDefault(name, ShaderDataType::UInt, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, const glm::vec2 &value) {
+        setParameterDefault(name, ShaderDataType::Vec2, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, const glm::vec3 &value) {
+        setParameterDefault(name, ShaderDataType::Vec3, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, const glm::vec4 &value) {
+        setParameterDefault(name, ShaderDataType::Vec4, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, const glm::mat4 &value) {
+        setParameterDefault(name, ShaderDataType::Mat4, &value, sizeof(value));
+    }
+
+    void Shader::setParameterDefault(const std::string &name, ShaderDataType type, const void *data, size_t size) {
+        writeParameter(parameters, parameterDefaults, name, type, data, size);
+    }
+
+    std::vector<VkDescriptorSetLayout> Shader::getDescriptorSetLayouts() const {
+        // ordered by DescriptorSetFrequency
+        return {frameDescriptors->descriptorSetLayout, descriptorSetLayout, transformBuffer->descriptorSetLayout};
+    }
 
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-                descriptorSetLayout
+    PipelineConfiguration Shader::getDefaultConfiguration() const {
+        return {
+                .pushConstantsSize = pushConstantsSize,
+                .pushConstantsStages = pushConstantsStages,
+                .dynamicState = true,
         };
+    }
 
-        PipelineData &data = pipelineBuilder->createPipeline(renderPass, descriptorSetLayouts, vertexShaderPath,
-                                                             fragmentShaderPath);
-        pipelineData = &data; // get pointer to pipeline data (unowned pointer)
+    AsyncPipeline &Shader::getPipeline(RenderQueue queue, bool doubleSided) {
+        AsyncPipeline *&pipeline = pipelines[{queue, doubleSided}];
+        if (pipeline == nullptr) {
+            PipelineConfiguration configuration = getDefaultConfiguration();
+            configuration.cullMode = doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+            configuration.depthWrite = queue == RenderQueue::Opaque;
+            // equal passes for the fragments that were written by the depth prepass
+            configuration.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+            configuration.blending = queue == RenderQueue::Transparent;
+            configuration.specializationConstants = specializationConstants;
+            pipeline = &pipelineBuilder->createPipelineAsync(renderPass,
+                                                             getDescriptorSetLayouts(),
+                                                             vertexShaderPath, fragmentShaderPath, configuration);
+        }
+        return *pipeline;
     }
 
-    Shader::~Shader() {
-        vkDestroyDescriptorSetLayout(context->device, descriptorSetLayout, nullptr);
+    AsyncPipeline &Shader::getDepthOnlyPipeline(bool doubleSided) {
+        AsyncPipeline *&depthOnlyPipeline = depthOnlyPipelines[doubleSided];
+        if (depthOnlyPipeline == nullptr) {
+            PipelineConfiguration configuration = getDefaultConfiguration();
+            configuration.cullMode = doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+            configuration.colorWriteMask = 0;
+            depthOnlyPipeline = &pipelineBuilder->createPipelineAsync(renderPass,
+                                                                      getDescriptorSetLayouts(),
+                                                                      depthOnlyVertexShaderPath,
+                                                                      depthOnlyFragmentShaderPath, configuration);
+        }
+        return *depthOnlyPipeline;
     }
 
     PipelineData::PipelineData(const VkPipeline &pipeline, const VkPipelineLayout &pipelineLayout) : pipeline(pipeline),
@@ -43,23 +309,360 @@ namespace engine::renderer {
 
     }
 
+    static void hashCombine(size_t &seed, size_t value) {
+        seed ^= value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+    }
+
+    // FNV-1a
+    static uint64_t hashCode(const std::vector<char> &code) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char byte: code) {
+            hash ^= static_cast<uint8_t>(byte);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    size_t PipelineDescription::Hash::operator()(const PipelineDescription &description) const {
+        const PipelineConfiguration &configuration = description.configuration;
+        size_t seed = 0;
+        hashCombine(seed, description.vertexShaderHash);
+        hashCombine(seed, description.fragmentShaderHash);
+        hashCombine(seed, description.vertexStride);
+        hashCombine(seed, description.vertexInputs);
+        hashCombine(seed, configuration.cullMode);
+        hashCombine(seed, configuration.depthWrite);
+        hashCombine(seed, configuration.depthCompareOp);
+        hashCombine(seed, configuration.colorWriteMask);
+        hashCombine(seed, configuration.blending);
+        hashCombine(seed, configuration.pushConstantsSize);
+        hashCombine(seed, configuration.pushConstantsStages);
+        hashCombine(seed, configuration.dynamicState);
+        hashCombine(seed, configuration.specializationConstants);
+        hashCombine(seed, std::hash<VkRenderPass>()(description.renderPass));
+        hashCombine(seed, std::hash<VkPipelineLayout>()(description.pipelineLayout));
+        return seed;
+    }
+
+    PipelineData *AsyncPipeline::get() const {
+        return pipelineData.load(std::memory_order_acquire);
+    }
+
+    bool AsyncPipeline::isReady() const {
+        return get() != nullptr;
+    }
+
+    bool AsyncPipeline::hasFailed() const {
+        return failed.load(std::memory_order_acquire);
+    }
+
+    const PipelineConfiguration &AsyncPipeline::getConfiguration() const {
+        return configuration;
+    }
+
     PipelineBuilder *pipelineBuilder;
 
-    PipelineBuilder::PipelineBuilder(Swapchain &swapchain) : swapchain(swapchain) {
+    PipelineBuilder::PipelineBuilder(Swapchain &swapchain, ThreadPool *threadPool, std::string pipelineCachePath) :
+            swapchain(swapchain), threadPool(threadPool), pipelineCachePath(std::move(pipelineCachePath)) {
         assert((pipelineBuilder == nullptr) && "Only one pipeline builder can exist at one time");
         pipelineBuilder = this;
-//
-//        VkPipelineCacheCreateInfo pipelineCacheInfo{};
-//        pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-//        pipelineCacheInfo.pNext = nullptr;
-//        //pipelineCacheInfo.initialDataSize
-//        //pipelineCacheInfo.pInitialData
+
+        loadPipelineCache();
+
+        if (context->features.extendedDynamicState) {
+            vkCmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdSetCullModeEXT"));
+            vkCmdSetDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdSetDepthWriteEnableEXT"));
+            vkCmdSetDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdSetDepthCompareOpEXT"));
+        }
+        if (context->features.extendedDynamicState3Blend) {
+            vkCmdSetColorBlendEnable = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdSetColorBlendEnableEXT"));
+            vkCmdSetColorWriteMask = reinterpret_cast<PFN_vkCmdSetColorWriteMaskEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdSetColorWriteMaskEXT"));
+        }
     }
 
     PipelineBuilder::~PipelineBuilder() {
+        // the jobs reference the builder
+        waitForPipelines();
+        {
+            // a job releases its thread cache after it has completed
+            std::unique_lock<std::mutex> lock(mutex);
+            pipelinesCreated.wait(lock, [&]() { return freeThreadCaches.size() == threadCaches.size(); });
+        }
+
+        mergeThreadCaches();
+        savePipelineCache();
+        vkDestroyPipelineCache(context->device, pipelineCache, nullptr);
+
         for (const auto &pipeline: pipelines) {
             vkDestroyPipeline(context->device, pipeline->pipeline, nullptr);
-            vkDestroyPipelineLayout(context->device, pipeline->pipelineLayout, nullptr);
+        }
+        for (const auto &entry: optimizedPipelines) {
+            vkDestroyPipeline(context->device, entry.second, nullptr);
+        }
+        for (const auto &entry: vertexInputLibraries) {
+            vkDestroyPipeline(context->device, entry.second, nullptr);
+        }
+        for (const auto &entry: preRasterizationLibraries) {
+            vkDestroyPipeline(context->device, entry.second, nullptr);
+        }
+        for (const auto &entry: fragmentShaderLibraries) {
+            vkDestroyPipeline(context->device, entry.second, nullptr);
+        }
+        for (const auto &entry: fragmentOutputLibraries) {
+            vkDestroyPipeline(context->device, entry.second, nullptr);
+        }
+        for (const auto &entry: pipelineLayouts) {
+            vkDestroyPipelineLayout(context->device, entry.second, nullptr);
+        }
+    }
+
+    /*
+     * The cache data starts with a VkPipelineCacheHeaderVersionOne. Drivers should reject data from other devices
+     * themselves, but not all of them do, so the header is checked before passing the data to the driver.
+     */
+    bool PipelineBuilder::isPipelineCacheCompatible(const std::vector<char> &data) {
+        VkPipelineCacheHeaderVersionOne header;
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(context->physicalDevice, &properties);
+
+        return header.headerSize >= sizeof(header) &&
+               header.headerSize <= data.size() &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == properties.vendorID &&
+               header.deviceID == properties.deviceID &&
+               memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void PipelineBuilder::loadPipelineCache() {
+        std::vector<char> data;
+        std::ifstream file(pipelineCachePath, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        statistics.warmCache = isPipelineCacheCompatible(data);
+        if (!statistics.warmCache && !data.empty()) {
+            std::cout << "pipeline cache at " << pipelineCachePath
+                      << " was created by a different device or driver, starting with an empty cache" << std::endl;
+        }
+
+        VkPipelineCacheCreateInfo pipelineCacheInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                .initialDataSize = statistics.warmCache ? data.size() : 0,
+                .pInitialData = statistics.warmCache ? data.data() : nullptr,
+        };
+        checkResult(vkCreatePipelineCache(context->device, &pipelineCacheInfo, nullptr, &pipelineCache));
+
+        std::cout << "created pipeline cache (" << (statistics.warmCache ? "loaded from disk" : "empty") << ")"
+                  << std::endl;
+    }
+
+    void PipelineBuilder::savePipelineCache() {
+        size_t size = 0;
+        checkResult(vkGetPipelineCacheData(context->device, pipelineCache, &size, nullptr));
+        std::vector<char> data(size);
+        checkResult(vkGetPipelineCacheData(context->device, pipelineCache, &size, data.data()));
+        data.resize(size);
+
+        std::string temporaryPath = pipelineCachePath + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cout << "failed to save pipeline cache to: " << temporaryPath << std::endl;
+                return;
+            }
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file) {
+                std::cout << "failed to write pipeline cache to: " << temporaryPath << std::endl;
+                return;
+            }
+        }
+
+        // rename replaces the file atomically
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, pipelineCachePath, error);
+        if (error) {
+            std::cout << "failed to replace pipeline cache: " << error.message() << std::endl;
+            return;
+        }
+
+        std::cout << "saved pipeline cache (" << size << " bytes) to: " << pipelineCachePath << std::endl;
+    }
+
+    /*
+     * A new thread cache starts with the contents of the main cache, so that a warm cache also speeds up the jobs
+     */
+    VkPipelineCache PipelineBuilder::acquireThreadCache() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeThreadCaches.empty()) {
+            VkPipelineCache threadCache = freeThreadCaches.back();
+            freeThreadCaches.pop_back();
+            return threadCache;
+        }
+
+        size_t size = 0;
+        checkResult(vkGetPipelineCacheData(context->device, pipelineCache, &size, nullptr));
+        std::vector<char> data(size);
+        checkResult(vkGetPipelineCacheData(context->device, pipelineCache, &size, data.data()));
+
+        VkPipelineCacheCreateInfo pipelineCacheInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                .initialDataSize = size,
+                .pInitialData = data.data(),
+        };
+        VkPipelineCache threadCache;
+        checkResult(vkCreatePipelineCache(context->device, &pipelineCacheInfo, nullptr, &threadCache));
+        threadCaches.push_back(threadCache);
+        return threadCache;
+    }
+
+    void PipelineBuilder::releaseThreadCache(VkPipelineCache threadCache) {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeThreadCaches.push_back(threadCache);
+        // notified under the lock, as the destructor waits for the thread caches to be released
+        pipelinesCreated.notify_all();
+    }
+
+    VkPipelineCache PipelineBuilder::getPipelineCache() const {
+        return threadPipelineCache != VK_NULL_HANDLE ? threadPipelineCache : pipelineCache;
+    }
+
+    void PipelineBuilder::mergeThreadCaches() {
+        if (threadCaches.empty()) {
+            return;
+        }
+        checkResult(vkMergePipelineCaches(context->device, pipelineCache, static_cast<uint32_t>(threadCaches.size()),
+                                          threadCaches.data()));
+        for (const auto &threadCache: threadCaches) {
+            vkDestroyPipelineCache(context->device, threadCache, nullptr);
+        }
+        std::cout << "merged " << threadCaches.size() << " thread pipeline caches" << std::endl;
+        threadCaches.clear();
+        freeThreadCaches.clear();
+    }
+
+    AsyncPipeline &PipelineBuilder::createPipelineAsync(const VkRenderPass &renderPass,
+                                                        const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                                        const std::string &vertexShaderPath,
+                                                        const std::string &fragmentShaderPath,
+                                                        const PipelineConfiguration &configuration) {
+        AsyncPipeline *asyncPipeline;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            AsyncPipelineKey key{renderPass, descriptorSetLayouts, vertexShaderPath, fragmentShaderPath, configuration};
+            auto it = asyncPipelinesByKey.find(key);
+            if (it != asyncPipelinesByKey.end()) {
+                return *it->second;
+            }
+
+            asyncPipeline = asyncPipelines.emplace_back(std::make_unique<AsyncPipeline>()).get();
+            asyncPipeline->configuration = configuration;
+            asyncPipeline->vertexShaderPath = getReloadedShaderPath(vertexShaderPath);
+            asyncPipeline->fragmentShaderPath = getReloadedShaderPath(fragmentShaderPath);
+            asyncPipelinesByKey.emplace(std::move(key), asyncPipeline);
+            pendingPipelines++;
+        }
+
+        // captures copies, as the job can outlive the arguments
+        auto job = [this, asyncPipeline, renderPass, descriptorSetLayouts, configuration,
+                vertexShaderPath = asyncPipeline->vertexShaderPath,
+                fragmentShaderPath = asyncPipeline->fragmentShaderPath]() {
+            try {
+                PipelineData &pipelineData = findOrCreatePipeline(renderPass, descriptorSetLayouts, vertexShaderPath,
+                                                                  fragmentShaderPath, configuration);
+                std::lock_guard<std::mutex> lock(mutex);
+                // a reload that was queued in the meantime replaces the pipeline when it is applied
+                if (asyncPipeline->generation == 0) {
+                    asyncPipeline->pipelineData.store(&pipelineData, std::memory_order_release);
+                }
+            } catch (const std::exception &e) {
+                std::cout << "failed to create pipeline (" << vertexShaderPath << ", " << fragmentShaderPath
+                          << "): " << e.what() << std::endl;
+                asyncPipeline->failed.store(true, std::memory_order_release);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pendingPipelines--;
+            }
+            completedPipelines++;
+            pipelinesCreated.notify_all();
+        };
+
+        runAsync(std::move(job));
+        return *asyncPipeline;
+    }
+
+    void PipelineBuilder::waitForPipelines() {
+        std::unique_lock<std::mutex> lock(mutex);
+        pipelinesCreated.wait(lock, [&]() { return pendingPipelines == 0; });
+    }
+
+    uint64_t PipelineBuilder::getCompletedPipelineCount() const {
+        return completedPipelines.load();
+    }
+
+    VkPipelineLayout PipelineBuilder::getPipelineLayout(const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                                        uint32_t pushConstantsSize,
+                                                        VkShaderStageFlags pushConstantsStages) {
+        std::lock_guard<std::mutex> lock(mutex);
+        PipelineLayoutKey key{descriptorSetLayouts, pushConstantsSize, pushConstantsStages};
+        auto it = pipelineLayouts.find(key);
+        if (it != pipelineLayouts.end()) {
+            return it->second;
+        }
+
+        VkPushConstantRange pushConstantRange{
+                .stageFlags = pushConstantsStages,
+                .offset = 0,
+                .size = pushConstantsSize
+        };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
+                .pSetLayouts = descriptorSetLayouts.data(),
+                .pushConstantRangeCount = pushConstantsSize > 0 ? 1u : 0u,
+                .pPushConstantRanges = &pushConstantRange,
+        };
+
+        VkPipelineLayout pipelineLayout;
+        checkResult(
+                vkCreatePipelineLayout(context->device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+        pipelineLayouts.emplace(std::move(key), pipelineLayout);
+        statistics.pipelineLayouts++;
+        return pipelineLayout;
+    }
+
+    void PipelineBuilder::printStatistics() const {
+        std::cout << "pipeline creation: " << statistics.requestedPipelineStates << " pipeline states requested ("
+                  << (extendedDynamicState && (context->features.extendedDynamicState ||
+                                               context->features.extendedDynamicState3Blend) ? "with" : "without")
+                  << " extended dynamic state), "
+                  << statistics.createdPipelines << " pipelines ("
+                  << statistics.reusedPipelines << " requests reused an existing pipeline, "
+                  << statistics.pipelineLayouts << " pipeline layouts) in "
+                  << statistics.creationTime << " ms ("
+                  << (statistics.warmCache ? "warm" : "cold") << " cache)" << std::endl;
+        if (context->features.graphicsPipelineLibrary) {
+            std::cout << "pipeline libraries: " << statistics.pipelineLibraries << " parts, "
+                      << statistics.fastLinkedPipelines << " fast-linked pipelines, "
+                      << statistics.optimizedPipelines << " replaced by optimized pipelines" << std::endl;
+        }
+        if (statistics.reloadedPipelines > 0) {
+            std::cout << "reloaded pipelines: " << statistics.reloadedPipelines << std::endl;
         }
     }
 
@@ -98,75 +701,77 @@ namespace engine::renderer {
         return shaderModule;
     }
 
-    PipelineData &PipelineBuilder::createPipeline(const VkRenderPass &renderPass,
-                                                  const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
-                                                  const std::string &vertexShaderPath,
-                                                  const std::string &fragmentShaderPath) {
-        VkPipeline pipeline;
-        VkPipelineLayout pipelineLayout;
-
-        std::string shadersDirectory = "shaders/";
+    /*
+     * The vertex attributes of VertexAttributes, by location
+     */
+    static const std::array<VkVertexInputAttributeDescription, 3> vertexAttributes{{
+            {.location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = 0}, // position
+            {.location = 1, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, // uv
+                    .offset = sizeof(VertexAttributes::position)},
+            {.location = 2, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, // normal
+                    .offset = sizeof(VertexAttributes::position) + sizeof(VertexAttributes::uv)},
+    }};
 
-        std::vector<char> vertexShaderCode = readFile(shadersDirectory + vertexShaderPath);
-        std::vector<char> fragmentShaderCode = readFile(shadersDirectory + fragmentShaderPath);
-
-        VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-        VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertexShaderStageInfo{
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                .module = vertexShaderModule,
-                .pName = "main",
-        };
+    /*
+     * Returns a mask of the vertex attributes the vertex shader reads, throws when it reads an attribute
+     * that the vertices don't contain
+     */
+    static uint32_t getVertexInputs(const std::vector<char> &vertexShaderCode) {
+        uint32_t mask = 0;
+        for (auto const &input: ShaderReflection(vertexShaderCode).getInputs()) {
+            if (input.location >= vertexAttributes.size() || vertexAttributes[input.location].format != input.format) {
+                throw std::runtime_error("vertex shader input at location " + std::to_string(input.location) +
+                                         " does not match the vertex attributes");
+            }
+            mask |= 1u << input.location;
+        }
+        return mask;
+    }
 
-        VkPipelineShaderStageCreateInfo fragmentShaderStageInfo{
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .module = fragmentShaderModule,
-                .pName = "main",
-        };
+    /*
+     * The fixed function state of a graphics pipeline, shared between monolithic pipelines and pipeline libraries.
+     * The create infos point into the struct itself, so it can't be copied.
+     */
+    struct GraphicsPipelineState {
+        VkVertexInputBindingDescription vertexInputBindingDescription;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        VkPipelineVertexInputStateCreateInfo vertexInputState;
+        VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+        VkViewport viewport;
+        VkRect2D scissor;
+        VkPipelineViewportStateCreateInfo viewportState;
+        VkPipelineRasterizationStateCreateInfo rasterizationState;
+        VkPipelineMultisampleStateCreateInfo multisampleState;
+        VkPipelineDepthStencilStateCreateInfo depthStencilState;
+        VkPipelineColorBlendAttachmentState colorBlendAttachment;
+        VkPipelineColorBlendStateCreateInfo colorBlendState;
+        std::vector<VkDynamicState> dynamicStates;
+        VkPipelineDynamicStateCreateInfo dynamicState;
 
-        std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos{
-                vertexShaderStageInfo,
-                fragmentShaderStageInfo
-        };
+        // only the vertex attributes in the mask are input
+        explicit GraphicsPipelineState(const PipelineConfiguration &configuration, uint32_t vertexInputs,
+                                       VkExtent2D extent, const std::vector<VkDynamicState> &additionalDynamicStates);
+        GraphicsPipelineState(const GraphicsPipelineState &) = delete;
+        GraphicsPipelineState &operator=(const GraphicsPipelineState &) = delete;
+    };
 
-        VkVertexInputBindingDescription vertexInputBindingDescription{
+    GraphicsPipelineState::GraphicsPipelineState(const PipelineConfiguration &configuration, uint32_t vertexInputs,
+                                                 VkExtent2D extent,
+                                                 const std::vector<VkDynamicState> &additionalDynamicStates) {
+        vertexInputBindingDescription = {
                 .binding = 0,
                 .stride = sizeof(VertexAttributes),
                 .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
         };
 
-        VkVertexInputAttributeDescription pos{
-                .location = 0,
-                .binding = 0,
-                .format = VK_FORMAT_R32G32B32_SFLOAT,
-                .offset = 0
-        };
-
-        VkVertexInputAttributeDescription uv{
-                .location = 1,
-                .binding = 0,
-                .format = VK_FORMAT_R32G32_SFLOAT, // vec2
-                .offset = sizeof(VertexAttributes::position)
-        };
-
-        VkVertexInputAttributeDescription normal{
-                .location = 2,
-                .binding = 0,
-                .format = VK_FORMAT_R32G32B32_SFLOAT, // vec3
-                .offset = sizeof(VertexAttributes::position) + sizeof(VertexAttributes::uv)
-        };
-
-        std::vector<VkVertexInputAttributeDescription> attributes{
-                pos,
-                uv,
-                normal
-        };
+        for (auto const &attribute: vertexAttributes) {
+            if (vertexInputs & (1u << attribute.location)) {
+                attributes.push_back(attribute);
+            }
+        }
 
         // how are vertices input into the pipeline
-        VkPipelineVertexInputStateCreateInfo vertexInputState{
+        vertexInputState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
                 .vertexBindingDescriptionCount = 1,
                 .pVertexBindingDescriptions = &vertexInputBindingDescription,
@@ -175,7 +780,7 @@ namespace engine::renderer {
         };
 
         // how do vertices get converted into a primitive (i.e. triangle)
-        VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{
+        inputAssemblyState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
                 .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
                 .primitiveRestartEnable = VK_FALSE,
@@ -185,9 +790,7 @@ namespace engine::renderer {
         // tesselationState.sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
         // tesselationState.patchControlPoints
 
-        VkExtent2D extent = swapchain.extent;
-
-        VkViewport viewport{
+        viewport = {
                 .x = 0.0f,
                 .y = 0.0f,
                 .width = (float) extent.width,
@@ -196,12 +799,12 @@ namespace engine::renderer {
                 .maxDepth = 1.0f,
         };
 
-        VkRect2D scissor{
+        scissor = {
                 .offset = {0, 0},
                 .extent = extent,
         };
 
-        VkPipelineViewportStateCreateInfo viewportState{
+        viewportState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
                 .viewportCount = 1,
                 .pViewports = &viewport,
@@ -209,12 +812,12 @@ namespace engine::renderer {
                 .pScissors = &scissor,
         };
 
-        VkPipelineRasterizationStateCreateInfo rasterizationState{
+        rasterizationState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
                 .depthClampEnable = VK_FALSE,
                 .rasterizerDiscardEnable = VK_FALSE,
                 .polygonMode = VK_POLYGON_MODE_FILL,// VK_POLYGON_MODE_LINE for wireframe
-                .cullMode = VK_CULL_MODE_BACK_BIT,
+                .cullMode = configuration.cullMode,
                 .frontFace = VK_FRONT_FACE_CLOCKWISE,
                 .depthBiasEnable = VK_FALSE,
                 .depthBiasConstantFactor = 0.0f,
@@ -223,7 +826,7 @@ namespace engine::renderer {
                 .lineWidth = 1.0f,
         };
 
-        VkPipelineMultisampleStateCreateInfo multisampleState{
+        multisampleState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
                 .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
                 .sampleShadingEnable = VK_FALSE,
@@ -233,11 +836,11 @@ namespace engine::renderer {
                 .alphaToOneEnable = VK_FALSE,
         };
 
-        VkPipelineDepthStencilStateCreateInfo depthStencilState{
+        depthStencilState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
                 .depthTestEnable = VK_TRUE,
-                .depthWriteEnable = VK_TRUE,
-                .depthCompareOp = VK_COMPARE_OP_LESS,
+                .depthWriteEnable = configuration.depthWrite ? VK_TRUE : VK_FALSE,
+                .depthCompareOp = configuration.depthCompareOp,
                 .depthBoundsTestEnable = VK_FALSE,
                 .stencilTestEnable = VK_FALSE,
                 .front = {},
@@ -246,19 +849,18 @@ namespace engine::renderer {
                 .maxDepthBounds = 1.0f,
         };
 
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{
-                .blendEnable = VK_TRUE,
+        colorBlendAttachment = {
+                .blendEnable = configuration.blending ? VK_TRUE : VK_FALSE,
                 .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
                 .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
                 .colorBlendOp = VK_BLEND_OP_ADD,
                 .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
                 .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
                 .alphaBlendOp = VK_BLEND_OP_ADD,
-                .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-                                  VK_COLOR_COMPONENT_A_BIT,
+                .colorWriteMask = configuration.colorWriteMask,
         };
 
-        VkPipelineColorBlendStateCreateInfo colorBlendState{
+        colorBlendState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
                 .logicOpEnable = VK_FALSE,
                 .logicOp = VK_LOGIC_OP_COPY,
@@ -267,67 +869,678 @@ namespace engine::renderer {
                 .blendConstants {0.0f, 0.0f, 0.0f, 0.0f}
         };
 
-        std::vector<VkDynamicState> dynamicStates{
+        dynamicStates = {
                 VK_DYNAMIC_STATE_VIEWPORT,
                 VK_DYNAMIC_STATE_SCISSOR
         };
+        dynamicStates.insert(dynamicStates.end(), additionalDynamicStates.begin(), additionalDynamicStates.end());
 
-        VkPipelineDynamicStateCreateInfo dynamicState{
+        dynamicState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
                 .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
                 .pDynamicStates = dynamicStates.data(),
         };
+    }
 
-        VkPushConstantRange pushConstantRange{
-                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-                .offset = 0,
-                .size = sizeof(glm::mat4)
+    /*
+     * Boolean specialization constants with constant ids 0 to 31, constants that a shader doesn't declare are ignored
+     */
+    struct SpecializationData {
+        std::array<VkBool32, 32> values;
+        std::array<VkSpecializationMapEntry, 32> entries;
+        VkSpecializationInfo info;
+
+        explicit SpecializationData(uint32_t specializationConstants);
+        SpecializationData(const SpecializationData &) = delete;
+        SpecializationData &operator=(const SpecializationData &) = delete;
+    };
+
+    SpecializationData::SpecializationData(uint32_t specializationConstants) {
+        for (uint32_t i = 0; i < 32; i++) {
+            values[i] = (specializationConstants >> i) & 1u;
+            entries[i] = {
+                    .constantID = i,
+                    .offset = static_cast<uint32_t>(i * sizeof(VkBool32)),
+                    .size = sizeof(VkBool32),
+            };
+        }
+        info = {
+                .mapEntryCount = static_cast<uint32_t>(entries.size()),
+                .pMapEntries = entries.data(),
+                .dataSize = sizeof(values),
+                .pData = values.data(),
         };
+    }
 
-        std::vector<VkPushConstantRange> pushConstantRanges{
-                pushConstantRange
+    static VkPipelineShaderStageCreateInfo createShaderStage(VkShaderStageFlagBits stage, VkShaderModule module,
+                                                             const SpecializationData &specialization) {
+        return {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = stage,
+                .module = module,
+                .pName = "main",
+                .pSpecializationInfo = &specialization.info,
         };
+    }
 
-        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-                .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
-                .pSetLayouts = descriptorSetLayouts.data(),
-                .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
-                .pPushConstantRanges = pushConstantRanges.data(),
+    PipelineData &PipelineBuilder::createPipeline(const VkRenderPass &renderPass,
+                                                  const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                                  const std::string &vertexShaderPath,
+                                                  const std::string &fragmentShaderPath,
+                                                  const PipelineConfiguration &configuration) {
+        PipelineData &pipelineData = findOrCreatePipeline(renderPass, descriptorSetLayouts, vertexShaderPath,
+                                                          fragmentShaderPath, configuration);
+        // the caller keeps the reference, so a reload never retires the pipeline
+        std::lock_guard<std::mutex> lock(mutex);
+        retainedPipelines.insert(&pipelineData);
+        return pipelineData;
+    }
+
+    PipelineData &PipelineBuilder::findOrCreatePipeline(const VkRenderPass &renderPass,
+                                                        const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                                        const std::string &vertexShaderPath,
+                                                        const std::string &fragmentShaderPath,
+                                                        const PipelineConfiguration &configuration) {
+        std::string shadersDirectory = "shaders/";
+
+        std::vector<char> vertexShaderCode = readFile(shadersDirectory + vertexShaderPath);
+        std::vector<char> fragmentShaderCode = readFile(shadersDirectory + fragmentShaderPath);
+
+        PipelineDescription description{
+                .vertexShaderHash = hashCode(vertexShaderCode),
+                .fragmentShaderHash = hashCode(fragmentShaderCode),
+                .vertexStride = sizeof(VertexAttributes),
+                .vertexInputs = getVertexInputs(vertexShaderCode),
+                .configuration = getStaticConfiguration(configuration),
+                .renderPass = renderPass,
+                .pipelineLayout = getPipelineLayout(descriptorSetLayouts, configuration.pushConstantsSize,
+                                                    configuration.pushConstantsStages),
         };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            PipelineDescription requestedDescription = description;
+            requestedDescription.configuration = configuration;
+            requestedDescription.configuration.dynamicState = false;
+            if (requestedDescriptions.insert(requestedDescription).second) {
+                statistics.requestedPipelineStates++;
+            }
 
-        checkResult(
-                vkCreatePipelineLayout(context->device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+            auto it = pipelinesByDescription.find(description);
+            if (it != pipelinesByDescription.end()) {
+                statistics.reusedPipelines++;
+                return *it->second;
+            }
+        }
+
+        bool useLibraries = context->features.graphicsPipelineLibrary;
+        std::array<VkPipeline, 4> libraries{};
+        VkPipeline pipeline;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (useLibraries) {
+            libraries = getPipelineLibraries(description, vertexShaderCode, fragmentShaderCode);
+            pipeline = linkPipeline(libraries, description.pipelineLayout, false);
+        } else {
+            pipeline = createMonolithicPipeline(description, vertexShaderCode, fragmentShaderCode);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << (useLibraries ? "linked pipeline" : "created pipeline") << std::endl;
+
+        PipelineData *pipelineData;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statistics.creationTime += std::chrono::duration<float, std::milli>(end - start).count();
+
+            // another thread could have created the same pipeline in the meantime
+            auto it = pipelinesByDescription.find(description);
+            if (it != pipelinesByDescription.end()) {
+                vkDestroyPipeline(context->device, pipeline, nullptr);
+                statistics.reusedPipelines++;
+                return *it->second;
+            }
+
+            statistics.createdPipelines++;
+            pipelineData = pipelines.emplace_back(
+                    std::make_unique<PipelineData>(pipeline, description.pipelineLayout)).get();
+            pipelinesByDescription.emplace(description, pipelineData);
+
+            if (useLibraries) {
+                statistics.fastLinkedPipelines++;
+                pendingPipelines++;
+            }
+        }
+
+        if (useLibraries) {
+            // the fast-linked pipeline is usable right away, but can be slower on the gpu
+            VkPipelineLayout pipelineLayout = description.pipelineLayout;
+            runAsync([this, pipelineData, libraries, pipelineLayout]() {
+                VkPipeline optimizedPipeline = VK_NULL_HANDLE;
+                try {
+                    optimizedPipeline = linkPipeline(libraries, pipelineLayout, true);
+                } catch (const std::exception &e) {
+                    std::cout << "failed to link optimized pipeline: " << e.what() << std::endl;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (optimizedPipeline != VK_NULL_HANDLE) {
+                        optimizedPipelines.emplace_back(pipelineData, optimizedPipeline);
+                    }
+                    pendingPipelines--;
+                }
+                pipelinesCreated.notify_all();
+            });
+        }
+
+        return *pipelineData;
+    }
+
+    VkPipeline PipelineBuilder::createMonolithicPipeline(const PipelineDescription &description,
+                                                         const std::vector<char> &vertexShaderCode,
+                                                         const std::vector<char> &fragmentShaderCode) {
+        VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
+        VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
+
+        SpecializationData specialization(description.configuration.specializationConstants);
+        std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos{
+                createShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModule, specialization),
+                createShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule, specialization)
+        };
+
+        GraphicsPipelineState state(description.configuration, description.vertexInputs, swapchain.extent,
+                                    getDynamicStates(description.configuration));
 
         VkGraphicsPipelineCreateInfo createInfo{
                 .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
                 .stageCount = static_cast<uint32_t>(shaderStageInfos.size()),
                 .pStages = shaderStageInfos.data(),
-                .pVertexInputState = &vertexInputState,
-                .pInputAssemblyState = &inputAssemblyState,
+                .pVertexInputState = &state.vertexInputState,
+                .pInputAssemblyState = &state.inputAssemblyState,
                 .pTessellationState = nullptr,
-                .pViewportState = &viewportState,
-                .pRasterizationState = &rasterizationState,
-                .pMultisampleState = &multisampleState,
-                .pDepthStencilState = &depthStencilState,
-                .pColorBlendState = &colorBlendState,
-                .pDynamicState = &dynamicState,
-                .layout = pipelineLayout,
-                .renderPass = renderPass,
+                .pViewportState = &state.viewportState,
+                .pRasterizationState = &state.rasterizationState,
+                .pMultisampleState = &state.multisampleState,
+                .pDepthStencilState = &state.depthStencilState,
+                .pColorBlendState = &state.colorBlendState,
+                .pDynamicState = &state.dynamicState,
+                .layout = description.pipelineLayout,
+                .renderPass = description.renderPass,
                 .subpass = 0,
                 .basePipelineHandle = VK_NULL_HANDLE, // / optional, can be used to create a new graphics pipeline by deriving from an existing.pipeline, makes switching quicker
                 .basePipelineIndex = -1
         };
 
-        checkResult(vkCreateGraphicsPipelines(context->device, VK_NULL_HANDLE, 1, &createInfo, nullptr,
+        VkPipeline pipeline;
+        checkResult(vkCreateGraphicsPipelines(context->device, getPipelineCache(), 1, &createInfo, nullptr,
                                               &pipeline));
 
-        std::cout << "created pipeline" << std::endl;
-
         vkDestroyShaderModule(context->device, vertexShaderModule, nullptr);
         vkDestroyShaderModule(context->device, fragmentShaderModule, nullptr);
+        return pipeline;
+    }
+
+    /*
+     * Each part is keyed by only the state it contains, so that for example a new fragment shader reuses the vertex
+     * input, pre-rasterization and fragment output parts of earlier pipelines.
+     */
+    std::array<VkPipeline, 4> PipelineBuilder::getPipelineLibraries(const PipelineDescription &description,
+                                                                   const std::vector<char> &vertexShaderCode,
+                                                                   const std::vector<char> &fragmentShaderCode) {
+        const PipelineConfiguration &configuration = description.configuration;
+        GraphicsPipelineState state(configuration, description.vertexInputs, swapchain.extent,
+                                    getDynamicStates(configuration));
+        SpecializationData specialization(configuration.specializationConstants);
+
+        std::pair<uint32_t, uint32_t> vertexInputKey{description.vertexStride, description.vertexInputs};
+        VkPipeline vertexInput = getPipelineLibrary(vertexInputLibraries, vertexInputKey, [&]() {
+            VkGraphicsPipelineCreateInfo createInfo{
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .pVertexInputState = &state.vertexInputState,
+                    .pInputAssemblyState = &state.inputAssemblyState,
+                    .pDynamicState = &state.dynamicState,
+            };
+            return createPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, createInfo);
+        });
+
+        PreRasterizationKey preRasterizationKey{description.vertexShaderHash, configuration.specializationConstants,
+                                                description.pipelineLayout,
+                                                description.renderPass, configuration.cullMode,
+                                                hasDynamicDepthState(configuration)};
+        VkPipeline preRasterization = getPipelineLibrary(preRasterizationLibraries, preRasterizationKey, [&]() {
+            VkShaderModule module = createShaderModule(vertexShaderCode);
+            VkPipelineShaderStageCreateInfo stage = createShaderStage(VK_SHADER_STAGE_VERTEX_BIT, module,
+                                                                      specialization);
+            VkGraphicsPipelineCreateInfo createInfo{
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .stageCount = 1,
+                    .pStages = &stage,
+                    .pViewportState = &state.viewportState,
+                    .pRasterizationState = &state.rasterizationState,
+                    .pDynamicState = &state.dynamicState,
+                    .layout = description.pipelineLayout,
+                    .renderPass = description.renderPass,
+                    .subpass = 0,
+            };
+            VkPipeline library = createPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+                                                       createInfo);
+            vkDestroyShaderModule(context->device, module, nullptr);
+            return library;
+        });
+
+        FragmentShaderKey fragmentShaderKey{description.fragmentShaderHash, configuration.specializationConstants,
+                                            description.pipelineLayout,
+                                            description.renderPass, configuration.depthWrite,
+                                            configuration.depthCompareOp, hasDynamicDepthState(configuration)};
+        VkPipeline fragmentShader = getPipelineLibrary(fragmentShaderLibraries, fragmentShaderKey, [&]() {
+            VkShaderModule module = createShaderModule(fragmentShaderCode);
+            VkPipelineShaderStageCreateInfo stage = createShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, module,
+                                                                      specialization);
+            VkGraphicsPipelineCreateInfo createInfo{
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .stageCount = 1,
+                    .pStages = &stage,
+                    .pMultisampleState = &state.multisampleState,
+                    .pDepthStencilState = &state.depthStencilState,
+                    .pDynamicState = &state.dynamicState,
+                    .layout = description.pipelineLayout,
+                    .renderPass = description.renderPass,
+                    .subpass = 0,
+            };
+            VkPipeline library = createPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+                                                       createInfo);
+            vkDestroyShaderModule(context->device, module, nullptr);
+            return library;
+        });
+
+        FragmentOutputKey fragmentOutputKey{description.renderPass, configuration.blending,
+                                            configuration.colorWriteMask, hasDynamicBlendState(configuration)};
+        VkPipeline fragmentOutput = getPipelineLibrary(fragmentOutputLibraries, fragmentOutputKey, [&]() {
+            VkGraphicsPipelineCreateInfo createInfo{
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .pMultisampleState = &state.multisampleState,
+                    .pColorBlendState = &state.colorBlendState,
+                    .pDynamicState = &state.dynamicState,
+                    .renderPass = description.renderPass,
+                    .subpass = 0,
+            };
+            return createPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, createInfo);
+        });
+
+        return {vertexInput, preRasterization, fragmentShader, fragmentOutput};
+    }
+
+    template<typename Key>
+    VkPipeline PipelineBuilder::getPipelineLibrary(std::map<Key, VkPipeline> &libraries, const Key &key,
+                                                   const std::function<VkPipeline()> &create) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = libraries.find(key);
+            if (it != libraries.end()) {
+                return it->second;
+            }
+        }
+
+        // created outside the lock, so that threads can compile different parts concurrently
+        VkPipeline library = create();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto [it, inserted] = libraries.emplace(key, library);
+        if (!inserted) {
+            vkDestroyPipeline(context->device, library, nullptr);
+        } else {
+            statistics.pipelineLibraries++;
+        }
+        return it->second;
+    }
+
+    VkPipeline PipelineBuilder::createPipelineLibrary(VkGraphicsPipelineLibraryFlagsEXT part,
+                                                      VkGraphicsPipelineCreateInfo createInfo) {
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{
+                .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+                .flags = part,
+        };
+        createInfo.pNext = &libraryInfo;
+        // the link time optimization info is needed for linking optimized pipelines later on
+        createInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+                           VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+        createInfo.basePipelineIndex = -1;
+
+        VkPipeline library;
+        checkResult(vkCreateGraphicsPipelines(context->device, getPipelineCache(), 1, &createInfo, nullptr,
+                                              &library));
+        return library;
+    }
+
+    VkPipeline PipelineBuilder::linkPipeline(const std::array<VkPipeline, 4> &libraries,
+                                             VkPipelineLayout pipelineLayout, bool optimize) {
+        VkPipelineLibraryCreateInfoKHR libraryInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+                .libraryCount = static_cast<uint32_t>(libraries.size()),
+                .pLibraries = libraries.data(),
+        };
+
+        VkPipelineCreateFlags flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+        VkGraphicsPipelineCreateInfo createInfo{
+                .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                .pNext = &libraryInfo,
+                .flags = flags,
+                .layout = pipelineLayout,
+                .basePipelineIndex = -1,
+        };
+
+        VkPipeline pipeline;
+        checkResult(vkCreateGraphicsPipelines(context->device, getPipelineCache(), 1, &createInfo, nullptr,
+                                              &pipeline));
+        return pipeline;
+    }
+
+    /*
+     * Should be called on the thread that records command buffers, before recording. The replaced pipelines
+     * could still be used by command buffers in flight, so they are retired through the deletion queue.
+     */
+    void PipelineBuilder::applyOptimizedPipelines() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &[pipelineData, optimizedPipeline]: optimizedPipelines) {
+            if (pipelineData->pipeline == VK_NULL_HANDLE) {
+                // the fast-linked pipeline was retired by a reload while it was being optimized, never used
+                vkDestroyPipeline(context->device, optimizedPipeline, nullptr);
+                continue;
+            }
+            retirePipeline(pipelineData->pipeline);
+            pipelineData->pipeline = optimizedPipeline;
+            statistics.optimizedPipelines++;
+            completedPipelines++;
+        }
+        optimizedPipelines.clear();
+    }
+
+    std::string PipelineBuilder::getReloadedShaderPath(const std::string &shaderPath) const {
+        auto it = shaderPathReplacements.find(shaderPath);
+        return it != shaderPathReplacements.end() ? it->second : shaderPath;
+    }
+
+    /*
+     * Returns what differs between the resources the modules declare, empty when the modules can replace each other
+     * without changing the descriptor set layouts, push constants or material parameters
+     */
+    static std::string getInterfaceDifference(const ShaderReflection &oldModule, const ShaderReflection &newModule) {
+        if (oldModule.stage != newModule.stage) {
+            return "the stage differs";
+        }
+
+        std::vector<ReflectedBinding> oldBindings = oldModule.getBindings();
+        std::vector<ReflectedBinding> newBindings = newModule.getBindings();
+        bool bindingsEqual = std::equal(oldBindings.begin(), oldBindings.end(), newBindings.begin(), newBindings.end(),
+                                        [](const ReflectedBinding &a, const ReflectedBinding &b) {
+                                            return a.set == b.set && a.binding == b.binding &&
+                                                   a.descriptorType == b.descriptorType &&
+                                                   a.descriptorCount == b.descriptorCount &&
+                                                   a.stageFlags == b.stageFlags;
+                                        });
+        if (!bindingsEqual) {
+            return "the bindings differ";
+        }
+
+        if (oldModule.getPushConstantsSize() != newModule.getPushConstantsSize()) {
+            return "the push constants differ";
+        }
+
+        std::optional<ReflectedStruct> oldParameters = oldModule.getStruct("MaterialParameters");
+        std::optional<ReflectedStruct> newParameters = newModule.getStruct("MaterialParameters");
+        bool parametersEqual = oldParameters.has_value() == newParameters.has_value();
+        if (parametersEqual && oldParameters) {
+            parametersEqual = oldParameters->size == newParameters->size &&
+                              std::equal(oldParameters->members.begin(), oldParameters->members.end(),
+                                         newParameters->members.begin(), newParameters->members.end(),
+                                         [](const ReflectedMember &a, const ReflectedMember &b) {
+                                             return a.name == b.name && a.type == b.type && a.offset == b.offset &&
+                                                    a.size == b.size;
+                                         });
+        }
+        if (!parametersEqual) {
+            return "the material parameters differ";
+        }
+        return "";
+    }
+
+    /*
+     * The layouts and material blocks of the existing shaders and materials were created from the reflection of the
+     * old module, so a module that declares different resources is rejected, like a module that fails to compile
+     */
+    void PipelineBuilder::reloadShader(const std::string &reloadedShaderPath, const std::string &newShaderPath) {
+        // a module that replaces a rejected module replaces the module the pipelines still use
+        std::string oldShaderPath = reloadedShaderPath;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto rejected = rejectedShaderPaths.find(reloadedShaderPath);
+            if (rejected != rejectedShaderPaths.end()) {
+                oldShaderPath = rejected->second;
+            }
+        }
+
+        std::string difference;
+        try {
+            difference = getInterfaceDifference(ShaderReflection(readFile("shaders/" + oldShaderPath)),
+                                                ShaderReflection(readFile("shaders/" + newShaderPath)));
+        } catch (const std::exception &e) {
+            difference = e.what();
+        }
+        if (!difference.empty()) {
+            std::cout << "failed to reload shader (" << oldShaderPath << ", " << newShaderPath << "): " << difference
+                      << ", the previous shader stays in use" << std::endl;
+            std::lock_guard<std::mutex> lock(mutex);
+            rejectedShaderPaths[newShaderPath] = oldShaderPath;
+            return;
+        }
+
+        std::vector<std::function<void()>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // requests for the original path, or for a path that was reloaded before, get the new shader
+            for (auto &entry: shaderPathReplacements) {
+                if (entry.second == oldShaderPath) {
+                    entry.second = newShaderPath;
+                }
+            }
+            shaderPathReplacements[oldShaderPath] = newShaderPath;
+
+            for (const auto &[key, asyncPipeline]: asyncPipelinesByKey) {
+                if (asyncPipeline->vertexShaderPath != oldShaderPath &&
+                    asyncPipeline->fragmentShaderPath != oldShaderPath) {
+                    continue;
+                }
+                asyncPipeline->vertexShaderPath = getReloadedShaderPath(asyncPipeline->vertexShaderPath);
+                asyncPipeline->fragmentShaderPath = getReloadedShaderPath(asyncPipeline->fragmentShaderPath);
+                uint32_t generation = ++asyncPipeline->generation;
+                pendingPipelines++;
+
+                VkRenderPass renderPass = std::get<0>(key);
+                std::vector<VkDescriptorSetLayout> descriptorSetLayouts = std::get<1>(key);
+                PipelineConfiguration configuration = std::get<4>(key);
+                jobs.emplace_back([this, asyncPipeline, generation, renderPass, descriptorSetLayouts, configuration,
+                                          vertexShaderPath = asyncPipeline->vertexShaderPath,
+                                          fragmentShaderPath = asyncPipeline->fragmentShaderPath]() {
+                    try {
+                        PipelineData &pipelineData = findOrCreatePipeline(renderPass, descriptorSetLayouts,
+                                                                          vertexShaderPath, fragmentShaderPath,
+                                                                          configuration);
+                        std::lock_guard<std::mutex> lock(mutex);
+                        reloadedPipelines.emplace_back(asyncPipeline, &pipelineData, generation);
+                    } catch (const std::exception &e) {
+                        // the previous pipeline stays in use
+                        std::cout << "failed to reload pipeline (" << vertexShaderPath << ", " << fragmentShaderPath
+                                  << "): " << e.what() << std::endl;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        pendingPipelines--;
+                    }
+                    pipelinesCreated.notify_all();
+                });
+            }
+        }
+
+        for (auto &job: jobs) {
+            runAsync(std::move(job));
+        }
+    }
+
+    /*
+     * Like the optimized pipelines, the replaced pipelines could still be used by command buffers in flight,
+     * they are retired through the deletion queue, so that reloading never has to wait for the device to be idle.
+     */
+    void PipelineBuilder::applyReloadedPipelines() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<PipelineData *> replaced;
+        for (const auto &[asyncPipeline, pipelineData, generation]: reloadedPipelines) {
+            // a newer reload of the same pipeline was queued after this one, or the reload found a pipeline
+            // that was retired in the meantime, the previous pipeline then stays in use
+            if (generation != asyncPipeline->generation || pipelineData->pipeline == VK_NULL_HANDLE) {
+                continue;
+            }
+            PipelineData *previous = asyncPipeline->pipelineData.exchange(pipelineData, std::memory_order_acq_rel);
+            if (previous != nullptr && previous != pipelineData) {
+                replaced.push_back(previous);
+            }
+            asyncPipeline->failed.store(false, std::memory_order_release);
+            statistics.reloadedPipelines++;
+            completedPipelines++;
+        }
+        reloadedPipelines.clear();
+
+        for (PipelineData *pipelineData: replaced) {
+            // pipelines are shared between requests with the same description
+            bool inUse = pipelineData->pipeline == VK_NULL_HANDLE || retainedPipelines.contains(pipelineData) ||
+                         std::any_of(asyncPipelines.begin(), asyncPipelines.end(), [&](const auto &asyncPipeline) {
+                             return asyncPipeline->pipelineData.load(std::memory_order_acquire) == pipelineData;
+                         });
+            if (inUse) {
+                continue;
+            }
+            std::erase_if(pipelinesByDescription, [&](const auto &entry) { return entry.second == pipelineData; });
+            // the data itself stays owned by the builder, as an optimized pipeline could still be linked for it
+            retirePipeline(pipelineData->pipeline);
+            pipelineData->pipeline = VK_NULL_HANDLE;
+        }
+    }
+
+    void PipelineBuilder::retirePipeline(VkPipeline pipeline) {
+        deletionQueue->push([pipeline]() {
+            vkDestroyPipeline(context->device, pipeline, nullptr);
+        });
+    }
+
+    bool PipelineBuilder::hasDynamicDepthState(const PipelineConfiguration &configuration) const {
+        return configuration.dynamicState && extendedDynamicState && context->features.extendedDynamicState;
+    }
+
+    bool PipelineBuilder::hasDynamicBlendState(const PipelineConfiguration &configuration) const {
+        return configuration.dynamicState && extendedDynamicState && context->features.extendedDynamicState3Blend;
+    }
+
+    PipelineConfiguration PipelineBuilder::getStaticConfiguration(const PipelineConfiguration &configuration) const {
+        PipelineConfiguration defaults{};
+        PipelineConfiguration result = configuration;
+        if (hasDynamicDepthState(configuration)) {
+            result.cullMode = defaults.cullMode;
+            result.depthWrite = defaults.depthWrite;
+            result.depthCompareOp = defaults.depthCompareOp;
+        }
+        if (hasDynamicBlendState(configuration)) {
+            result.blending = defaults.blending;
+            result.colorWriteMask = defaults.colorWriteMask;
+        }
+        // pipelines without any dynamic state are shared with pipelines that did not request it
+        result.dynamicState = hasDynamicDepthState(configuration) || hasDynamicBlendState(configuration);
+        return result;
+    }
+
+    std::vector<VkDynamicState> PipelineBuilder::getDynamicStates(const PipelineConfiguration &configuration) const {
+        std::vector<VkDynamicState> dynamicStates;
+        if (hasDynamicDepthState(configuration)) {
+            dynamicStates.insert(dynamicStates.end(), {VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                                                       VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+                                                       VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT});
+        }
+        if (hasDynamicBlendState(configuration)) {
+            dynamicStates.insert(dynamicStates.end(), {VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT,
+                                                       VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT});
+        }
+        return dynamicStates;
+    }
+
+    void PipelineBuilder::setDynamicState(const VkCommandBuffer &cmd, const PipelineConfiguration &configuration) const {
+        if (hasDynamicDepthState(configuration)) {
+            vkCmdSetCullMode(cmd, configuration.cullMode);
+            vkCmdSetDepthWriteEnable(cmd, configuration.depthWrite ? VK_TRUE : VK_FALSE);
+            vkCmdSetDepthCompareOp(cmd, configuration.depthCompareOp);
+        }
+        if (hasDynamicBlendState(configuration)) {
+            VkBool32 blendEnable = configuration.blending ? VK_TRUE : VK_FALSE;
+            vkCmdSetColorBlendEnable(cmd, 0, 1, &blendEnable);
+            vkCmdSetColorWriteMask(cmd, 0, 1, &configuration.colorWriteMask);
+        }
+    }
+
+    void PipelineBuilder::runAsync(std::function<void()> &&job) {
+        if (threadPool != nullptr && threadPool->getThreadCount() > 0) {
+            threadPool->submit([this, job = std::move(job)]() {
+                try {
+                    threadPipelineCache = acquireThreadCache();
+                } catch (const std::exception &e) {
+                    // the job still has to run, as it signals its completion
+                    std::cout << "failed to create thread pipeline cache: " << e.what() << std::endl;
+                }
+                job();
+                if (threadPipelineCache != VK_NULL_HANDLE) {
+                    releaseThreadCache(threadPipelineCache);
+                    threadPipelineCache = VK_NULL_HANDLE;
+                }
+            });
+        } else {
+            job();
+        }
+    }
+
+    PipelineData &PipelineBuilder::createComputePipeline(const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                                         uint32_t pushConstantsSize,
+                                                         const std::string &computeShaderPath) {
+        VkPipeline pipeline;
+        VkPipelineLayout pipelineLayout = getPipelineLayout(descriptorSetLayouts, pushConstantsSize,
+                                                            VK_SHADER_STAGE_COMPUTE_BIT);
+
+        std::string shadersDirectory = "shaders/";
+
+        std::vector<char> computeShaderCode = readFile(shadersDirectory + computeShaderPath);
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+
+        VkComputePipelineCreateInfo createInfo{
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage = {
+                        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                        .module = computeShaderModule,
+                        .pName = "main",
+                },
+                .layout = pipelineLayout,
+                .basePipelineHandle = VK_NULL_HANDLE,
+                .basePipelineIndex = -1
+        };
+
+        auto start = std::chrono::high_resolution_clock::now();
+        checkResult(vkCreateComputePipelines(context->device, getPipelineCache(), 1, &createInfo, nullptr,
+                                             &pipeline));
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "created compute pipeline" << std::endl;
+
+        vkDestroyShaderModule(context->device, computeShaderModule, nullptr);
 
-        pipelines.emplace_back(std::make_unique<PipelineData>(pipeline, pipelineLayout));
-        return *pipelines.back();
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.createdPipelines++;
+        statistics.creationTime += std::chrono::duration<float, std::milli>(end - start).count();
+        return *pipelines.emplace_back(std::make_unique<PipelineData>(pipeline, pipelineLayout));
     }
 }
\ No newline at end of file
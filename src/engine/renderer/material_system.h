@@ -2,21 +2,151 @@
 #define SPHERE_MATERIAL_SYSTEM_H
 
 #include "texture.h"
+#include "shader_reflection.h"
 
 #include "vulkan.h"
 #include "swapchain.h"
+#include "thread_pool.h"
+#include "glm/glm.hpp"
+
+#include <array>
+#include <atomic>
+#include <compare>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace engine::renderer {
 
     struct PipelineData {
         VkPipeline pipeline;
-        VkPipelineLayout pipelineLayout;
+        VkPipelineLayout pipelineLayout; // shared between pipelines with the same layout (unowned)
 
         explicit PipelineData(const VkPipeline &pipeline, const VkPipelineLayout &pipelineLayout);
     };
 
     /*
-     * Pipelines should be cached in a pipeline cache.
+     * Fixed function state that differs between graphics pipelines, the defaults are used for materials
+     */
+    struct PipelineConfiguration {
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        bool depthWrite = true;
+        VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+        VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                               VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        bool blending = false; // alpha blending, disabling it allows the gpu to skip reading the color attachment
+        uint32_t pushConstantsSize = sizeof(uint32_t); // materials push the object index (see MaterialPushConstants)
+        VkShaderStageFlags pushConstantsStages = VK_SHADER_STAGE_VERTEX_BIT;
+        // the cull mode, depth write, depth compare op, blending and color write mask are set for each draw using
+        // extended dynamic state when the device supports it, so that pipelines that only differ in these are shared
+        bool dynamicState = false;
+        // bit i sets the boolean specialization constant with constant_id i, in both the vertex and fragment stage
+        uint32_t specializationConstants = 0;
+
+        auto operator<=>(const PipelineConfiguration &other) const = default;
+    };
+
+    /*
+     * Everything that determines the state of a graphics pipeline. Pipelines with equal descriptions are created once
+     * and shared, even when they were requested by different shaders.
+     */
+    struct PipelineDescription {
+        uint64_t vertexShaderHash; // of the SPIR-V code
+        uint64_t fragmentShaderHash;
+        uint32_t vertexStride; // the vertex attributes are always those of VertexAttributes
+        uint32_t vertexInputs; // mask of the attribute locations read by the vertex shader (from reflection)
+        PipelineConfiguration configuration;
+        // render passes are compared by handle instead of by compatibility, as each pass is created only once
+        VkRenderPass renderPass;
+        VkPipelineLayout pipelineLayout;
+
+        bool operator==(const PipelineDescription &other) const = default;
+
+        struct Hash {
+            size_t operator()(const PipelineDescription &description) const;
+        };
+    };
+
+    /*
+     * Pushed for each draw. Shaders without bindless textures only use the object index, in the vertex stage
+     */
+    struct MaterialPushConstants {
+        uint32_t objectIndex; // into the transform buffer
+        uint32_t textureIndex; // into the bindless texture array
+        uint32_t materialIndex; // into the material buffer
+    };
+
+    /*
+     * Determines when objects get drawn, and with what fixed function state
+     */
+    enum class RenderQueue {
+        // drawn first and front-to-back without blending, so that early depth testing rejects hidden fragments
+        Opaque,
+        // drawn after all opaque objects and back-to-front with blending, without writing depth
+        Transparent
+    };
+
+    struct PipelineCreationStatistics {
+        bool warmCache; // whether a valid pipeline cache was loaded from disk
+        uint32_t createdPipelines;
+        uint32_t reusedPipelines; // requests that returned an existing pipeline with the same description
+        uint32_t pipelineLayouts;
+        // distinct graphics pipeline states that were requested, which is the amount of graphics pipelines that
+        // would have been created without extended dynamic state
+        uint32_t requestedPipelineStates;
+        uint32_t pipelineLibraries; // parts created with VK_EXT_graphics_pipeline_library
+        uint32_t fastLinkedPipelines;
+        uint32_t optimizedPipelines; // fast-linked pipelines that were replaced by a link time optimized pipeline
+        uint32_t reloadedPipelines; // pipelines that were replaced after one of their shaders was reloaded
+        float creationTime; // total time spent creating pipelines, summed over all threads, in milliseconds
+    };
+
+    /*
+     * Handle to a pipeline that is being created on a worker thread. Objects that use the pipeline should be
+     * skipped or drawn with a fallback pipeline until it is ready.
+     */
+    class AsyncPipeline {
+
+    public:
+        // the pipeline, or nullptr when it is not ready yet or failed to be created
+        [[nodiscard]] PipelineData *get() const;
+
+        [[nodiscard]] bool isReady() const;
+
+        // whether creating the pipeline threw, in which case it will never become ready
+        [[nodiscard]] bool hasFailed() const;
+
+        // as requested, the dynamic state of which should be set with PipelineBuilder::setDynamicState
+        [[nodiscard]] const PipelineConfiguration &getConfiguration() const;
+
+    private:
+        friend class PipelineBuilder;
+
+        PipelineConfiguration configuration;
+
+        // the shaders the pipeline is currently created with, which change when the shaders are reloaded
+        std::string vertexShaderPath;
+        std::string fragmentShaderPath;
+        uint32_t generation = 0; // incremented for each reload, so that older results are discarded
+
+        std::atomic<PipelineData *> pipelineData{nullptr}; // (unowned pointer)
+        std::atomic<bool> failed{false};
+    };
+
+    /*
+     * Pipelines are created through a VkPipelineCache that is loaded from disk at startup and saved on shutdown,
+     * so that the driver does not have to compile the same shaders again on every launch.
+     *
+     * Graphics pipelines can be created asynchronously on the thread pool, so that loading many shaders
+     * neither serializes startup nor causes hitches when a new material is created in the middle of a frame.
+     *
+     * With VK_EXT_graphics_pipeline_library, the vertex input, pre-rasterization, fragment shader and fragment output
+     * parts are compiled separately and shared between pipelines. A new combination of parts is fast-linked, which is
+     * cheap, and a link time optimized pipeline replaces it once it has been linked in the background.
      *
      * There can be many pipelines, so this should be refactored to support different shaders and materials etc.
      *
@@ -37,20 +167,151 @@ namespace engine::renderer {
     class PipelineBuilder {
 
     public:
-        explicit PipelineBuilder(Swapchain &swapchain);
+        // without a thread pool, asynchronous pipelines are created immediately on the calling thread
+        explicit PipelineBuilder(Swapchain &swapchain, ThreadPool *threadPool = nullptr,
+                                 std::string pipelineCachePath = "pipeline_cache.bin");
         ~PipelineBuilder();
 
-        // should be destroyed
+        // should be destroyed, guarded by mutex while asynchronous pipelines are being created
         std::vector<std::unique_ptr<PipelineData>> pipelines;
 
+        PipelineCreationStatistics statistics{};
+
+        // whether to use extended dynamic state when the device supports it, only affects pipelines created afterwards
+        bool extendedDynamicState = true;
+
+        // returns an existing pipeline if one with the same description was created before
         PipelineData &createPipeline(const VkRenderPass &renderPass, const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
-                                     const std::string &vertexShaderPath, const std::string &fragmentShaderPath);
+                                     const std::string &vertexShaderPath, const std::string &fragmentShaderPath,
+                                     const PipelineConfiguration &configuration = {});
+
+        // queues the pipeline to be created on a worker thread, the handle stays valid until the builder is destroyed.
+        // requests with the same arguments return the same handle
+        AsyncPipeline &createPipelineAsync(const VkRenderPass &renderPass,
+                                           const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                           const std::string &vertexShaderPath, const std::string &fragmentShaderPath,
+                                           const PipelineConfiguration &configuration = {});
+
+        // blocks until all queued asynchronous pipelines have been created
+        void waitForPipelines();
+
+        // number of asynchronous pipelines that have finished (or failed) or have been replaced by an optimized
+        // pipeline, for detecting changes to the available pipelines
+        [[nodiscard]] uint64_t getCompletedPipelineCount() const;
+
+        // replaces fast-linked pipelines with their optimized versions once these have been linked
+        void applyOptimizedPipelines();
+
+        // queues the asynchronous pipelines that use the old shader to be recreated with the new shader,
+        // the old pipelines stay in use until the new pipelines are applied.
+        // ignored when the new shader declares different resources than the old shader
+        void reloadShader(const std::string &oldShaderPath, const std::string &newShaderPath);
+
+        // replaces the pipelines of asynchronous pipelines once their reloaded pipelines have been created
+        void applyReloadedPipelines();
+
+        // sets the state that is dynamic for pipelines created with the configuration, after binding the pipeline
+        void setDynamicState(const VkCommandBuffer &cmd, const PipelineConfiguration &configuration) const;
+
+        PipelineData &createComputePipeline(const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                            uint32_t pushConstantsSize, const std::string &computeShaderPath);
+
+        // writes to a temporary file that replaces the cache file, so that a crash never leaves a partial cache
+        void savePipelineCache();
+
+        void printStatistics() const;
 
     private:
         Swapchain &swapchain;
-        VkPipelineCache pipelineCache;
+        ThreadPool *threadPool; // (unowned pointer)
+        std::string pipelineCachePath;
+        VkPipelineCache pipelineCache; // used on the calling thread, the worker jobs use the thread caches
+
+        using PipelineLayoutKey = std::tuple<std::vector<VkDescriptorSetLayout>, uint32_t, VkShaderStageFlags>;
+        using AsyncPipelineKey = std::tuple<VkRenderPass, std::vector<VkDescriptorSetLayout>, std::string, std::string,
+                PipelineConfiguration>;
+        // shader hash, specialization constants, layout, render pass and the fixed function state of the part
+        using PreRasterizationKey = std::tuple<uint64_t, uint32_t, VkPipelineLayout, VkRenderPass, VkCullModeFlags,
+                bool>;
+        using FragmentShaderKey = std::tuple<uint64_t, uint32_t, VkPipelineLayout, VkRenderPass, bool, VkCompareOp,
+                bool>;
+        using FragmentOutputKey = std::tuple<VkRenderPass, bool, VkColorComponentFlags, bool>;
+
+        std::mutex mutex; // guards all members below, and pipelines and statistics
+        std::condition_variable pipelinesCreated;
+        std::unordered_map<PipelineDescription, PipelineData *, PipelineDescription::Hash> pipelinesByDescription;
+        std::unordered_set<PipelineDescription, PipelineDescription::Hash> requestedDescriptions;
+        std::map<PipelineLayoutKey, VkPipelineLayout> pipelineLayouts;
+        std::vector<std::unique_ptr<AsyncPipeline>> asyncPipelines;
+        std::map<AsyncPipelineKey, AsyncPipeline *> asyncPipelinesByKey;
+        std::map<std::pair<uint32_t, uint32_t>, VkPipeline> vertexInputLibraries; // by vertex stride and inputs
+        std::map<PreRasterizationKey, VkPipeline> preRasterizationLibraries;
+        std::map<FragmentShaderKey, VkPipeline> fragmentShaderLibraries;
+        std::map<FragmentOutputKey, VkPipeline> fragmentOutputLibraries;
+        std::vector<std::pair<PipelineData *, VkPipeline>> optimizedPipelines; // waiting to be applied
+        std::unordered_set<PipelineData *> retainedPipelines; // returned by createPipeline, never retired
+        std::map<std::string, std::string> shaderPathReplacements; // reloaded shaders, applied to new requests
+        std::map<std::string, std::string> rejectedShaderPaths; // to the shader that stayed in use
+        // waiting to be applied, with the generation of the asynchronous pipeline they were created for
+        std::vector<std::tuple<AsyncPipeline *, PipelineData *, uint32_t>> reloadedPipelines;
+        uint32_t pendingPipelines = 0;
+        std::atomic<uint64_t> completedPipelines{0};
+        // one for each job that runs concurrently, merged into the main cache when it is saved
+        std::vector<VkPipelineCache> threadCaches;
+        std::vector<VkPipelineCache> freeThreadCaches; // not used by a running job
 
         static VkShaderModule createShaderModule(const std::vector<char> &code);
+        PipelineData &findOrCreatePipeline(const VkRenderPass &renderPass,
+                                           const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                           const std::string &vertexShaderPath, const std::string &fragmentShaderPath,
+                                           const PipelineConfiguration &configuration);
+        // destroyed once the frames in flight have completed
+        static void retirePipeline(VkPipeline pipeline);
+        VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts,
+                                           uint32_t pushConstantsSize, VkShaderStageFlags pushConstantsStages);
+        // on a worker, the job creates its pipelines in a thread cache, avoiding contention on the lock inside the
+        // main cache
+        void runAsync(std::function<void()> &&job);
+        VkPipelineCache acquireThreadCache();
+        void releaseThreadCache(VkPipelineCache threadCache);
+        // the thread cache of the job on this thread, or the main cache
+        [[nodiscard]] VkPipelineCache getPipelineCache() const;
+        // should be called when no jobs are running, destroys the thread caches
+        void mergeThreadCaches();
+        // should be called with the mutex locked
+        [[nodiscard]] std::string getReloadedShaderPath(const std::string &shaderPath) const;
+
+        PFN_vkCmdSetCullModeEXT vkCmdSetCullMode = nullptr;
+        PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnable = nullptr;
+        PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOp = nullptr;
+        PFN_vkCmdSetColorBlendEnableEXT vkCmdSetColorBlendEnable = nullptr;
+        PFN_vkCmdSetColorWriteMaskEXT vkCmdSetColorWriteMask = nullptr;
+
+        // whether the cull mode and depth state (VK_EXT_extended_dynamic_state), and the blend state
+        // (VK_EXT_extended_dynamic_state3) of the configuration are dynamic
+        [[nodiscard]] bool hasDynamicDepthState(const PipelineConfiguration &configuration) const;
+        [[nodiscard]] bool hasDynamicBlendState(const PipelineConfiguration &configuration) const;
+
+        // resets the dynamic state to the defaults, so that pipelines that only differ in dynamic state are equal
+        [[nodiscard]] PipelineConfiguration getStaticConfiguration(const PipelineConfiguration &configuration) const;
+        [[nodiscard]] std::vector<VkDynamicState> getDynamicStates(const PipelineConfiguration &configuration) const;
+
+        VkPipeline createMonolithicPipeline(const PipelineDescription &description,
+                                            const std::vector<char> &vertexShaderCode,
+                                            const std::vector<char> &fragmentShaderCode);
+
+        // vertex input, pre-rasterization, fragment shader and fragment output
+        std::array<VkPipeline, 4> getPipelineLibraries(const PipelineDescription &description,
+                                                       const std::vector<char> &vertexShaderCode,
+                                                       const std::vector<char> &fragmentShaderCode);
+        template<typename Key>
+        VkPipeline getPipelineLibrary(std::map<Key, VkPipeline> &libraries, const Key &key,
+                                      const std::function<VkPipeline()> &create);
+        VkPipeline createPipelineLibrary(VkGraphicsPipelineLibraryFlagsEXT part, VkGraphicsPipelineCreateInfo createInfo);
+        VkPipeline linkPipeline(const std::array<VkPipeline, 4> &libraries, VkPipelineLayout pipelineLayout,
+                                bool optimize);
+        void loadPipelineCache();
+        [[nodiscard]] static bool isPipelineCacheCompatible(const std::vector<char> &data);
     };
 
     extern PipelineBuilder *pipelineBuilder;
@@ -67,15 +328,63 @@ namespace engine::renderer {
     class Shader {
 
     public:
-        explicit Shader(const std::string &vertexShaderPath, const std::string &fragmentShaderPath, VkRenderPass renderPass);
+        // the descriptor set layouts, push constants and parameters are reflected from the SPIR-V of the modules,
+        // throws when the modules declare resources that the engine does not provide
+        explicit Shader(const std::string &vertexShaderPath, const std::string &fragmentShaderPath, VkRenderPass renderPass,
+                        uint32_t specializationConstants = 0);
 
         ~Shader();
 
-        PipelineData *pipelineData; // (unowned pointer)
+        // layout of the material descriptor set, shared by shaders with the same material bindings
+        // (owned by the descriptor set builder, or by the bindless texture array)
         VkDescriptorSetLayout descriptorSetLayout;
+        // reads its texture from the bindless texture array, declared as an unbounded array in the material set
+        bool bindless;
+
+        // should be disabled when the fragment shader discards fragments, which the depth-only shaders don't
+        bool depthPrepass = true;
+
+        // the MaterialParameters struct declared by the vertex or fragment shader, empty when not declared
+        ReflectedStruct parameters{};
+
+        // copied into the parameters of materials that are created afterwards, zero unless set.
+        // throws when the shader does not declare the parameter with the type of the value
+        void setParameterDefault(const std::string &name, float value);
+        void setParameterDefault(const std::string &name, int32_t value);
+        void setParameterDefault(const std::string &name, uint32_t value);
+        void setParameterDefault(const std::string &name, const glm::vec2 &value);
+        void setParameterDefault(const std::string &name, const glm::vec3 &value);
+        void setParameterDefault(const std::string &name, const glm::vec4 &value);
+        void setParameterDefault(const std::string &name, const glm::mat4 &value);
+
+        // the pipelines are queued for asynchronous creation on first use, double sided disables back face culling
+        AsyncPipeline &getPipeline(RenderQueue queue, bool doubleSided = false);
+
+        // only writes depth, for the depth prepass
+        AsyncPipeline &getDepthOnlyPipeline(bool doubleSided = false);
 
     private:
+        friend class Material; // copies the parameter defaults
+
+        std::string vertexShaderPath;
+        std::string fragmentShaderPath;
         VkRenderPass renderPass;
+        uint32_t specializationConstants;
+        uint32_t pushConstantsSize = 0; // the prefix of MaterialPushConstants that the modules read
+        VkShaderStageFlags pushConstantsStages = 0;
+        std::vector<uint8_t> parameterDefaults; // laid out as the parameters
+
+        void setParameterDefault(const std::string &name, ShaderDataType type, const void *data, size_t size);
+
+        // the frame, material and draw descriptor set layouts
+        [[nodiscard]] std::vector<VkDescriptorSetLayout> getDescriptorSetLayouts() const;
+
+        // the push constants of the color and depth-only pipelines are equal, so that their layouts are compatible
+        [[nodiscard]] PipelineConfiguration getDefaultConfiguration() const;
+
+        // (unowned pointers)
+        std::map<std::pair<RenderQueue, bool>, AsyncPipeline *> pipelines;
+        std::map<bool, AsyncPipeline *> depthOnlyPipelines;
     };
     /*
      * A material contains a reference to a shader and contains the properties such as
@@ -84,16 +393,41 @@ namespace engine::renderer {
     class Material {
 
     public:
-        explicit Material(const Shader &shader, Texture &texture);
+        explicit Material(Shader &shader, Texture &texture, RenderQueue queue = RenderQueue::Opaque,
+                          bool doubleSided = false);
         ~Material();
 
-        const Shader &shader;
+        Shader &shader;
         renderer::Texture &texture;
+        RenderQueue queue;
+        bool doubleSided; // e.g. for foliage, which is seen from both sides
+        AsyncPipeline *pipeline; // pipeline of the shader for the render queue (unowned pointer)
 
+        // the material set, for bindless shaders the global set of the bindless texture array (unowned),
+        // otherwise owned by the material
         VkDescriptorSet descriptorSet;
+        uint32_t textureIndex = 0; // for bindless shaders
+        uint32_t materialIndex = 0; // into the material buffer
+
+        // sets a parameter declared by the shader, parameters are initialized to the defaults of the shader.
+        // throws when the shader does not declare the parameter with the type of the value
+        void setParameter(const std::string &name, float value);
+        void setParameter(const std::string &name, int32_t value);
+        void setParameter(const std::string &name, uint32_t value);
+        void setParameter(const std::string &name, const glm::vec2 &value);
+        void setParameter(const std::string &name, const glm::vec3 &value);
+        void setParameter(const std::string &name, const glm::vec4 &value);
+        void setParameter(const std::string &name, const glm::mat4 &value);
+
+        [[nodiscard]] const std::vector<uint8_t> &getParameters() const;
+        // changes when a parameter changes, so that only changed materials are uploaded
+        [[nodiscard]] uint64_t getParametersVersion() const;
 
     private:
+        std::vector<uint8_t> parameters; // laid out as the MaterialParameters struct of the shader
+        uint64_t parametersVersion; // unique across materials
 
+        void setParameter(const std::string &name, ShaderDataType type, const void *data, size_t size);
     };
 
 
@@ -2,6 +2,7 @@
 #include "mesh.h"
 
 #include <iostream>
+#include <utility>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 
@@ -11,6 +12,17 @@ namespace engine::renderer {
 
     Mesh::Mesh(const std::string &filePath) {
         loadObj(filePath);
+        calculateBounds();
+        createBuffers();
+    }
+
+    Mesh::Mesh(std::vector<VertexAttributes> vertices, std::vector<uint32_t> indices) :
+            vertices(std::move(vertices)), indices(std::move(indices)) {
+        calculateBounds();
+        createBuffers();
+    }
+
+    void Mesh::createBuffers() {
         vertexBuffer = std::make_unique<Buffer>(vertices.size() * sizeof(vertices[0]), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
         indexBuffer = std::make_unique<Buffer>(indices.size() * sizeof(indices[0]), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
         vertexBuffer->update(vertices.data());
@@ -24,6 +36,20 @@ namespace engine::renderer {
 //        std::cout << "destroyed vertex and index buffer" << std::endl;
     }
 
+    void Mesh::calculateBounds() {
+        if (vertices.empty()) {
+            bounds = {};
+            return;
+        }
+
+        bounds.min = vertices[0].position;
+        bounds.max = vertices[0].position;
+        for (const auto &vertex: vertices) {
+            bounds.min = glm::min(bounds.min, vertex.position);
+            bounds.max = glm::max(bounds.max, vertex.position);
+        }
+    }
+
     /*
      * Todo: refactor to use index buffer again
      */
@@ -10,6 +10,7 @@ namespace engine::renderer {
 
     public:
         explicit Mesh(const std::string &filePath);
+        explicit Mesh(std::vector<VertexAttributes> vertices, std::vector<uint32_t> indices);
         ~Mesh();
 
         std::vector<VertexAttributes> vertices{
@@ -22,11 +23,15 @@ namespace engine::renderer {
                 0, 1, 2, 2, 3, 0
         };
 
+        Bounds bounds;
+
         std::unique_ptr<renderer::Buffer> vertexBuffer;
         std::unique_ptr<renderer::Buffer> indexBuffer;
 
     private:
         void loadObj(const std::string &filePath);
+        void calculateBounds();
+        void createBuffers();
     };
 }
 
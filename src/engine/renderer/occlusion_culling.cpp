@@ -0,0 +1,505 @@
+#include "vulkan_context.h"
+#include "occlusion_culling.h"
+#include "descriptor_sets.h"
+#include "material_system.h"
+#include "deletion_queue.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace engine::renderer {
+
+    static uint32_t previousPowerOfTwo(uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    static VkMemoryBarrier memoryBarrier(VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) {
+        return {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = srcAccessMask,
+                .dstAccessMask = dstAccessMask,
+        };
+    }
+
+    OcclusionCuller::OcclusionCuller(const VkFormat &colorFormat, const VkFormat &depthFormat, VkExtent2D depthExtent,
+                                     uint32_t framesInFlight, size_t maxObjectCount) : depthExtent(depthExtent) {
+
+        // late pass continues where the main pass left off
+        RenderPassConfiguration lateRenderPassConfiguration{
+                .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+                .colorInitialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .colorFinalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        };
+        lateRenderPass = std::make_unique<RenderPass>(colorFormat, depthFormat, lateRenderPassConfiguration);
+
+        // samples the depth image and the pyramid, kept when the pyramid is replaced
+        VkSamplerCreateInfo samplerInfo{
+                .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                .magFilter = VK_FILTER_NEAREST,
+                .minFilter = VK_FILTER_NEAREST,
+                .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .minLod = 0,
+                .maxLod = VK_LOD_CLAMP_NONE,
+        };
+        checkResult(vkCreateSampler(context->device, &samplerInfo, nullptr, &sampler));
+
+        // descriptor set layouts
+        std::vector<VkDescriptorSetLayoutBinding> downsampleBindings{
+                {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+                {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        };
+        downsampleDescriptorSetLayout = descriptorSetBuilder->getDescriptorSetLayout(downsampleBindings);
+
+        std::vector<VkDescriptorSetLayoutBinding> cullBindings{
+                {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // objects
+                {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // draw commands
+                {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // visibility
+                {3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // depth pyramid
+                {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // statistics
+        };
+        cullDescriptorSetLayout = descriptorSetBuilder->getDescriptorSetLayout(cullBindings);
+
+        downsamplePipeline = &pipelineBuilder->createComputePipeline({downsampleDescriptorSetLayout},
+                                                                     sizeof(DownsamplePushConstants),
+                                                                     "hi_z_downsample_comp.spv");
+        cullPipeline = &pipelineBuilder->createComputePipeline({cullDescriptorSetLayout},
+                                                               sizeof(CullPushConstants),
+                                                               "occlusion_cull_comp.spv");
+
+        createPyramid();
+
+        frames.resize(framesInFlight);
+        createBuffers(std::max<size_t>(maxObjectCount, 1));
+
+        // timestamps are optional, they're only used for reporting
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(context->physicalDevice, &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        if (context->queueFamiliesData.graphicsQueueFamilyData->properties.timestampValidBits > 0) {
+            VkQueryPoolCreateInfo queryPoolInfo{
+                    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                    .queryCount = framesInFlight * TimestampCount,
+            };
+            checkResult(vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &queryPool));
+        }
+
+        std::cout << "created occlusion culler" << std::endl;
+    }
+
+    OcclusionCuller::~OcclusionCuller() {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(context->device, queryPool, nullptr);
+        }
+
+        vkDestroySampler(context->device, sampler, nullptr);
+        for (auto const &imageView: pyramidLevelImageViews) {
+            vkDestroyImageView(context->device, imageView, nullptr);
+        }
+        vkDestroyImageView(context->device, pyramidImageView, nullptr);
+        vmaDestroyImage(context->allocator, pyramidImage, pyramidAllocation);
+    }
+
+    void OcclusionCuller::resize(VkExtent2D newDepthExtent) {
+        retirePyramid();
+        depthExtent = newDepthExtent;
+        createPyramid();
+    }
+
+    /*
+     * The downsample and cull dispatches of the frames in flight could still use the pyramid and its descriptor sets
+     */
+    void OcclusionCuller::retirePyramid() {
+        std::shared_ptr<DescriptorAllocator> allocator = std::move(downsampleAllocator);
+        deletionQueue->push([image = pyramidImage, allocation = pyramidAllocation, imageView = pyramidImageView,
+                                    levelImageViews = pyramidLevelImageViews, allocator]() mutable {
+            allocator.reset();
+            for (auto const &levelImageView: levelImageViews) {
+                vkDestroyImageView(context->device, levelImageView, nullptr);
+            }
+            vkDestroyImageView(context->device, imageView, nullptr);
+            vmaDestroyImage(context->allocator, image, allocation);
+        });
+        pyramidLevelImageViews.clear();
+        downsampleDescriptorSets.clear();
+    }
+
+    void OcclusionCuller::createPyramid() {
+        // a power of two pyramid makes each level exactly half the size of the previous level
+        pyramidExtent = {
+                .width = previousPowerOfTwo(depthExtent.width),
+                .height = previousPowerOfTwo(depthExtent.height)
+        };
+
+        pyramidLevels = 1;
+        while ((std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevels) > 0) {
+            pyramidLevels++;
+        }
+
+        VkFormat format = VK_FORMAT_R32_SFLOAT;
+        VkImageCreateInfo imageInfo = vk_create::image(format, toExtent3D(pyramidExtent),
+                                                       VK_IMAGE_USAGE_STORAGE_BIT |
+                                                       VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                       VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        imageInfo.mipLevels = pyramidLevels;
+
+        VmaAllocationCreateInfo allocationInfo{
+                .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+                .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        };
+        checkResult(vmaCreateImage(context->allocator, &imageInfo, &allocationInfo,
+                                   &pyramidImage, &pyramidAllocation, nullptr));
+
+        VkImageViewCreateInfo imageViewInfo = vk_create::imageView(pyramidImage, format, VK_IMAGE_ASPECT_COLOR_BIT);
+        imageViewInfo.subresourceRange.levelCount = pyramidLevels;
+        checkResult(vkCreateImageView(context->device, &imageViewInfo, nullptr, &pyramidImageView));
+
+        pyramidLevelImageViews.resize(pyramidLevels);
+        for (uint32_t i = 0; i < pyramidLevels; i++) {
+            VkImageViewCreateInfo levelImageViewInfo = vk_create::imageView(pyramidImage, format,
+                                                                            VK_IMAGE_ASPECT_COLOR_BIT);
+            levelImageViewInfo.subresourceRange.baseMipLevel = i;
+            checkResult(vkCreateImageView(context->device, &levelImageViewInfo, nullptr, &pyramidLevelImageViews[i]));
+        }
+
+        // the pyramid stays in the general layout, and starts out at the far plane so that nothing gets
+        // rejected in the first frame (or the first frame after a resize), which is recorded with the next early cull
+        pyramidCleared = false;
+
+        // downsample descriptor sets of the levels after the first, which read from the previous level.
+        // The first level reads from the depth image, which is written to a transient set each frame
+        downsampleAllocator = std::make_unique<DescriptorAllocator>(pyramidLevels);
+        if (pyramidLevels > 1) {
+            downsampleDescriptorSets = downsampleAllocator->allocate(
+                    downsampleDescriptorSetLayout, descriptorSetBuilder->getBindings(downsampleDescriptorSetLayout),
+                    pyramidLevels - 1);
+        }
+        DescriptorWriter writer;
+        for (uint32_t i = 1; i < pyramidLevels; i++) {
+            writer.writeImage(downsampleDescriptorSets[i - 1], 0, sampler, pyramidLevelImageViews[i - 1],
+                              VK_IMAGE_LAYOUT_GENERAL)
+                    .writeImage(downsampleDescriptorSets[i - 1], 1, VK_NULL_HANDLE, pyramidLevelImageViews[i],
+                                VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        }
+        writer.update();
+
+        std::cout << "created depth pyramid, x: " << pyramidExtent.width << ", y: " << pyramidExtent.height
+                  << ", levels: " << pyramidLevels << std::endl;
+    }
+
+    void OcclusionCuller::recordPyramidClear(const VkCommandBuffer &cmd) {
+        VkImageSubresourceRange range{
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = pyramidLevels,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+        };
+
+        VkImageMemoryBarrier toGeneral{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = pyramidImage,
+                .subresourceRange = range
+        };
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &toGeneral);
+
+        VkClearColorValue farPlane{.float32 = {1.0f, 1.0f, 1.0f, 1.0f}};
+        vkCmdClearColorImage(cmd, pyramidImage, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &range);
+        pyramidCleared = true;
+    }
+
+    void OcclusionCuller::createBuffers(size_t objectCapacity) {
+        capacity = objectCapacity;
+        objectData.resize(capacity);
+
+        // visibility is shared between frames, as the late cull of one frame reads what the early cull wrote
+        visibilityBuffer = std::make_unique<Buffer>(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        for (auto &frame: frames) {
+            frame.objectsBuffer = std::make_unique<Buffer>(capacity * sizeof(ObjectData),
+                                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+            // the first half contains the commands for the main pass, the second half for the late pass
+            frame.drawCommandsBuffer = std::make_unique<Buffer>(2 * capacity * sizeof(VkDrawIndexedIndirectCommand),
+                                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            frame.statisticsBuffer = std::make_unique<Buffer>(sizeof(StatisticsData),
+                                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                              VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+        }
+    }
+
+    void OcclusionCuller::reserve(size_t objectCount) {
+        if (objectCount <= capacity) {
+            return;
+        }
+
+        // the results of the frames in flight are in the old buffers
+        retireBuffers();
+        for (auto &frame: frames) {
+            frame.recordedState = RecordedState::None;
+        }
+        createBuffers(std::max(objectCount, capacity * 2));
+    }
+
+    void OcclusionCuller::retireBuffers() {
+        std::vector<std::shared_ptr<Buffer>> buffers{std::move(visibilityBuffer)};
+        for (auto &frame: frames) {
+            buffers.emplace_back(std::move(frame.objectsBuffer));
+            buffers.emplace_back(std::move(frame.drawCommandsBuffer));
+            buffers.emplace_back(std::move(frame.statisticsBuffer));
+        }
+        deletionQueue->push([buffers = std::move(buffers)]() mutable {
+            buffers.clear();
+        });
+    }
+
+    void OcclusionCuller::readResults(uint32_t frameIndex) {
+        FrameResources &frame = frames[frameIndex];
+        if (frame.recordedState == RecordedState::None) {
+            return;
+        }
+
+        if (frame.recordedState == RecordedState::Culled) {
+            StatisticsData data{};
+            frame.statisticsBuffer->read(&data);
+            statistics.testedObjects = data.testedObjects;
+            statistics.occludedEarly = data.occludedEarly;
+            statistics.occludedLate = data.occludedLate;
+        }
+
+        if (queryPool != VK_NULL_HANDLE) {
+            uint32_t queryCount = frame.recordedState == RecordedState::Culled ? TimestampCount : TimestampMainPass + 1;
+            uint64_t timestamps[TimestampCount];
+            VkResult result = vkGetQueryPoolResults(context->device, queryPool,
+                                                    frameIndex * TimestampCount, queryCount,
+                                                    sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                                    VK_QUERY_RESULT_64_BIT);
+
+            if (result == VK_SUCCESS) {
+                auto milliseconds = [&](Timestamp from, Timestamp to) -> float {
+                    return static_cast<float>(timestamps[to] - timestamps[from]) * timestampPeriod / 1000000.0f;
+                };
+
+                if (frame.recordedState == RecordedState::Culled) {
+                    statistics.cullingTime = milliseconds(TimestampBegin, TimestampEarlyCull) +
+                                             milliseconds(TimestampMainPass, TimestampLateCull);
+                    statistics.drawTime = milliseconds(TimestampEarlyCull, TimestampMainPass) +
+                                          milliseconds(TimestampLateCull, TimestampLatePass);
+                } else {
+                    statistics.unculledDrawTime = milliseconds(TimestampEarlyCull, TimestampMainPass);
+                }
+
+                if (statistics.unculledDrawTime > 0) {
+                    statistics.gpuTimeSaved =
+                            statistics.unculledDrawTime - (statistics.drawTime + statistics.cullingTime);
+                }
+            }
+        }
+
+        frame.recordedState = RecordedState::None;
+    }
+
+    void OcclusionCuller::resetTimestamps(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(cmd, queryPool, frameIndex * TimestampCount, TimestampCount);
+        }
+    }
+
+    void OcclusionCuller::writeTimestamp(const VkCommandBuffer &cmd, uint32_t frameIndex, Timestamp timestamp) {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool,
+                                frameIndex * TimestampCount + timestamp);
+        }
+    }
+
+    void OcclusionCuller::recordEarlyCull(const VkCommandBuffer &cmd, uint32_t frameIndex,
+                                          const std::vector<std::unique_ptr<Object>> &objects,
+                                          const glm::mat4 &currentViewProjection) {
+        assert(objects.size() <= capacity && "reserve should be called before recording the early cull");
+        FrameResources &frame = frames[frameIndex];
+        frame.recordedState = RecordedState::Culled;
+
+        objectCount = static_cast<uint32_t>(objects.size());
+        viewProjection = currentViewProjection;
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            const auto &object = objects[i];
+            ObjectData &data = objectData[i];
+            data.transform = object->getTransform();
+            data.boundsMin = glm::vec4(object->mesh.bounds.min, 1.0f);
+            data.boundsMax = glm::vec4(object->mesh.bounds.max, 1.0f);
+            data.indexCount = static_cast<uint32_t>(object->mesh.indices.size());
+        }
+        frame.objectsBuffer->update(objectData.data());
+
+        // written each frame, so that the set always refers to the current pyramid and buffers, while the sets of
+        // the other frames in flight keep referring to the ones they were recorded with
+        frame.cullDescriptorSet = descriptorSetBuilder->createTransientDescriptorSet(frameIndex,
+                                                                                     cullDescriptorSetLayout);
+        DescriptorWriter()
+                .writeBuffer(frame.cullDescriptorSet, 0, frame.objectsBuffer->buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                .writeBuffer(frame.cullDescriptorSet, 1, frame.drawCommandsBuffer->buffer,
+                             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                .writeBuffer(frame.cullDescriptorSet, 2, visibilityBuffer->buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                .writeImage(frame.cullDescriptorSet, 3, sampler, pyramidImageView, VK_IMAGE_LAYOUT_GENERAL)
+                .writeBuffer(frame.cullDescriptorSet, 4, frame.statisticsBuffer->buffer,
+                             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                .update();
+
+        resetTimestamps(cmd, frameIndex);
+        writeTimestamp(cmd, frameIndex, TimestampBegin);
+
+        if (!pyramidCleared) {
+            recordPyramidClear(cmd);
+        }
+        vkCmdFillBuffer(cmd, frame.statisticsBuffer->buffer, 0, VK_WHOLE_SIZE, 0);
+
+        // wait for the statistics and a new pyramid to be cleared,
+        // and for the previous frame to be done with the pyramid and visibility
+        VkMemoryBarrier beforeCull = memoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &beforeCull, 0, nullptr, 0, nullptr);
+
+        // test against the pyramid of the previous frame, using the view projection it was rendered with
+        CullPushConstants pushConstants{
+                .VP = previousViewProjection,
+                .pyramidSize = glm::vec2(pyramidExtent.width, pyramidExtent.height),
+                .objectCount = objectCount,
+                .phase = 0,
+        };
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->pipelineLayout,
+                                0, 1, &frame.cullDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(cmd, cullPipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                           0, sizeof(pushConstants), &pushConstants);
+        vkCmdDispatch(cmd, (objectCount + 63) / 64, 1, 1);
+
+        writeTimestamp(cmd, frameIndex, TimestampEarlyCull);
+    }
+
+    void OcclusionCuller::recordLateCull(const VkCommandBuffer &cmd, uint32_t frameIndex, VkImageView depthImageView) {
+        FrameResources &frame = frames[frameIndex];
+        writeTimestamp(cmd, frameIndex, TimestampMainPass);
+
+        // the early cull should be done reading the pyramid before it gets overwritten
+        VkMemoryBarrier beforeDownsample = memoryBarrier(0, VK_ACCESS_SHADER_WRITE_BIT);
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &beforeDownsample, 0, nullptr, 0, nullptr);
+
+        // build the pyramid from the depth of the main pass, the depth image is created by the render graph,
+        // so it can be a different image each frame
+        VkDescriptorSet depthDescriptorSet = descriptorSetBuilder->createTransientDescriptorSet(
+                frameIndex, downsampleDescriptorSetLayout);
+        DescriptorWriter()
+                .writeImage(depthDescriptorSet, 0, sampler, depthImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+                .writeImage(depthDescriptorSet, 1, VK_NULL_HANDLE, pyramidLevelImageViews[0],
+                            VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+                .update();
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline->pipeline);
+        VkExtent2D inputExtent = depthExtent;
+        for (uint32_t i = 0; i < pyramidLevels; i++) {
+            VkExtent2D outputExtent{
+                    .width = std::max(pyramidExtent.width >> i, 1u),
+                    .height = std::max(pyramidExtent.height >> i, 1u)
+            };
+
+            DownsamplePushConstants pushConstants{
+                    .inputSize = {inputExtent.width, inputExtent.height},
+                    .outputSize = {outputExtent.width, outputExtent.height},
+            };
+
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline->pipelineLayout,
+                                    0, 1, i == 0 ? &depthDescriptorSet : &downsampleDescriptorSets[i - 1],
+                                    0, nullptr);
+            vkCmdPushConstants(cmd, downsamplePipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                               0, sizeof(pushConstants), &pushConstants);
+            vkCmdDispatch(cmd, (outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+            VkMemoryBarrier levelBarrier = memoryBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+            inputExtent = outputExtent;
+        }
+        previousViewProjection = viewProjection;
+
+        writeTimestamp(cmd, frameIndex, TimestampPyramid);
+
+        // re-test the objects that were rejected by the early cull
+        CullPushConstants pushConstants{
+                .VP = viewProjection,
+                .pyramidSize = glm::vec2(pyramidExtent.width, pyramidExtent.height),
+                .objectCount = objectCount,
+                .phase = 1,
+        };
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->pipelineLayout,
+                                0, 1, &frame.cullDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(cmd, cullPipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                           0, sizeof(pushConstants), &pushConstants);
+        vkCmdDispatch(cmd, (objectCount + 63) / 64, 1, 1);
+
+        writeTimestamp(cmd, frameIndex, TimestampLateCull);
+    }
+
+    void OcclusionCuller::recordEnd(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        writeTimestamp(cmd, frameIndex, TimestampLatePass);
+    }
+
+    void OcclusionCuller::recordUnculledBegin(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        frames[frameIndex].recordedState = RecordedState::Unculled;
+        resetTimestamps(cmd, frameIndex);
+        writeTimestamp(cmd, frameIndex, TimestampBegin);
+        writeTimestamp(cmd, frameIndex, TimestampEarlyCull);
+    }
+
+    void OcclusionCuller::recordUnculledEnd(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        writeTimestamp(cmd, frameIndex, TimestampMainPass);
+    }
+
+    VkBuffer &OcclusionCuller::getDrawCommandsBuffer(uint32_t frameIndex) {
+        return frames[frameIndex].drawCommandsBuffer->buffer;
+    }
+
+    VkDeviceSize OcclusionCuller::getDrawCommandOffset(size_t objectIndex, bool late) const {
+        size_t index = late ? objectCount + objectIndex : objectIndex;
+        return index * sizeof(VkDrawIndexedIndirectCommand);
+    }
+
+    void OcclusionCuller::printStatistics() const {
+        std::cout << "occlusion culling: tested objects: " << statistics.testedObjects
+                  << ", occluded (early): " << statistics.occludedEarly
+                  << ", occluded (late): " << statistics.occludedLate
+                  << ", culling: " << statistics.cullingTime << " ms"
+                  << ", drawing: " << statistics.drawTime << " ms"
+                  << ", drawing without culling: " << statistics.unculledDrawTime << " ms"
+                  << ", gpu time saved: " << statistics.gpuTimeSaved << " ms" << std::endl;
+    }
+}
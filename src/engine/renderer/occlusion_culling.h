@@ -0,0 +1,181 @@
+#ifndef SPHERE_OCCLUSION_CULLING_H
+#define SPHERE_OCCLUSION_CULLING_H
+
+#include "vulkan.h"
+#include "vma.h"
+#include "buffer.h"
+#include "descriptor_sets.h"
+#include "render_pass.h"
+#include "scene.h"
+
+#include <vector>
+
+namespace engine::renderer {
+
+    struct OcclusionCullingStatistics {
+        uint32_t testedObjects;
+        uint32_t occludedEarly; // rejected against the pyramid of the previous frame
+        uint32_t occludedLate; // still rejected after re-testing against the pyramid of the main pass
+
+        // in milliseconds, 0 if the device does not support timestamps
+        float cullingTime; // pyramid build + early and late cull
+        float drawTime; // main pass + late pass
+        float unculledDrawTime; // last measured draw time with occlusion culling disabled
+        float gpuTimeSaved; // unculledDrawTime - (drawTime + cullingTime)
+    };
+
+    /*
+     * Two phase occlusion culling using a hierarchical depth (Hi-Z) pyramid.
+     *
+     * 1. early cull: objects get tested against the pyramid that was built from the depth of the previous frame
+     * 2. main pass: objects that passed the early cull get drawn
+     * 3. the pyramid gets rebuilt from the depth of the main pass using a compute downsample
+     * 4. late cull: objects that were rejected by the early cull get re-tested against the new pyramid
+     * 5. late pass: objects that turned out to be visible after all (e.g. disoccluded this frame) get drawn,
+     *    followed by the visible transparent objects, which don't write depth
+     *
+     * Objects are drawn using vkCmdDrawIndexedIndirect, so that the cull shader can set the instance count to 0 for
+     * occluded objects without reading back any results on the CPU.
+     *
+     * The pyramid stores the farthest depth of each texel it covers, so that an object is only rejected when
+     * its nearest depth is behind everything in the screen space rectangle it covers.
+     */
+    class OcclusionCuller {
+
+    public:
+        // the attachments are in their attachment layouts between the passes, see RenderGraph
+        explicit OcclusionCuller(const VkFormat &colorFormat, const VkFormat &depthFormat, VkExtent2D depthExtent,
+                                 uint32_t framesInFlight, size_t maxObjectCount);
+        ~OcclusionCuller();
+
+        // when disabled, the engine draws all objects directly, which is used to measure the time saved.
+        // Toggled in the occlusion culling window of the editor, and by scene_benchmark
+        bool enabled = true;
+        OcclusionCullingStatistics statistics{};
+
+        // continues rendering into the attachments of the main pass
+        std::unique_ptr<RenderPass> lateRenderPass;
+
+        // grows the buffers when the scene contains more objects than they can hold, at least doubling them.
+        // The old buffers are retired to the deletion queue
+        void reserve(size_t objectCount);
+
+        // replaces the depth pyramid when the depth image is resized, the old pyramid is retired to the deletion queue
+        // so that the frames in flight can still use it
+        void resize(VkExtent2D depthExtent);
+
+        // should be called after waiting for the in flight fence of the given frame
+        void readResults(uint32_t frameIndex);
+
+        // the depth image is read in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL by the late cull, and the draw
+        // commands are written by both culls, the barriers for these are left to the render graph
+        void recordEarlyCull(const VkCommandBuffer &cmd, uint32_t frameIndex,
+                             const std::vector<std::unique_ptr<Object>> &objects,
+                             const glm::mat4 &viewProjection);
+        void recordLateCull(const VkCommandBuffer &cmd, uint32_t frameIndex, VkImageView depthImageView);
+        void recordEnd(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // used for measuring the draw time when occlusion culling is disabled
+        void recordUnculledBegin(const VkCommandBuffer &cmd, uint32_t frameIndex);
+        void recordUnculledEnd(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        VkBuffer &getDrawCommandsBuffer(uint32_t frameIndex);
+        VkDeviceSize getDrawCommandOffset(size_t objectIndex, bool late) const;
+
+        void printStatistics() const;
+
+    private:
+        enum Timestamp : uint32_t {
+            TimestampBegin = 0,
+            TimestampEarlyCull,
+            TimestampMainPass,
+            TimestampPyramid,
+            TimestampLateCull,
+            TimestampLatePass,
+            TimestampCount
+        };
+
+        enum class RecordedState {
+            None,
+            Culled,
+            Unculled
+        };
+
+        struct FrameResources {
+            std::unique_ptr<Buffer> objectsBuffer;
+            std::unique_ptr<Buffer> drawCommandsBuffer;
+            std::unique_ptr<Buffer> statisticsBuffer;
+            VkDescriptorSet cullDescriptorSet; // transient, allocated when the early cull is recorded
+            RecordedState recordedState = RecordedState::None;
+        };
+
+        // layout of the objects buffer in the cull shader
+        struct ObjectData {
+            glm::mat4 transform;
+            glm::vec4 boundsMin;
+            glm::vec4 boundsMax;
+            uint32_t indexCount;
+            uint32_t padding[3];
+        };
+
+        struct StatisticsData {
+            uint32_t testedObjects;
+            uint32_t occludedEarly;
+            uint32_t occludedLate;
+            uint32_t padding;
+        };
+
+        struct DownsamplePushConstants {
+            glm::uvec2 inputSize;
+            glm::uvec2 outputSize;
+        };
+
+        struct CullPushConstants {
+            glm::mat4 VP;
+            glm::vec2 pyramidSize;
+            uint32_t objectCount;
+            uint32_t phase;
+        };
+
+        VkExtent2D depthExtent;
+
+        // depth pyramid
+        VkExtent2D pyramidExtent;
+        uint32_t pyramidLevels;
+        VkImage pyramidImage;
+        VmaAllocation pyramidAllocation;
+        VkImageView pyramidImageView; // all levels, used for culling
+        std::vector<VkImageView> pyramidLevelImageViews; // one per level, used for downsampling
+        bool pyramidCleared = false; // a new pyramid gets cleared when the next early cull is recorded
+        VkSampler sampler;
+
+        VkDescriptorSetLayout downsampleDescriptorSetLayout;
+        VkDescriptorSetLayout cullDescriptorSetLayout;
+        std::unique_ptr<DescriptorAllocator> downsampleAllocator; // replaced together with the pyramid
+        std::vector<VkDescriptorSet> downsampleDescriptorSets; // one per level after the first
+        PipelineData *downsamplePipeline; // (unowned pointer)
+        PipelineData *cullPipeline; // (unowned pointer)
+
+        size_t capacity = 0;
+        std::vector<ObjectData> objectData;
+        std::unique_ptr<Buffer> visibilityBuffer;
+        std::vector<FrameResources> frames;
+
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        float timestampPeriod;
+
+        uint32_t objectCount = 0;
+        glm::mat4 viewProjection{1.0f};
+        glm::mat4 previousViewProjection{1.0f}; // view projection of the depth the pyramid was built from
+
+        void createPyramid();
+        void retirePyramid();
+        void recordPyramidClear(const VkCommandBuffer &cmd);
+        void createBuffers(size_t objectCapacity);
+        void retireBuffers();
+        void writeTimestamp(const VkCommandBuffer &cmd, uint32_t frameIndex, Timestamp timestamp);
+        void resetTimestamps(const VkCommandBuffer &cmd, uint32_t frameIndex);
+    };
+}
+
+#endif //SPHERE_OCCLUSION_CULLING_H
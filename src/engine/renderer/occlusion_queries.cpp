@@ -0,0 +1,303 @@
+#include "occlusion_queries.h"
+
+#include "vulkan_context.h"
+#include "material_system.h"
+#include "deletion_queue.h"
+
+#include "glm/gtx/transform.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <memory>
+
+namespace engine::renderer {
+
+    OcclusionQueries::OcclusionQueries(const VkFormat &colorFormat, const VkFormat &depthFormat,
+                                       uint32_t framesInFlight) {
+        mode = context->features.conditionalRendering ? OcclusionQueryMode::ConditionalRendering
+                                                      : OcclusionQueryMode::Latent;
+
+        // extension functions are not exported by the loader, so they have to be retrieved from the device
+        if (mode == OcclusionQueryMode::ConditionalRendering) {
+            vkCmdBeginConditionalRendering = reinterpret_cast<PFN_vkCmdBeginConditionalRenderingEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdBeginConditionalRenderingEXT"));
+            vkCmdEndConditionalRendering = reinterpret_cast<PFN_vkCmdEndConditionalRenderingEXT>(
+                    vkGetDeviceProcAddr(context->device, "vkCmdEndConditionalRenderingEXT"));
+        }
+
+        RenderPassConfiguration renderPassConfiguration{
+                .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+                // the bounding boxes are tested against the depth written by the previous passes, the barriers
+                // between them are recorded by the render graph
+                .colorInitialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .colorFinalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        };
+        renderPass = std::make_unique<RenderPass>(colorFormat, depthFormat, renderPassConfiguration);
+
+        // both faces are drawn, so that the query still passes when the camera looks at the back of the box
+        PipelineConfiguration pipelineConfiguration{
+                .cullMode = VK_CULL_MODE_NONE,
+                .depthWrite = false,
+                .colorWriteMask = 0,
+                .pushConstantsSize = sizeof(glm::mat4),
+        };
+        pipeline = &pipelineBuilder->createPipeline(renderPass->renderPass, {},
+                                                    "occlusion_query_vert.spv", "occlusion_query_frag.spv",
+                                                    pipelineConfiguration);
+
+        // unit cube from 0 to 1, gets transformed to the bounds of each object
+        std::vector<VertexAttributes> vertices(8);
+        for (uint32_t i = 0; i < 8; i++) {
+            vertices[i].position = {static_cast<float>(i & 1), static_cast<float>((i >> 1) & 1),
+                                    static_cast<float>((i >> 2) & 1)};
+        }
+        std::vector<uint32_t> indices{
+                0, 1, 3, 3, 2, 0, // z = 0
+                4, 6, 7, 7, 5, 4, // z = 1
+                0, 4, 5, 5, 1, 0, // y = 0
+                2, 3, 7, 7, 6, 2, // y = 1
+                0, 2, 6, 6, 4, 0, // x = 0
+                1, 5, 7, 7, 3, 1, // x = 1
+        };
+        boxIndexCount = static_cast<uint32_t>(indices.size());
+        boxVertexBuffer = std::make_unique<Buffer>(vertices.size() * sizeof(vertices[0]),
+                                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        boxIndexBuffer = std::make_unique<Buffer>(indices.size() * sizeof(indices[0]),
+                                                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        boxVertexBuffer->update(vertices.data());
+        boxIndexBuffer->update(indices.data());
+
+        frames.resize(framesInFlight);
+
+        std::cout << "created occlusion queries, mode: "
+                  << (mode == OcclusionQueryMode::ConditionalRendering ? "conditional rendering" : "latent")
+                  << std::endl;
+    }
+
+    OcclusionQueries::~OcclusionQueries() {
+        destroyQueryPools();
+    }
+
+    void OcclusionQueries::createQueryPools(size_t queryCapacity) {
+        capacity = queryCapacity;
+        visible.resize(capacity, 1);
+
+        for (auto &frame: frames) {
+            VkQueryPoolCreateInfo queryPoolInfo{
+                    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .queryType = VK_QUERY_TYPE_OCCLUSION,
+                    .queryCount = static_cast<uint32_t>(capacity),
+            };
+            checkResult(vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &frame.queryPool));
+
+            if (mode == OcclusionQueryMode::ConditionalRendering) {
+                frame.predicateBuffer = std::make_unique<Buffer>(capacity * sizeof(uint32_t),
+                                                                 VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT |
+                                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            }
+            frame.recorded = false;
+        }
+    }
+
+    void OcclusionQueries::destroyQueryPools() {
+        for (auto &frame: frames) {
+            if (frame.queryPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(context->device, frame.queryPool, nullptr);
+                frame.queryPool = VK_NULL_HANDLE;
+            }
+            frame.predicateBuffer.reset();
+        }
+    }
+
+    void OcclusionQueries::reserve(size_t objectCount) {
+        if (objectCount <= capacity) {
+            return;
+        }
+
+        retireQueryPools();
+        createQueryPools(std::max(objectCount, capacity * 2));
+    }
+
+    void OcclusionQueries::retireQueryPools() {
+        std::vector<VkQueryPool> queryPools;
+        std::vector<std::shared_ptr<Buffer>> predicateBuffers;
+        for (auto &frame: frames) {
+            queryPools.push_back(frame.queryPool);
+            predicateBuffers.emplace_back(std::move(frame.predicateBuffer));
+            frame.queryPool = VK_NULL_HANDLE;
+        }
+        deletionQueue->push([queryPools, predicateBuffers]() mutable {
+            for (auto const &queryPool: queryPools) {
+                vkDestroyQueryPool(context->device, queryPool, nullptr);
+            }
+            predicateBuffers.clear();
+        });
+    }
+
+    void OcclusionQueries::readResults(uint32_t frameIndex) {
+        FrameResources &frame = frames[frameIndex];
+        if (!frame.recorded || frame.queriedObjects.empty()) {
+            return;
+        }
+
+        // pairs of (samples passed, available)
+        auto queryCount = static_cast<uint32_t>(frame.queriedObjects.size());
+        std::vector<uint32_t> results(queryCount * 2);
+        VkResult result = vkGetQueryPoolResults(context->device, frame.queryPool, 0, queryCount,
+                                                results.size() * sizeof(uint32_t), results.data(),
+                                                2 * sizeof(uint32_t), VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_NOT_READY) {
+            checkResult(result);
+        }
+
+        statistics.queriedObjects = queryCount;
+        statistics.occludedObjects = 0;
+        for (uint32_t i = 0; i < queryCount; i++) {
+            if (results[i * 2 + 1] == 0) {
+                continue;
+            }
+            bool passed = results[i * 2] > 0;
+            if (!passed) {
+                statistics.occludedObjects++;
+            }
+
+            size_t objectIndex = frame.queriedObjects[i];
+            if (objectIndex < visible.size()) {
+                visible[objectIndex] = passed ? 1 : 0;
+            }
+        }
+    }
+
+    void OcclusionQueries::recordReset(const VkCommandBuffer &cmd, uint32_t frameIndex,
+                                       const std::vector<std::unique_ptr<Object>> &objects,
+                                       const glm::mat4 &viewProjection) {
+        assert(objects.size() <= capacity && "reserve should be called before recording the queries");
+        FrameResources &frame = frames[frameIndex];
+        frame.recorded = true;
+        frame.hasObjects = false;
+        frame.queriedObjects.clear();
+        frame.boxTransforms.clear();
+        frame.queryIndices.assign(objects.size(), notQueried);
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            const auto &object = objects[i];
+            if (!object->occlusionQuery) {
+                continue;
+            }
+            frame.hasObjects = true;
+
+            // flat meshes get a minimum thickness, otherwise the box would never pass
+            const Bounds &bounds = object->mesh.bounds;
+            glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(0.001f));
+            glm::mat4 boxTransform = viewProjection * object->getTransform() *
+                                     glm::translate(bounds.min) * glm::scale(size);
+
+            bool intersectsNearPlane = false;
+            for (uint32_t corner = 0; corner < 8; corner++) {
+                glm::vec4 clip = boxTransform * glm::vec4(static_cast<float>(corner & 1),
+                                                          static_cast<float>((corner >> 1) & 1),
+                                                          static_cast<float>((corner >> 2) & 1), 1.0f);
+                if (clip.z < 0.0f || clip.w <= 0.0f) {
+                    intersectsNearPlane = true;
+                    break;
+                }
+            }
+            if (intersectsNearPlane) {
+                visible[i] = 1;
+                continue;
+            }
+
+            frame.queryIndices[i] = static_cast<int32_t>(frame.queriedObjects.size());
+            frame.queriedObjects.push_back(i);
+            frame.boxTransforms.push_back(boxTransform);
+        }
+
+        if (!frame.queriedObjects.empty()) {
+            vkCmdResetQueryPool(cmd, frame.queryPool, 0, static_cast<uint32_t>(frame.queriedObjects.size()));
+        }
+    }
+
+    void OcclusionQueries::recordQueries(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        FrameResources &frame = frames[frameIndex];
+        if (frame.queriedObjects.empty()) {
+            return;
+        }
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+        VkDeviceSize vertexBufferOffset = 0;
+        vkCmdBindVertexBuffers(cmd, 0, 1, &boxVertexBuffer->buffer, &vertexBufferOffset);
+        vkCmdBindIndexBuffer(cmd, boxIndexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+        for (uint32_t i = 0; i < frame.queriedObjects.size(); i++) {
+            vkCmdBeginQuery(cmd, frame.queryPool, i, 0);
+            vkCmdPushConstants(cmd, pipeline->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                               0, sizeof(glm::mat4), &frame.boxTransforms[i]);
+            vkCmdDrawIndexed(cmd, boxIndexCount, 1, 0, 0, 0);
+            vkCmdEndQuery(cmd, frame.queryPool, i);
+        }
+    }
+
+    void OcclusionQueries::recordPredicates(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        FrameResources &frame = frames[frameIndex];
+        if (mode != OcclusionQueryMode::ConditionalRendering || frame.queriedObjects.empty()) {
+            return;
+        }
+
+        // a 32-bit value of 0 discards the draws in the conditional rendering block
+        vkCmdCopyQueryPoolResults(cmd, frame.queryPool, 0, static_cast<uint32_t>(frame.queriedObjects.size()),
+                                  frame.predicateBuffer->buffer, 0, sizeof(uint32_t), VK_QUERY_RESULT_WAIT_BIT);
+
+        VkMemoryBarrier barrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT,
+        };
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT,
+                             0,
+                             1, &barrier,
+                             0, nullptr,
+                             0, nullptr);
+    }
+
+    bool OcclusionQueries::hasObjects(uint32_t frameIndex) const {
+        return frames[frameIndex].hasObjects;
+    }
+
+    bool OcclusionQueries::isVisible(size_t objectIndex) const {
+        return objectIndex >= visible.size() || visible[objectIndex] != 0;
+    }
+
+    void OcclusionQueries::beginConditionalRendering(const VkCommandBuffer &cmd, uint32_t frameIndex,
+                                                     size_t objectIndex) {
+        const FrameResources &frame = frames[frameIndex];
+        int32_t queryIndex = frame.queryIndices[objectIndex];
+        if (queryIndex == notQueried) {
+            return; // drawn unconditionally
+        }
+
+        VkConditionalRenderingBeginInfoEXT beginInfo{
+                .sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT,
+                .buffer = frame.predicateBuffer->buffer,
+                .offset = static_cast<VkDeviceSize>(queryIndex) * sizeof(uint32_t),
+                .flags = 0,
+        };
+        vkCmdBeginConditionalRendering(cmd, &beginInfo);
+    }
+
+    void OcclusionQueries::endConditionalRendering(const VkCommandBuffer &cmd, uint32_t frameIndex,
+                                                   size_t objectIndex) {
+        if (frames[frameIndex].queryIndices[objectIndex] != notQueried) {
+            vkCmdEndConditionalRendering(cmd);
+        }
+    }
+
+    void OcclusionQueries::printStatistics() const {
+        std::cout << "occlusion queries: queried objects: " << statistics.queriedObjects
+                  << ", occluded: " << statistics.occludedObjects << std::endl;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef SPHERE_OCCLUSION_QUERIES_H
+#define SPHERE_OCCLUSION_QUERIES_H
+
+#include "vulkan.h"
+#include "buffer.h"
+#include "render_pass.h"
+#include "scene.h"
+
+#include <vector>
+
+namespace engine::renderer {
+
+    enum class OcclusionQueryMode {
+        // the results are read back on the cpu, and are used to skip draws in the next frame
+        Latent,
+        // the results are copied into a buffer that predicates the draws in the same frame (VK_EXT_conditional_rendering)
+        ConditionalRendering
+    };
+
+    struct OcclusionQueryStatistics {
+        uint32_t queriedObjects;
+        uint32_t occludedObjects; // bounding box had no samples pass the depth test
+    };
+
+    /*
+     * Skips drawing objects with expensive geometry or shaders when their bounding box is hidden.
+     *
+     * Objects with Object::occlusionQuery set are drawn after all other objects, in a render pass that continues
+     * rendering into the attachments of the main pass:
+     *
+     * 1. the bounding box of each object is drawn with an occlusion query, without writing depth or color
+     * 2. Latent: objects are drawn if their query from a previous frame passed
+     *    ConditionalRendering: the query results are copied into the predicate buffer, and each object is drawn
+     *    inside a conditional rendering block in a second render pass
+     *
+     * Objects whose bounding box intersects the near plane are always drawn, as the clipped box could be occluded
+     * while the object itself is not.
+     */
+    class OcclusionQueries {
+
+    public:
+        // the query pass continues rendering into the attachments of the main pass, in their attachment layouts
+        explicit OcclusionQueries(const VkFormat &colorFormat, const VkFormat &depthFormat, uint32_t framesInFlight);
+        ~OcclusionQueries();
+
+        // falls back to Latent if conditional rendering is not supported
+        OcclusionQueryMode mode;
+        OcclusionQueryStatistics statistics{};
+
+        // continues rendering into the attachments of the main pass
+        std::unique_ptr<RenderPass> renderPass;
+
+        // grows the query pools when the scene contains more objects than they can hold, at least doubling them.
+        // The old query pools are retired to the deletion queue
+        void reserve(size_t objectCount);
+
+        // should only be called when the commands of the given frame have completed
+        void readResults(uint32_t frameIndex);
+
+        // determines which objects get queried this frame and resets their queries, outside a render pass
+        void recordReset(const VkCommandBuffer &cmd, uint32_t frameIndex,
+                         const std::vector<std::unique_ptr<Object>> &objects,
+                         const glm::mat4 &viewProjection);
+
+        // draws the bounding boxes, inside a render pass
+        void recordQueries(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // ConditionalRendering: copies the query results into the predicate buffer, outside a render pass
+        void recordPredicates(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // whether any objects should be drawn using occlusion queries this frame
+        [[nodiscard]] bool hasObjects(uint32_t frameIndex) const;
+
+        // Latent: whether the object should be drawn this frame
+        [[nodiscard]] bool isVisible(size_t objectIndex) const;
+
+        // ConditionalRendering: draws between begin and end are discarded when the bounding box was occluded
+        void beginConditionalRendering(const VkCommandBuffer &cmd, uint32_t frameIndex, size_t objectIndex);
+        void endConditionalRendering(const VkCommandBuffer &cmd, uint32_t frameIndex, size_t objectIndex);
+
+        void printStatistics() const;
+
+    private:
+        static constexpr int32_t notQueried = -1;
+
+        struct FrameResources {
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            std::unique_ptr<Buffer> predicateBuffer; // one uint32_t per query
+            std::vector<size_t> queriedObjects; // object index for each query
+            std::vector<glm::mat4> boxTransforms; // from the unit cube to the bounds in clip space, for each query
+            std::vector<int32_t> queryIndices; // query index for each object, or notQueried
+            bool hasObjects = false; // whether any object has Object::occlusionQuery set
+            bool recorded = false;
+        };
+
+        PipelineData *pipeline; // (unowned pointer)
+        std::unique_ptr<Buffer> boxVertexBuffer;
+        std::unique_ptr<Buffer> boxIndexBuffer;
+        uint32_t boxIndexCount;
+
+        PFN_vkCmdBeginConditionalRenderingEXT vkCmdBeginConditionalRendering = nullptr;
+        PFN_vkCmdEndConditionalRenderingEXT vkCmdEndConditionalRendering = nullptr;
+
+        size_t capacity = 0;
+        std::vector<uint8_t> visible; // Latent: last known result for each object
+        std::vector<FrameResources> frames;
+
+        void createQueryPools(size_t queryCapacity);
+        void destroyQueryPools();
+        void retireQueryPools();
+    };
+}
+
+#endif //SPHERE_OCCLUSION_QUERIES_H
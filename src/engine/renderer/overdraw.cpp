@@ -0,0 +1,79 @@
+#include "overdraw.h"
+
+#include "vulkan_context.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace engine::renderer {
+
+    OverdrawCounter::OverdrawCounter(uint32_t framesInFlight) {
+        assert(context->features.occlusionQueryPrecise && "overdraw counting requires precise occlusion queries");
+
+        frames.resize(framesInFlight);
+        for (auto &frame: frames) {
+            VkQueryPoolCreateInfo queryPoolInfo{
+                    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .queryType = VK_QUERY_TYPE_OCCLUSION,
+                    .queryCount = maxPasses,
+            };
+            checkResult(vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &frame.queryPool));
+        }
+
+        std::cout << "created overdraw counter" << std::endl;
+    }
+
+    OverdrawCounter::~OverdrawCounter() {
+        for (auto &frame: frames) {
+            vkDestroyQueryPool(context->device, frame.queryPool, nullptr);
+        }
+    }
+
+    void OverdrawCounter::recordReset(const VkCommandBuffer &cmd, uint32_t frameIndex, const VkExtent2D &extent) {
+        FrameResources &frame = frames[frameIndex];
+        frame.recorded = true;
+        frame.usedPasses = 0;
+        frame.pixels = static_cast<uint64_t>(extent.width) * extent.height;
+        vkCmdResetQueryPool(cmd, frame.queryPool, 0, maxPasses);
+    }
+
+    void OverdrawCounter::begin(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t pass) {
+        assert(pass < maxPasses);
+        FrameResources &frame = frames[frameIndex];
+        frame.usedPasses |= 1u << pass;
+        // without the precise bit, the result is only guaranteed to be non-zero when any sample passed
+        vkCmdBeginQuery(cmd, frame.queryPool, pass, VK_QUERY_CONTROL_PRECISE_BIT);
+    }
+
+    void OverdrawCounter::end(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t pass) {
+        vkCmdEndQuery(cmd, frames[frameIndex].queryPool, pass);
+    }
+
+    void OverdrawCounter::readResults(uint32_t frameIndex) {
+        FrameResources &frame = frames[frameIndex];
+        if (!frame.recorded || frame.usedPasses == 0 || frame.pixels == 0) {
+            return;
+        }
+
+        uint64_t samplesPassed = 0;
+        for (uint32_t pass = 0; pass < maxPasses; pass++) {
+            if ((frame.usedPasses & (1u << pass)) == 0) {
+                continue;
+            }
+            uint64_t result = 0;
+            checkResult(vkGetQueryPoolResults(context->device, frame.queryPool, pass, 1, sizeof(result), &result,
+                                              sizeof(result), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+            samplesPassed += result;
+        }
+
+        statistics.samplesPassed = samplesPassed;
+        statistics.pixels = frame.pixels;
+        statistics.overdraw = static_cast<float>(samplesPassed) / static_cast<float>(frame.pixels);
+    }
+
+    void OverdrawCounter::printStatistics() const {
+        std::cout << "overdraw: " << statistics.overdraw
+                  << " (samples passed: " << statistics.samplesPassed
+                  << ", pixels: " << statistics.pixels << ")" << std::endl;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef SPHERE_OVERDRAW_H
+#define SPHERE_OVERDRAW_H
+
+#include "vulkan.h"
+
+#include <vector>
+
+namespace engine::renderer {
+
+    struct OverdrawStatistics {
+        uint64_t samplesPassed; // samples that passed the depth test in the counted passes
+        uint64_t pixels;
+        float overdraw; // samples passed per pixel, 1.0 means each pixel was shaded once
+    };
+
+    /*
+     * Measures overdraw by wrapping the color draws of the main passes in precise occlusion queries.
+     * Requires the occlusionQueryPrecise device feature.
+     *
+     * The depth prepass is not counted, as it does not run the material fragment shaders.
+     * Occlusion queries can't be nested, so the counted draws can't contain other occlusion queries.
+     */
+    class OverdrawCounter {
+
+    public:
+        explicit OverdrawCounter(uint32_t framesInFlight);
+        ~OverdrawCounter();
+
+        // the main pass, and the late pass of the Hi-Z occlusion culler
+        static constexpr uint32_t maxPasses = 2;
+
+        // of the last frame that was read
+        OverdrawStatistics statistics{};
+
+        // outside a render pass
+        void recordReset(const VkCommandBuffer &cmd, uint32_t frameIndex, const VkExtent2D &extent);
+
+        // inside a render pass, begin and end should be called in the same subpass
+        void begin(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t pass);
+        void end(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t pass);
+
+        // should only be called when the commands of the given frame have completed
+        void readResults(uint32_t frameIndex);
+
+        void printStatistics() const;
+
+    private:
+        struct FrameResources {
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            uint32_t usedPasses = 0; // bit mask
+            uint64_t pixels = 0;
+            bool recorded = false;
+        };
+
+        std::vector<FrameResources> frames;
+    };
+}
+
+#endif //SPHERE_OVERDRAW_H
@@ -0,0 +1,131 @@
+#include "pipeline_statistics.h"
+
+#include "vulkan_context.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace engine::renderer {
+
+    // the results of a query are written in the order of the bits
+    constexpr VkQueryPipelineStatisticFlags graphicsStatisticFlags =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    PipelineStatisticsQueries::PipelineStatisticsQueries(uint32_t framesInFlight) {
+        assert(context->features.pipelineStatisticsQuery && "pipeline statistics require the pipelineStatisticsQuery feature");
+
+        // compute invocations can only be counted when the queue the queries are recorded for supports compute
+        VkQueryPipelineStatisticFlags statisticFlags = graphicsStatisticFlags;
+        statisticCount = 6;
+        VkQueueFlags queueFlags = context->queueFamiliesData.graphicsQueueFamilyData->properties.queueFlags;
+        if (queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            statisticFlags |= VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATION_BIT;
+            statisticCount++;
+        }
+
+        frames.resize(framesInFlight);
+        for (auto &frame: frames) {
+            VkQueryPoolCreateInfo queryPoolInfo{
+                    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                    .queryCount = maxScopes,
+                    .pipelineStatistics = statisticFlags,
+            };
+            checkResult(vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &frame.queryPool));
+        }
+
+        std::cout << "created pipeline statistics queries" << std::endl;
+    }
+
+    PipelineStatisticsQueries::~PipelineStatisticsQueries() {
+        for (auto &frame: frames) {
+            vkDestroyQueryPool(context->device, frame.queryPool, nullptr);
+        }
+    }
+
+    void PipelineStatisticsQueries::recordReset(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        commandBuffers[cmd].clear();
+        vkCmdResetQueryPool(cmd, frames[frameIndex].queryPool, 0, maxScopes);
+    }
+
+    uint32_t PipelineStatisticsQueries::begin(const VkCommandBuffer &cmd, uint32_t frameIndex, const char *name) {
+        std::vector<const char *> &scopes = commandBuffers[cmd];
+        if (scopes.size() == maxScopes) {
+            return UINT32_MAX;
+        }
+        auto query = static_cast<uint32_t>(scopes.size());
+        scopes.push_back(name);
+        vkCmdBeginQuery(cmd, frames[frameIndex].queryPool, query, 0);
+        return query;
+    }
+
+    void PipelineStatisticsQueries::end(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t query) {
+        vkCmdEndQuery(cmd, frames[frameIndex].queryPool, query);
+    }
+
+    void PipelineStatisticsQueries::submitted(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        auto it = commandBuffers.find(cmd);
+        if (it == commandBuffers.end()) {
+            frames[frameIndex].submittedScopes.clear();
+            return;
+        }
+        frames[frameIndex].submittedScopes = it->second;
+    }
+
+    void PipelineStatisticsQueries::forget(const VkCommandBuffer &cmd) {
+        commandBuffers.erase(cmd);
+    }
+
+    void PipelineStatisticsQueries::readResults(uint32_t frameIndex) {
+        FrameResources &frame = frames[frameIndex];
+        if (frame.submittedScopes.empty()) {
+            return;
+        }
+
+        // the scopes are recorded in order, so the used queries are the first ones of the pool.
+        // The fence of the frame has been waited on, so the results are available without waiting
+        auto queryCount = static_cast<uint32_t>(frame.submittedScopes.size());
+        std::vector<uint64_t> values(queryCount * statisticCount);
+        VkResult result = vkGetQueryPoolResults(context->device, frame.queryPool, 0, queryCount,
+                                                values.size() * sizeof(uint64_t), values.data(),
+                                                statisticCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_NOT_READY) {
+            return;
+        }
+        checkResult(result);
+
+        results.resize(queryCount);
+        for (uint32_t i = 0; i < queryCount; i++) {
+            const uint64_t *value = values.data() + i * statisticCount;
+            results[i] = {
+                    .name = frame.submittedScopes[i],
+                    .inputAssemblyVertices = value[0],
+                    .inputAssemblyPrimitives = value[1],
+                    .vertexShaderInvocations = value[2],
+                    .clippingInvocations = value[3],
+                    .clippingPrimitives = value[4],
+                    .fragmentShaderInvocations = value[5],
+                    .computeShaderInvocations = statisticCount > 6 ? value[6] : 0,
+            };
+        }
+        frame.submittedScopes.clear();
+    }
+
+    void PipelineStatisticsQueries::printStatistics() const {
+        for (const auto &statistics: results) {
+            std::cout << "pipeline statistics: " << statistics.name
+                      << ": vertices: " << statistics.inputAssemblyVertices
+                      << ", primitives: " << statistics.inputAssemblyPrimitives
+                      << ", vertex invocations: " << statistics.vertexShaderInvocations
+                      << ", clipping invocations: " << statistics.clippingInvocations
+                      << ", clipping primitives: " << statistics.clippingPrimitives
+                      << ", fragment invocations: " << statistics.fragmentShaderInvocations
+                      << ", compute invocations: " << statistics.computeShaderInvocations << std::endl;
+        }
+    }
+}
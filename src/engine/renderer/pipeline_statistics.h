@@ -0,0 +1,109 @@
+#ifndef SPHERE_PIPELINE_STATISTICS_H
+#define SPHERE_PIPELINE_STATISTICS_H
+
+#include "vulkan.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace engine::renderer {
+
+    // counted by the gpu between the begin and end of a scope
+    struct PipelineStatistics {
+        const char *name; // of the pass or draw bucket
+        uint64_t inputAssemblyVertices;
+        uint64_t inputAssemblyPrimitives;
+        uint64_t vertexShaderInvocations;
+        uint64_t clippingInvocations; // primitives that reached clipping, after culling in the vertex stage
+        uint64_t clippingPrimitives; // primitives that remained after clipping
+        uint64_t fragmentShaderInvocations;
+        uint64_t computeShaderInvocations; // 0 when the graphics queue does not support compute
+    };
+
+    /*
+     * Counts the vertices, primitives and shader invocations of each pass with pipeline statistics queries,
+     * so that the effect of batching and culling changes can be measured. Requires the pipelineStatisticsQuery
+     * device feature.
+     *
+     * Each frame in flight has a query pool, that is read when the frame slot is reused, after its fence has been
+     * waited on, so reading never stalls. The scopes recorded into a command buffer are remembered with it,
+     * so that cached command buffers report their scopes each time they are submitted.
+     *
+     * Queries of the same type can't be nested, so scopes either wrap whole passes, or the draw buckets
+     * (the depth prepass, opaque and transparent objects) within the passes when perDrawBucket is set.
+     */
+    class PipelineStatisticsQueries {
+
+    public:
+        explicit PipelineStatisticsQueries(uint32_t framesInFlight);
+        ~PipelineStatisticsQueries();
+
+        static constexpr uint32_t maxScopes = 16;
+
+        // scopes of draw buckets instead of passes, takes effect when the command buffers are recorded again
+        bool perDrawBucket = false;
+
+        // of the last frame that was read, in the order the scopes were recorded
+        std::vector<PipelineStatistics> results;
+
+        // outside a render pass, after the command buffer was begun
+        void recordReset(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // outside a render pass, or inside one when end is called in the same subpass.
+        // Returns the query of the scope, or UINT32_MAX when the scope is not recorded
+        uint32_t begin(const VkCommandBuffer &cmd, uint32_t frameIndex, const char *name);
+        void end(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t query);
+
+        // the command buffer that was submitted for the frame, so that its scopes are read with the results
+        void submitted(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // should be called before freeing a command buffer, as the handle can be reused by a new command buffer
+        void forget(const VkCommandBuffer &cmd);
+
+        // should only be called when the commands of the given frame have completed
+        void readResults(uint32_t frameIndex);
+
+        void printStatistics() const;
+
+    private:
+        struct FrameResources {
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            std::vector<const char *> submittedScopes; // of the command buffer that was submitted last
+        };
+
+        uint32_t statisticCount; // values per query
+        std::vector<FrameResources> frames;
+        std::unordered_map<VkCommandBuffer, std::vector<const char *>> commandBuffers; // the recorded scopes
+    };
+
+    // a scope of either a pass or a draw bucket, see PipelineStatisticsQueries::perDrawBucket
+    class PipelineStatisticsScope {
+
+    public:
+        PipelineStatisticsScope(PipelineStatisticsQueries *queries, const VkCommandBuffer &cmd, uint32_t frameIndex,
+                                const char *name, bool drawBucket = false) :
+                queries(queries), cmd(cmd), frameIndex(frameIndex) {
+            if (queries != nullptr && queries->perDrawBucket == drawBucket) {
+                query = queries->begin(cmd, frameIndex, name);
+            }
+        }
+
+        ~PipelineStatisticsScope() {
+            if (query != UINT32_MAX) {
+                queries->end(cmd, frameIndex, query);
+            }
+        }
+
+        PipelineStatisticsScope(const PipelineStatisticsScope &) = delete;
+        PipelineStatisticsScope &operator=(const PipelineStatisticsScope &) = delete;
+
+    private:
+        PipelineStatisticsQueries *queries;
+        VkCommandBuffer cmd;
+        uint32_t frameIndex;
+        uint32_t query = UINT32_MAX;
+    };
+}
+
+#endif //SPHERE_PIPELINE_STATISTICS_H
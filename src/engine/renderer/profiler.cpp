@@ -0,0 +1,260 @@
+#include "profiler.h"
+
+#include "vulkan_context.h"
+
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+namespace engine::renderer {
+
+    Profiler *profiler;
+
+    Profiler::Profiler(uint32_t framesInFlight, size_t maxEvents) : epoch(Clock::now()), maxEvents(maxEvents) {
+        assert((profiler == nullptr) && "Only one profiler can exist at one time");
+        profiler = this;
+
+        // timestamps are written on the graphics queue
+        uint32_t validBits = context->queueFamiliesData.graphicsQueueFamilyData->properties.timestampValidBits;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(context->physicalDevice, &properties);
+        timestampsSupported = validBits > 0 && properties.limits.timestampPeriod > 0;
+        timestampPeriod = properties.limits.timestampPeriod;
+        timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t{1} << validBits) - 1;
+
+        if (timestampsSupported) {
+            VkQueryPoolCreateInfo queryPoolInfo{
+                    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                    .queryCount = maxGpuZones * 2,
+            };
+            frames.resize(framesInFlight);
+            for (auto &frame: frames) {
+                checkResult(vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &frame.queryPool));
+            }
+
+            queryPoolInfo.queryCount = 1;
+            checkResult(vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &calibrationQueryPool));
+        }
+
+        std::cout << "created profiler, gpu timestamps: " << (timestampsSupported ? "supported" : "not supported")
+                  << std::endl;
+    }
+
+    Profiler::~Profiler() {
+        for (auto &frame: frames) {
+            vkDestroyQueryPool(context->device, frame.queryPool, nullptr);
+        }
+        if (calibrationQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(context->device, calibrationQueryPool, nullptr);
+        }
+        profiler = nullptr;
+    }
+
+    void Profiler::start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.clear();
+            statistics = {};
+        }
+        // zones submitted before the start are not read
+        for (auto &frame: frames) {
+            frame.submittedZones.clear();
+        }
+        if (timestampsSupported) {
+            calibrate();
+        }
+        enabled = true;
+    }
+
+    void Profiler::stop() {
+        enabled = false;
+    }
+
+    /*
+     * The timestamp is written between the end of the recording and the return of the submit, so the cpu time of
+     * the timestamp is estimated as the middle of the two.
+     */
+    void Profiler::calibrate() {
+        Clock::time_point recorded;
+        context->uploadContext->submit([&](VkCommandBuffer cmd) {
+            vkCmdResetQueryPool(cmd, calibrationQueryPool, 0, 1);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, calibrationQueryPool, 0);
+            recorded = Clock::now();
+        });
+        Clock::time_point completed = Clock::now();
+
+        uint64_t timestamp = 0;
+        checkResult(vkGetQueryPoolResults(context->device, calibrationQueryPool, 0, 1, sizeof(timestamp), &timestamp,
+                                          sizeof(timestamp), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        double cpuTime = static_cast<double>(toNanoseconds(recorded) + toNanoseconds(completed)) / 2.0;
+        gpuOffset = cpuTime - static_cast<double>(timestamp & timestampMask) * timestampPeriod;
+    }
+
+    void Profiler::addCpuEvent(const char *name, Clock::time_point start, Clock::time_point end) {
+        if (!enabled) {
+            return;
+        }
+        addEvent({
+                         .name = name,
+                         .start = toNanoseconds(start),
+                         .duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+                         .thread = getThreadIndex(),
+                 });
+    }
+
+    void Profiler::addEvent(const Event &event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (events.size() >= maxEvents) {
+            statistics.droppedEvents++;
+            return;
+        }
+        events.push_back(event);
+        if (event.thread == UINT32_MAX) {
+            statistics.gpuEvents++;
+        } else {
+            statistics.cpuEvents++;
+        }
+    }
+
+    void Profiler::recordBegin(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        RecordedCommandBuffer &commandBuffer = commandBuffers[cmd];
+        commandBuffer.zones.clear();
+        commandBuffer.queriesReset = timestampsSupported && enabled;
+        if (commandBuffer.queriesReset) {
+            vkCmdResetQueryPool(cmd, frames[frameIndex].queryPool, 0, maxGpuZones * 2);
+        }
+    }
+
+    uint32_t Profiler::beginGpuZone(const VkCommandBuffer &cmd, uint32_t frameIndex, const char *name) {
+        if (!timestampsSupported) {
+            return UINT32_MAX;
+        }
+        auto it = commandBuffers.find(cmd);
+        // the command buffer was begun before the profiler was enabled, so the queries were not reset
+        if (it == commandBuffers.end() || !it->second.queriesReset) {
+            return UINT32_MAX;
+        }
+        std::vector<GpuZone> &zones = it->second.zones;
+        if (zones.size() == maxGpuZones) {
+            std::lock_guard<std::mutex> lock(mutex);
+            statistics.droppedEvents++;
+            return UINT32_MAX;
+        }
+
+        auto query = static_cast<uint32_t>(zones.size()) * 2;
+        zones.push_back({name, query});
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frames[frameIndex].queryPool, query);
+        return query;
+    }
+
+    void Profiler::endGpuZone(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t query) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[frameIndex].queryPool, query + 1);
+    }
+
+    void Profiler::submitted(const VkCommandBuffer &cmd, uint32_t frameIndex) {
+        if (!timestampsSupported) {
+            return;
+        }
+        auto it = commandBuffers.find(cmd);
+        if (!enabled || it == commandBuffers.end()) {
+            frames[frameIndex].submittedZones.clear();
+            return;
+        }
+        frames[frameIndex].submittedZones = it->second.zones;
+    }
+
+    void Profiler::forget(const VkCommandBuffer &cmd) {
+        commandBuffers.erase(cmd);
+    }
+
+    void Profiler::readResults(uint32_t frameIndex) {
+        if (!timestampsSupported) {
+            return;
+        }
+        FrameResources &frame = frames[frameIndex];
+        if (frame.submittedZones.empty()) {
+            return;
+        }
+
+        // the zones are recorded in order, so the used queries are the first ones of the pool
+        auto queryCount = static_cast<uint32_t>(frame.submittedZones.size()) * 2;
+        std::vector<uint64_t> timestamps(queryCount);
+        checkResult(vkGetQueryPoolResults(context->device, frame.queryPool, 0, queryCount,
+                                          timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+        for (const auto &zone: frame.submittedZones) {
+            uint64_t begin = timestamps[zone.query] & timestampMask;
+            uint64_t end = timestamps[zone.query + 1] & timestampMask;
+            if (end < begin) {
+                continue; // the counter wrapped around
+            }
+            addEvent({
+                             .name = zone.name,
+                             .start = static_cast<int64_t>(static_cast<double>(begin) * timestampPeriod + gpuOffset),
+                             .duration = static_cast<int64_t>(static_cast<double>(end - begin) * timestampPeriod),
+                             .thread = UINT32_MAX,
+                     });
+        }
+        frame.submittedZones.clear();
+    }
+
+    /*
+     * The complete events ("X") are in microseconds. The gpu is given its own process, so that it is shown
+     * as a separate row below the cpu threads.
+     */
+    void Profiler::writeTrace(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file) {
+            throw std::runtime_error("could not write trace: " + path);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << R"({"name":"process_name","ph":"M","pid":0,"args":{"name":"cpu"}},)" << "\n";
+        file << R"({"name":"process_name","ph":"M","pid":1,"args":{"name":"gpu"}},)" << "\n";
+        file << R"({"name":"thread_name","ph":"M","pid":1,"tid":0,"args":{"name":"graphics queue"}})";
+
+        std::set<uint32_t> threads;
+        for (const auto &event: events) {
+            bool gpu = event.thread == UINT32_MAX;
+            if (!gpu && threads.insert(event.thread).second) {
+                file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << event.thread
+                     << R"(,"args":{"name":")" << (event.thread == 0 ? "main" : "thread " + std::to_string(event.thread))
+                     << "\"}}";
+            }
+            // names are string literals in the source, so they need no escaping
+            file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\""
+                 << ",\"ts\":" << static_cast<double>(event.start) / 1000.0
+                 << ",\"dur\":" << static_cast<double>(event.duration) / 1000.0
+                 << ",\"pid\":" << (gpu ? 1 : 0)
+                 << ",\"tid\":" << (gpu ? 0 : event.thread) << "}";
+        }
+        file << "\n]}\n";
+
+        std::cout << "wrote trace with " << events.size() << " events to " << path << std::endl;
+    }
+
+    void Profiler::printStatistics() const {
+        std::cout << "profiler: cpu events: " << statistics.cpuEvents
+                  << ", gpu events: " << statistics.gpuEvents
+                  << ", dropped events: " << statistics.droppedEvents << std::endl;
+    }
+
+    int64_t Profiler::toNanoseconds(Clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+    }
+
+    // small indices instead of thread ids, the first thread that records a zone (the main thread) gets 0
+    uint32_t Profiler::getThreadIndex() {
+        static std::atomic<uint32_t> threadCount{0};
+        thread_local uint32_t threadIndex = threadCount++;
+        return threadIndex;
+    }
+}
@@ -0,0 +1,183 @@
+#ifndef SPHERE_PROFILER_H
+#define SPHERE_PROFILER_H
+
+#include "vulkan.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// scoped zones, the name should be a string literal, as only the pointer is stored.
+// Compiled out when SPHERE_DISABLE_PROFILER is defined, otherwise costs a branch while the profiler is not enabled
+#define SPHERE_PROFILE_CONCAT_(a, b) a##b
+#define SPHERE_PROFILE_CONCAT(a, b) SPHERE_PROFILE_CONCAT_(a, b)
+#ifdef SPHERE_DISABLE_PROFILER
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(cmd, frameIndex, name)
+#else
+#define PROFILE_ZONE(name) engine::renderer::ProfileZone SPHERE_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(cmd, frameIndex, name) \
+    engine::renderer::GpuProfileZone SPHERE_PROFILE_CONCAT(gpuProfileZone, __LINE__)(cmd, frameIndex, name)
+#endif
+
+namespace engine::renderer {
+
+    struct ProfilerStatistics {
+        uint32_t cpuEvents;
+        uint32_t gpuEvents;
+        uint32_t droppedEvents; // after the capacity was reached, or gpu zones after the query pool was full
+    };
+
+    /*
+     * Records scoped cpu zones and gpu timestamps around passes onto one timeline, which can be written as a
+     * Chrome trace (chrome://tracing, or ui.perfetto.dev).
+     *
+     * Each frame in flight has a timestamp query pool. The zones recorded into a command buffer are remembered
+     * with it, so that cached command buffers report their zones each time they are submitted. The results are
+     * read when the frame slot is reused, after its fence has been waited on, so reading never stalls.
+     *
+     * Gpu timestamps are converted to the cpu clock with an offset that is measured by submitting a timestamp
+     * when the profiler is enabled, the clocks can drift apart slightly during long captures.
+     */
+    class Profiler {
+
+    public:
+        explicit Profiler(uint32_t framesInFlight, size_t maxEvents = 1000000);
+        ~Profiler();
+
+        // zones are only recorded while enabled, use start() to enable
+        bool enabled = false;
+        ProfilerStatistics statistics{};
+
+        // clears the recorded events and enables recording
+        void start();
+        void stop();
+
+        void addCpuEvent(const char *name, std::chrono::steady_clock::time_point start,
+                         std::chrono::steady_clock::time_point end);
+
+        // outside a render pass, after the command buffer was begun
+        void recordBegin(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // returns the query of the zone, or UINT32_MAX when the zone is not recorded
+        uint32_t beginGpuZone(const VkCommandBuffer &cmd, uint32_t frameIndex, const char *name);
+        void endGpuZone(const VkCommandBuffer &cmd, uint32_t frameIndex, uint32_t query);
+
+        // the command buffer that was submitted for the frame, so that its zones are read with the results
+        void submitted(const VkCommandBuffer &cmd, uint32_t frameIndex);
+
+        // should be called before freeing a command buffer, as the handle can be reused by a new command buffer
+        void forget(const VkCommandBuffer &cmd);
+
+        // should only be called when the commands of the given frame have completed
+        void readResults(uint32_t frameIndex);
+
+        // Chrome trace event format, cpu threads and the gpu are separate rows
+        void writeTrace(const std::string &path) const;
+
+        void printStatistics() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // 2 timestamps per zone
+        static constexpr uint32_t maxGpuZones = 32;
+
+        struct Event {
+            const char *name;
+            int64_t start; // in nanoseconds since the profiler was created
+            int64_t duration;
+            uint32_t thread; // UINT32_MAX for the gpu
+        };
+
+        struct GpuZone {
+            const char *name;
+            uint32_t query; // of the begin timestamp, the end timestamp follows it
+        };
+
+        struct RecordedCommandBuffer {
+            bool queriesReset = false; // false when recorded while the profiler was not enabled
+            std::vector<GpuZone> zones;
+        };
+
+        struct FrameResources {
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            std::vector<GpuZone> submittedZones; // of the command buffer that was submitted last
+        };
+
+        Clock::time_point epoch;
+        size_t maxEvents;
+        std::vector<Event> events;
+        mutable std::mutex mutex; // zones can end on any thread
+
+        // gpu
+        bool timestampsSupported;
+        double timestampPeriod; // nanoseconds per tick
+        uint64_t timestampMask;
+        double gpuOffset = 0; // added to a timestamp in nanoseconds, to get the time since the epoch
+        VkQueryPool calibrationQueryPool = VK_NULL_HANDLE;
+        std::vector<FrameResources> frames;
+        std::unordered_map<VkCommandBuffer, RecordedCommandBuffer> commandBuffers;
+
+        void calibrate();
+        void addEvent(const Event &event);
+        [[nodiscard]] int64_t toNanoseconds(Clock::time_point time) const;
+        static uint32_t getThreadIndex();
+    };
+
+    extern Profiler *profiler;
+
+    class ProfileZone {
+
+    public:
+        explicit ProfileZone(const char *name) : name(name) {
+            if (profiler != nullptr && profiler->enabled) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ProfileZone() {
+            if (start != std::chrono::steady_clock::time_point{} && profiler != nullptr) {
+                profiler->addCpuEvent(name, start, std::chrono::steady_clock::now());
+            }
+        }
+
+        ProfileZone(const ProfileZone &) = delete;
+        ProfileZone &operator=(const ProfileZone &) = delete;
+
+    private:
+        const char *name;
+        std::chrono::steady_clock::time_point start{};
+    };
+
+    // the begin and end timestamps are written into the same command buffer, outside or inside one render pass
+    class GpuProfileZone {
+
+    public:
+        GpuProfileZone(const VkCommandBuffer &cmd, uint32_t frameIndex, const char *name) :
+                cmd(cmd), frameIndex(frameIndex) {
+            if (profiler != nullptr && profiler->enabled) {
+                query = profiler->beginGpuZone(cmd, frameIndex, name);
+            }
+        }
+
+        ~GpuProfileZone() {
+            if (query != UINT32_MAX && profiler != nullptr) {
+                profiler->endGpuZone(cmd, frameIndex, query);
+            }
+        }
+
+        GpuProfileZone(const GpuProfileZone &) = delete;
+        GpuProfileZone &operator=(const GpuProfileZone &) = delete;
+
+    private:
+        VkCommandBuffer cmd;
+        uint32_t frameIndex;
+        uint32_t query = UINT32_MAX;
+    };
+}
+
+#endif //SPHERE_PROFILER_H
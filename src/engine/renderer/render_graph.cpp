@@ -0,0 +1,661 @@
+#include "render_graph.h"
+
+#include "vulkan_context.h"
+#include "deletion_queue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine::renderer {
+
+    struct UsageInfo {
+        VkPipelineStageFlags stageMask;
+        VkAccessFlags readAccess;
+        VkAccessFlags writeAccess;
+        VkImageLayout layout; // VK_IMAGE_LAYOUT_UNDEFINED for usages that only apply to buffers
+        VkImageUsageFlags imageUsage;
+    };
+
+    static UsageInfo getUsageInfo(ResourceUsage usage) {
+        switch (usage) {
+            case ResourceUsage::ColorAttachment:
+                return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+            case ResourceUsage::DepthAttachment:
+                return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+            case ResourceUsage::SampledFragment:
+                return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT};
+            case ResourceUsage::SampledCompute:
+                return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT};
+            case ResourceUsage::StorageCompute:
+                return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+            case ResourceUsage::IndirectBuffer:
+                return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_UNDEFINED, 0};
+            case ResourceUsage::TransferSource:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+            case ResourceUsage::TransferDestination:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+        }
+        throw std::runtime_error("unknown resource usage");
+    }
+
+    // only writes have to be made available, reads can't conflict with each other
+    constexpr VkAccessFlags writeAccessFlags =
+            VK_ACCESS_SHADER_WRITE_BIT |
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_TRANSFER_WRITE_BIT |
+            VK_ACCESS_HOST_WRITE_BIT |
+            VK_ACCESS_MEMORY_WRITE_BIT;
+
+    static VkImageAspectFlags getAspectMask(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            case VK_FORMAT_S8_UINT:
+                return VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    RenderGraphPass &RenderGraphPass::read(RenderGraphImage image, ResourceUsage usage) {
+        assert(getUsageInfo(usage).readAccess != 0 && "usage can't be read");
+        assert(getUsageInfo(usage).layout != VK_IMAGE_LAYOUT_UNDEFINED && "usage doesn't apply to images");
+        imageAccesses.push_back({image.index, usage, false});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::write(RenderGraphImage image, ResourceUsage usage) {
+        assert(getUsageInfo(usage).writeAccess != 0 && "usage can't be written");
+        imageAccesses.push_back({image.index, usage, true});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::read(RenderGraphBuffer buffer, ResourceUsage usage) {
+        assert(getUsageInfo(usage).readAccess != 0 && "usage can't be read");
+        bufferAccesses.push_back({buffer.index, usage, false});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::write(RenderGraphBuffer buffer, ResourceUsage usage) {
+        assert(getUsageInfo(usage).writeAccess != 0 && "usage can't be written");
+        bufferAccesses.push_back({buffer.index, usage, true});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::sideEffects() {
+        hasSideEffects = true;
+        return *this;
+    }
+
+    bool RenderGraph::TransientImageKey::hasSameImage(const TransientImageKey &other) const {
+        return format == other.format &&
+               extent.width == other.extent.width && extent.height == other.extent.height &&
+               usage == other.usage;
+    }
+
+    bool RenderGraph::TransientImageKey::overlaps(const TransientImageKey &other) const {
+        return firstPass <= other.lastPass && other.firstPass <= lastPass;
+    }
+
+    RenderGraph::RenderGraph() {
+        std::cout << "created render graph" << std::endl;
+    }
+
+    // the device should be idle, so the transient images are destroyed directly
+    RenderGraph::~RenderGraph() {
+        for (auto &transientImage: transientImages) {
+            vkDestroyImageView(context->device, transientImage.imageView, nullptr);
+            vkDestroyImage(context->device, transientImage.image, nullptr);
+        }
+        for (auto &block: memoryBlocks) {
+            vmaFreeMemory(context->allocator, block);
+        }
+    }
+
+    void RenderGraph::reset() {
+        images.clear();
+        buffers.clear();
+        passes.clear();
+        finalBarriers.clear();
+    }
+
+    RenderGraphImage RenderGraph::importImage(const char *name, VkImage image, VkImageAspectFlags aspectMask,
+                                              const ResourceState &initialState,
+                                              const std::optional<ResourceState> &finalState) {
+        images.push_back({
+                                 .name = name,
+                                 .image = image,
+                                 .aspectMask = aspectMask,
+                                 .initialState = initialState,
+                                 .finalState = finalState,
+                         });
+        return {static_cast<uint32_t>(images.size() - 1)};
+    }
+
+    RenderGraphImage RenderGraph::createImage(const char *name, const TransientImageDescription &description) {
+        images.push_back({
+                                 .name = name,
+                                 .aspectMask = getAspectMask(description.format),
+                                 .transient = description,
+                         });
+        return {static_cast<uint32_t>(images.size() - 1)};
+    }
+
+    RenderGraphBuffer RenderGraph::importBuffer(const char *name, VkBuffer buffer, const ResourceState &initialState) {
+        buffers.push_back({
+                                  .name = name,
+                                  .buffer = buffer,
+                                  .initialState = initialState,
+                          });
+        return {static_cast<uint32_t>(buffers.size() - 1)};
+    }
+
+    RenderGraphPass &RenderGraph::addPass(const char *name, std::function<void(const VkCommandBuffer &cmd)> &&record) {
+        RenderGraphPass &pass = passes.emplace_back();
+        pass.name = name;
+        pass.record = std::move(record);
+        return pass;
+    }
+
+    void RenderGraph::compile() {
+        statistics = {
+                .passes = static_cast<uint32_t>(passes.size()),
+        };
+        cullPasses();
+        createTransientImages();
+        computeBarriers();
+    }
+
+    /*
+     * Walks the passes backwards, starting from the images that are used after the frame. A pass is kept when it
+     * has side effects or writes a resource that is needed later. All resources used by a kept pass are needed,
+     * including the ones it writes, as a write can be partial (e.g. attachments that are loaded or depth tested).
+     */
+    void RenderGraph::cullPasses() {
+        std::vector<bool> neededImages(images.size());
+        std::vector<bool> neededBuffers(buffers.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            neededImages[i] = images[i].finalState.has_value();
+        }
+
+        for (auto it = passes.rbegin(); it != passes.rend(); it++) {
+            RenderGraphPass &pass = *it;
+            bool needed = pass.hasSideEffects;
+            for (const auto &access: pass.imageAccesses) {
+                needed |= access.write && neededImages[access.resource];
+            }
+            for (const auto &access: pass.bufferAccesses) {
+                needed |= access.write && neededBuffers[access.resource];
+            }
+
+            pass.culled = !needed;
+            if (pass.culled) {
+                statistics.culledPasses++;
+                continue;
+            }
+            for (const auto &access: pass.imageAccesses) {
+                neededImages[access.resource] = true;
+            }
+            for (const auto &access: pass.bufferAccesses) {
+                neededBuffers[access.resource] = true;
+            }
+        }
+    }
+
+    /*
+     * The usage and lifetime of the transient images follow from the kept passes. Images are placed in the
+     * largest first, each into the first block with a compatible memory type that none of the images in the block
+     * overlap with in lifetime. A block is as large as its largest image.
+     */
+    void RenderGraph::createTransientImages() {
+        std::vector<TransientImageKey> keys;
+        std::vector<uint32_t> keyImages; // the image resource of each key
+        std::vector<uint32_t> imageKeys(images.size(), UINT32_MAX);
+        for (uint32_t passIndex = 0; passIndex < passes.size(); passIndex++) {
+            const RenderGraphPass &pass = passes[passIndex];
+            if (pass.culled) {
+                continue;
+            }
+            for (const auto &access: pass.imageAccesses) {
+                ImageResource &image = images[access.resource];
+                if (!image.transient) {
+                    continue;
+                }
+                if (imageKeys[access.resource] == UINT32_MAX) {
+                    imageKeys[access.resource] = static_cast<uint32_t>(keys.size());
+                    keyImages.push_back(access.resource);
+                    keys.push_back({
+                                           .format = image.transient->format,
+                                           .extent = image.transient->extent,
+                                           .usage = 0,
+                                           .firstPass = passIndex,
+                                   });
+                }
+                TransientImageKey &key = keys[imageKeys[access.resource]];
+                key.usage |= getUsageInfo(access.usage).imageUsage;
+                key.lastPass = passIndex;
+            }
+        }
+
+        // a pass that is only added in some frames (e.g. for queries) changes the lifetimes, which only requires
+        // new images when images that share a block would now overlap
+        bool matches = keys.size() == transientImages.size();
+        for (size_t i = 0; matches && i < keys.size(); i++) {
+            matches = keys[i].hasSameImage(transientImages[i].key);
+            for (size_t j = 0; matches && j < i; j++) {
+                matches = transientImages[i].block != transientImages[j].block || !keys[i].overlaps(keys[j]);
+            }
+        }
+        if (matches) {
+            for (size_t i = 0; i < keys.size(); i++) {
+                transientImages[i].key = keys[i];
+            }
+        }
+
+        if (!matches) {
+            retireTransientImages();
+
+            transientImages.resize(keys.size());
+            std::vector<VkMemoryRequirements> requirements(keys.size());
+            for (size_t i = 0; i < keys.size(); i++) {
+                TransientImage &transientImage = transientImages[i];
+                transientImage.key = keys[i];
+                VkImageCreateInfo imageInfo = vk_create::image(keys[i].format, toExtent3D(keys[i].extent),
+                                                               keys[i].usage);
+                checkResult(vkCreateImage(context->device, &imageInfo, nullptr, &transientImage.image));
+                vkGetImageMemoryRequirements(context->device, transientImage.image, &requirements[i]);
+                transientImage.size = requirements[i].size;
+            }
+
+            std::vector<uint32_t> order(keys.size());
+            for (uint32_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return requirements[a].size > requirements[b].size;
+            });
+
+            std::vector<VkMemoryRequirements> blockRequirements;
+            std::vector<std::vector<uint32_t>> blockImages;
+            for (uint32_t i: order) {
+                const TransientImageKey &key = keys[i];
+                uint32_t block = 0;
+                for (; block < blockRequirements.size(); block++) {
+                    if ((blockRequirements[block].memoryTypeBits & requirements[i].memoryTypeBits) == 0) {
+                        continue;
+                    }
+                    bool overlaps = std::any_of(blockImages[block].begin(), blockImages[block].end(), [&](uint32_t j) {
+                        return key.overlaps(keys[j]);
+                    });
+                    if (!overlaps) {
+                        break;
+                    }
+                }
+                if (block == blockRequirements.size()) {
+                    blockRequirements.push_back(requirements[i]);
+                    blockImages.emplace_back();
+                } else {
+                    VkMemoryRequirements &blockRequirement = blockRequirements[block];
+                    blockRequirement.size = std::max(blockRequirement.size, requirements[i].size);
+                    blockRequirement.alignment = std::max(blockRequirement.alignment, requirements[i].alignment);
+                    blockRequirement.memoryTypeBits &= requirements[i].memoryTypeBits;
+                }
+                blockImages[block].push_back(i);
+                transientImages[i].block = block;
+            }
+
+            VmaAllocationCreateInfo allocationInfo{
+                    .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+            };
+            memoryBlocks.resize(blockRequirements.size());
+            for (size_t block = 0; block < blockRequirements.size(); block++) {
+                checkResult(vmaAllocateMemory(context->allocator, &blockRequirements[block], &allocationInfo,
+                                              &memoryBlocks[block], nullptr));
+            }
+
+            for (size_t i = 0; i < keys.size(); i++) {
+                TransientImage &transientImage = transientImages[i];
+                checkResult(vmaBindImageMemory(context->allocator, memoryBlocks[transientImage.block],
+                                               transientImage.image));
+                // a view that is sampled can only have the depth aspect
+                VkImageAspectFlags aspectMask = images[keyImages[i]].aspectMask;
+                if (aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) {
+                    aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+                }
+                VkImageViewCreateInfo viewInfo = vk_create::imageView(transientImage.image, keys[i].format,
+                                                                      aspectMask);
+                checkResult(vkCreateImageView(context->device, &viewInfo, nullptr, &transientImage.imageView));
+            }
+        }
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            ImageResource &image = images[keyImages[i]];
+            image.image = transientImages[i].image;
+            image.transientIndex = static_cast<uint32_t>(i);
+            statistics.unaliasedTransientMemory += transientImages[i].size;
+        }
+        for (const auto &block: memoryBlocks) {
+            VmaAllocationInfo info;
+            vmaGetAllocationInfo(context->allocator, block, &info);
+            statistics.transientMemory += info.size;
+        }
+        statistics.transientImages = static_cast<uint32_t>(transientImages.size());
+    }
+
+    // the commands of frames in flight could still use the transient images
+    void RenderGraph::retireTransientImages() {
+        if (transientImages.empty()) {
+            return;
+        }
+        deletionQueue->push([oldTransientImages = transientImages, oldMemoryBlocks = memoryBlocks]() {
+            for (auto const &transientImage: oldTransientImages) {
+                vkDestroyImageView(context->device, transientImage.imageView, nullptr);
+                vkDestroyImage(context->device, transientImage.image, nullptr);
+            }
+            for (auto const &block: oldMemoryBlocks) {
+                vmaFreeMemory(context->allocator, block);
+            }
+        });
+        transientImages.clear();
+        memoryBlocks.clear();
+    }
+
+    /*
+     * Replays the accesses of the kept passes on the tracked state of each resource. A transient image starts out
+     * undefined, and waits for whatever used its memory before: the previous image in its block within the frame,
+     * or for the first image in a block, all users of the block in the previous frame.
+     */
+    void RenderGraph::computeBarriers() {
+        std::vector<TrackedState> imageStates(images.size());
+        std::vector<TrackedState> bufferStates(buffers.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            const ResourceState &initialState = images[i].initialState;
+            imageStates[i] = {
+                    .layout = initialState.layout,
+                    .writeStages = initialState.stageMask,
+                    .writeAccess = initialState.accessMask,
+            };
+        }
+        for (size_t i = 0; i < buffers.size(); i++) {
+            const ResourceState &initialState = buffers[i].initialState;
+            bufferStates[i] = {
+                    .writeStages = initialState.stageMask,
+                    .writeAccess = initialState.accessMask,
+            };
+        }
+
+        std::vector<VkPipelineStageFlags> blockStages(memoryBlocks.size());
+        std::vector<VkAccessFlags> blockWriteAccess(memoryBlocks.size());
+        for (const auto &pass: passes) {
+            if (pass.culled) {
+                continue;
+            }
+            for (const auto &access: pass.imageAccesses) {
+                uint32_t transientIndex = images[access.resource].transientIndex;
+                if (transientIndex != UINT32_MAX) {
+                    UsageInfo info = getUsageInfo(access.usage);
+                    blockStages[transientImages[transientIndex].block] |= info.stageMask;
+                    blockWriteAccess[transientImages[transientIndex].block] |= info.writeAccess;
+                }
+            }
+        }
+        std::vector<uint32_t> blockOccupants(memoryBlocks.size(), UINT32_MAX); // the image resource using the block
+        for (size_t i = 0; i < images.size(); i++) {
+            uint32_t transientIndex = images[i].transientIndex;
+            if (transientIndex != UINT32_MAX) {
+                uint32_t block = transientImages[transientIndex].block;
+                imageStates[i].writeStages = blockStages[block];
+                imageStates[i].writeAccess = blockWriteAccess[block];
+            }
+        }
+
+        for (auto &pass: passes) {
+            pass.imageBarriers.clear();
+            pass.memoryBarrier.reset();
+            pass.srcStageMask = 0;
+            pass.dstStageMask = 0;
+            if (pass.culled) {
+                continue;
+            }
+
+            // accesses of the same resource within a pass are combined, as a barrier can't be placed between them
+            struct CombinedAccess {
+                uint32_t resource;
+                VkPipelineStageFlags stageMask;
+                VkAccessFlags accessMask;
+                VkImageLayout layout;
+                bool write;
+            };
+            auto combine = [](const std::vector<RenderGraphPass::Access> &accesses) {
+                std::vector<CombinedAccess> combined;
+                for (const auto &access: accesses) {
+                    UsageInfo info = getUsageInfo(access.usage);
+                    VkAccessFlags accessMask = access.write ? info.readAccess | info.writeAccess : info.readAccess;
+                    auto it = std::find_if(combined.begin(), combined.end(), [&](const CombinedAccess &c) {
+                        return c.resource == access.resource;
+                    });
+                    if (it == combined.end()) {
+                        combined.push_back({access.resource, info.stageMask, accessMask, info.layout, access.write});
+                        continue;
+                    }
+                    assert(it->layout == info.layout && "a resource can only be used in one layout within a pass");
+                    it->stageMask |= info.stageMask;
+                    it->accessMask |= accessMask;
+                    it->write |= access.write;
+                }
+                return combined;
+            };
+
+            for (const auto &access: combine(pass.imageAccesses)) {
+                const ImageResource &image = images[access.resource];
+                TrackedState &state = imageStates[access.resource];
+
+                // the first use of a transient image within the frame waits for the previous image in its block
+                if (image.transientIndex != UINT32_MAX) {
+                    uint32_t &occupant = blockOccupants[transientImages[image.transientIndex].block];
+                    if (occupant != access.resource) {
+                        if (occupant != UINT32_MAX) {
+                            const TrackedState &previous = imageStates[occupant];
+                            state.writeStages = previous.writeStages | previous.readStages;
+                            state.writeAccess = previous.writeAccess;
+                        }
+                        occupant = access.resource;
+                    }
+                }
+
+                VkImageLayout oldLayout = state.layout;
+                VkPipelineStageFlags srcStageMask;
+                VkAccessFlags srcAccessMask;
+                if (!getBarrier(state, access.stageMask, access.accessMask, access.layout, access.write,
+                                srcStageMask, srcAccessMask)) {
+                    continue;
+                }
+                pass.imageBarriers.push_back({
+                                                     .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                                     .srcAccessMask = srcAccessMask,
+                                                     .dstAccessMask = access.accessMask,
+                                                     .oldLayout = oldLayout,
+                                                     .newLayout = access.layout,
+                                                     .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                                     .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                                     .image = image.image,
+                                                     .subresourceRange = {
+                                                             .aspectMask = image.aspectMask,
+                                                             .baseMipLevel = 0,
+                                                             .levelCount = VK_REMAINING_MIP_LEVELS,
+                                                             .baseArrayLayer = 0,
+                                                             .layerCount = VK_REMAINING_ARRAY_LAYERS
+                                                     }
+                                             });
+                pass.srcStageMask |= srcStageMask;
+                pass.dstStageMask |= access.stageMask;
+            }
+
+            for (const auto &access: combine(pass.bufferAccesses)) {
+                VkPipelineStageFlags srcStageMask;
+                VkAccessFlags srcAccessMask;
+                if (!getBarrier(bufferStates[access.resource], access.stageMask, access.accessMask,
+                                VK_IMAGE_LAYOUT_UNDEFINED, access.write, srcStageMask, srcAccessMask)) {
+                    continue;
+                }
+                if (!pass.memoryBarrier) {
+                    pass.memoryBarrier = VkMemoryBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+                }
+                pass.memoryBarrier->srcAccessMask |= srcAccessMask;
+                pass.memoryBarrier->dstAccessMask |= access.accessMask;
+                pass.srcStageMask |= srcStageMask;
+                pass.dstStageMask |= access.stageMask;
+            }
+
+            if (!pass.imageBarriers.empty() || pass.memoryBarrier) {
+                statistics.pipelineBarriers++;
+                statistics.imageBarriers += static_cast<uint32_t>(pass.imageBarriers.size());
+                statistics.memoryBarriers += pass.memoryBarrier ? 1 : 0;
+            }
+        }
+
+        finalBarriers.clear();
+        finalSrcStageMask = 0;
+        finalDstStageMask = 0;
+        for (size_t i = 0; i < images.size(); i++) {
+            const ImageResource &image = images[i];
+            if (!image.finalState) {
+                continue;
+            }
+            const TrackedState &state = imageStates[i];
+            VkImageLayout finalLayout = image.finalState->layout == VK_IMAGE_LAYOUT_UNDEFINED
+                                        ? state.layout : image.finalState->layout;
+            if (finalLayout == state.layout && state.writeAccess == 0) {
+                continue;
+            }
+            finalBarriers.push_back({
+                                            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                            .srcAccessMask = state.writeAccess,
+                                            .dstAccessMask = image.finalState->accessMask,
+                                            .oldLayout = state.layout,
+                                            .newLayout = finalLayout,
+                                            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                            .image = image.image,
+                                            .subresourceRange = {
+                                                    .aspectMask = image.aspectMask,
+                                                    .baseMipLevel = 0,
+                                                    .levelCount = VK_REMAINING_MIP_LEVELS,
+                                                    .baseArrayLayer = 0,
+                                                    .layerCount = VK_REMAINING_ARRAY_LAYERS
+                                            }
+                                    });
+            finalSrcStageMask |= state.writeStages | state.readStages;
+            finalDstStageMask |= image.finalState->stageMask;
+        }
+        if (!finalBarriers.empty()) {
+            statistics.pipelineBarriers++;
+            statistics.imageBarriers += static_cast<uint32_t>(finalBarriers.size());
+        }
+    }
+
+    /*
+     * A write, or a layout transition (which reads and writes the whole image), waits for all accesses since the
+     * previous write, and makes that write visible. A read in the same layout only waits for the previous write,
+     * and only when the write has not yet been made visible to its stages and access, so reads don't wait for
+     * each other.
+     */
+    bool RenderGraph::getBarrier(TrackedState &state, VkPipelineStageFlags stageMask, VkAccessFlags accessMask,
+                                 VkImageLayout layout, bool write,
+                                 VkPipelineStageFlags &srcStageMask, VkAccessFlags &srcAccessMask) {
+        bool layoutChange = state.layout != layout;
+        if (layoutChange || write) {
+            srcStageMask = state.writeStages | state.readStages;
+            srcAccessMask = state.writeAccess;
+            state = {
+                    .layout = layout,
+                    .writeStages = stageMask,
+                    .writeAccess = write ? accessMask & writeAccessFlags : 0,
+                    .readStages = write ? 0 : stageMask,
+                    .visibleStages = stageMask,
+                    .visibleAccess = accessMask,
+            };
+            return layoutChange || srcStageMask != 0;
+        }
+
+        srcStageMask = state.writeStages;
+        srcAccessMask = state.writeAccess;
+        state.readStages |= stageMask;
+        bool visible = (state.visibleStages & stageMask) == stageMask &&
+                       (state.visibleAccess & accessMask) == accessMask;
+        if (state.writeStages == 0 || visible) {
+            return false;
+        }
+        state.visibleStages |= stageMask;
+        state.visibleAccess |= accessMask;
+        return true;
+    }
+
+    void RenderGraph::execute(const VkCommandBuffer &cmd) {
+        for (const auto &pass: passes) {
+            if (pass.culled) {
+                continue;
+            }
+            if (!pass.imageBarriers.empty() || pass.memoryBarrier) {
+                // nothing to wait for, only a layout transition or an access to make visible
+                VkPipelineStageFlags srcStageMask = pass.srcStageMask != 0
+                                                    ? pass.srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                vkCmdPipelineBarrier(cmd, srcStageMask, pass.dstStageMask, 0,
+                                     pass.memoryBarrier ? 1 : 0, pass.memoryBarrier ? &*pass.memoryBarrier : nullptr,
+                                     0, nullptr,
+                                     static_cast<uint32_t>(pass.imageBarriers.size()), pass.imageBarriers.data());
+            }
+            if (pass.record) {
+                pass.record(cmd);
+            }
+        }
+
+        if (!finalBarriers.empty()) {
+            vkCmdPipelineBarrier(cmd,
+                                 finalSrcStageMask != 0 ? finalSrcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 finalDstStageMask != 0 ? finalDstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                 0, nullptr, 0, nullptr,
+                                 static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+        }
+    }
+
+    VkImage RenderGraph::getImage(RenderGraphImage image) const {
+        return images[image.index].image;
+    }
+
+    VkImageView RenderGraph::getImageView(RenderGraphImage image) const {
+        uint32_t transientIndex = images[image.index].transientIndex;
+        assert(images[image.index].transient && "image views are only created for transient images");
+        return transientIndex != UINT32_MAX ? transientImages[transientIndex].imageView : VK_NULL_HANDLE;
+    }
+
+    void RenderGraph::printStatistics() const {
+        std::cout << "render graph: passes: " << statistics.passes
+                  << ", culled passes: " << statistics.culledPasses
+                  << ", pipeline barriers: " << statistics.pipelineBarriers
+                  << ", image barriers: " << statistics.imageBarriers
+                  << ", memory barriers: " << statistics.memoryBarriers
+                  << ", transient images: " << statistics.transientImages
+                  << ", transient memory: " << statistics.transientMemory / 1024 << " KiB"
+                  << " (unaliased: " << statistics.unaliasedTransientMemory / 1024 << " KiB)" << std::endl;
+    }
+}
@@ -0,0 +1,209 @@
+#ifndef SPHERE_RENDER_GRAPH_H
+#define SPHERE_RENDER_GRAPH_H
+
+#include "vulkan.h"
+#include "vma.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace engine::renderer {
+
+    // how a pass uses a resource, which determines the pipeline stages, access and image layout it is synchronized with
+    enum class ResourceUsage {
+        ColorAttachment,
+        DepthAttachment,
+        SampledFragment,
+        SampledCompute,
+        StorageCompute, // storage image (in the general layout) or storage buffer
+        IndirectBuffer,
+        TransferSource,
+        TransferDestination,
+    };
+
+    // the state a resource is in before the first pass, or should be left in after the last pass
+    struct ResourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // ignored for buffers
+        VkPipelineStageFlags stageMask = 0; // before: stages the first pass waits for, after: stages that wait
+        VkAccessFlags accessMask = 0; // before: writes that are made available, after: accesses they are visible to
+    };
+
+    // an image that only lives within a frame, created by the graph
+    struct TransientImageDescription {
+        VkFormat format;
+        VkExtent2D extent;
+    };
+
+    struct RenderGraphImage {
+        uint32_t index;
+    };
+
+    struct RenderGraphBuffer {
+        uint32_t index;
+    };
+
+    struct RenderGraphStatistics {
+        uint32_t passes;
+        uint32_t culledPasses;
+        uint32_t pipelineBarriers; // vkCmdPipelineBarrier calls, each combines the barriers before a pass
+        uint32_t imageBarriers;
+        uint32_t memoryBarriers; // for buffers
+        uint32_t transientImages;
+        VkDeviceSize transientMemory; // allocated for the transient images, after aliasing
+        VkDeviceSize unaliasedTransientMemory; // what the transient images would take up without aliasing
+    };
+
+    class RenderGraph;
+
+    class RenderGraphPass {
+
+    public:
+        RenderGraphPass &read(RenderGraphImage image, ResourceUsage usage);
+        RenderGraphPass &write(RenderGraphImage image, ResourceUsage usage);
+        RenderGraphPass &read(RenderGraphBuffer buffer, ResourceUsage usage);
+        RenderGraphPass &write(RenderGraphBuffer buffer, ResourceUsage usage);
+
+        // never culled, for passes with results that are not declared as resources (e.g. queries)
+        RenderGraphPass &sideEffects();
+
+    private:
+        friend class RenderGraph;
+
+        struct Access {
+            uint32_t resource;
+            ResourceUsage usage;
+            bool write;
+        };
+
+        const char *name;
+        std::function<void(const VkCommandBuffer &cmd)> record;
+        std::vector<Access> imageAccesses;
+        std::vector<Access> bufferAccesses;
+        bool hasSideEffects = false;
+
+        // compiled
+        bool culled = false;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        std::optional<VkMemoryBarrier> memoryBarrier; // buffers are synchronized with one global memory barrier
+        VkPipelineStageFlags srcStageMask = 0;
+        VkPipelineStageFlags dstStageMask = 0;
+    };
+
+    /*
+     * The passes of a frame, declared together with the resources they read and write, so that the barriers and
+     * layout transitions between them don't have to be written by hand.
+     *
+     * compile() culls passes whose writes are never read (by a later pass, or after the frame when the resource has
+     * a final state), and computes the barriers: writes are made visible to later accesses, reads that follow
+     * each other in the same layout don't wait for each other, and the barriers before a pass are combined into one
+     * vkCmdPipelineBarrier. execute() records the barriers and passes in the order they were added.
+     *
+     * Transient images get memory from blocks that are shared by images whose lifetimes (from the first to the last
+     * pass that uses them) don't overlap. They are kept between builds of the graph, and only created again when
+     * the transient images change, or their lifetimes change so that images that share memory would overlap.
+     *
+     * Render passes used within a pass should leave their attachments in the layout of their usage
+     * (e.g. VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), so that the layouts known to the graph stay correct.
+     */
+    class RenderGraph {
+
+    public:
+        explicit RenderGraph();
+        ~RenderGraph();
+
+        // of the last compile
+        RenderGraphStatistics statistics{};
+
+        // removes the passes and resources, transient images are reused by the next compile when they match
+        void reset();
+
+        // the final state is applied after the last pass, e.g. for presenting, otherwise the image is left as is
+        RenderGraphImage importImage(const char *name, VkImage image, VkImageAspectFlags aspectMask,
+                                     const ResourceState &initialState,
+                                     const std::optional<ResourceState> &finalState = std::nullopt);
+        RenderGraphImage createImage(const char *name, const TransientImageDescription &description);
+        RenderGraphBuffer importBuffer(const char *name, VkBuffer buffer, const ResourceState &initialState = {});
+
+        // the returned pass is valid until the next pass is added
+        RenderGraphPass &addPass(const char *name, std::function<void(const VkCommandBuffer &cmd)> &&record);
+
+        void compile();
+        void execute(const VkCommandBuffer &cmd);
+
+        // valid after compile, VK_NULL_HANDLE for transient images that are not used by any pass
+        [[nodiscard]] VkImage getImage(RenderGraphImage image) const;
+        [[nodiscard]] VkImageView getImageView(RenderGraphImage image) const;
+
+        void printStatistics() const;
+
+    private:
+        struct ImageResource {
+            const char *name;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageAspectFlags aspectMask;
+            ResourceState initialState;
+            std::optional<ResourceState> finalState;
+            std::optional<TransientImageDescription> transient;
+            uint32_t transientIndex = UINT32_MAX; // into transientImages, when used by a pass
+        };
+
+        struct BufferResource {
+            const char *name;
+            VkBuffer buffer;
+            ResourceState initialState;
+        };
+
+        // the accesses since the last write, see getBarrier
+        struct TrackedState {
+            VkImageLayout layout;
+            VkPipelineStageFlags writeStages;
+            VkAccessFlags writeAccess;
+            VkPipelineStageFlags readStages;
+            VkPipelineStageFlags visibleStages;
+            VkAccessFlags visibleAccess;
+        };
+
+        // what the transient images are created from, and the lifetimes they were placed in memory with
+        struct TransientImageKey {
+            VkFormat format;
+            VkExtent2D extent;
+            VkImageUsageFlags usage;
+            uint32_t firstPass;
+            uint32_t lastPass;
+
+            // format, extent and usage, the lifetime only affects which images can share memory
+            [[nodiscard]] bool hasSameImage(const TransientImageKey &other) const;
+            [[nodiscard]] bool overlaps(const TransientImageKey &other) const;
+        };
+
+        struct TransientImage {
+            TransientImageKey key;
+            VkImage image;
+            VkImageView imageView;
+            VkDeviceSize size;
+            uint32_t block; // into memoryBlocks
+        };
+
+        std::vector<ImageResource> images;
+        std::vector<BufferResource> buffers;
+        std::vector<RenderGraphPass> passes;
+        std::vector<VkImageMemoryBarrier> finalBarriers; // after the last pass, for the final states
+        VkPipelineStageFlags finalSrcStageMask = 0;
+        VkPipelineStageFlags finalDstStageMask = 0;
+
+        std::vector<TransientImage> transientImages;
+        std::vector<VmaAllocation> memoryBlocks;
+
+        void cullPasses();
+        void createTransientImages();
+        void retireTransientImages();
+        void computeBarriers();
+        static bool getBarrier(TrackedState &state, VkPipelineStageFlags stageMask, VkAccessFlags accessMask,
+                               VkImageLayout layout, bool write,
+                               VkPipelineStageFlags &srcStageMask, VkAccessFlags &srcAccessMask);
+    };
+}
+
+#endif //SPHERE_RENDER_GRAPH_H
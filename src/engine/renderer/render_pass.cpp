@@ -5,16 +5,17 @@
 
 namespace engine::renderer {
 
-    RenderPass::RenderPass(const VkFormat &format, const VkFormat &depthFormat) {
+    RenderPass::RenderPass(const VkFormat &format, const VkFormat &depthFormat,
+                           const RenderPassConfiguration &configuration) {
         VkAttachmentDescription colorAttachment{
                 .format = format,
                 .samples = VK_SAMPLE_COUNT_1_BIT, // for multisampling
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .loadOp = configuration.loadOp,
                 .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
                 .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                .initialLayout = configuration.colorInitialLayout,
+                .finalLayout = configuration.colorFinalLayout,
         };
 
         VkAttachmentReference colorAttachmentReference{
@@ -25,12 +26,12 @@ namespace engine::renderer {
         VkAttachmentDescription depthAttachment{
                 .format = depthFormat, // D is for depth, S is for stencil, e.g. VK_FORMAT_D16_UNORM_S8_UINT
                 .samples = VK_SAMPLE_COUNT_1_BIT, // for multisampling
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .loadOp = configuration.loadOp,
                 .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
                 .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
                 .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .initialLayout = configuration.depthInitialLayout,
+                .finalLayout = configuration.depthFinalLayout,
         };
 
         VkAttachmentReference depthAttachmentReference{
@@ -74,6 +75,9 @@ namespace engine::renderer {
                 subpassDependency,
                 depthSubpassDependency
         };
+        dependencies.insert(dependencies.end(),
+                            configuration.additionalDependencies.begin(),
+                            configuration.additionalDependencies.end());
 
         std::vector<VkAttachmentDescription> attachments{
                 colorAttachment,
@@ -3,8 +3,25 @@
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
 namespace engine::renderer {
 
+    /*
+     * Allows creating render passes that continue rendering into the attachments of a previous render pass
+     * (e.g. a second geometry pass), or that leave the depth attachment in a layout that can be sampled afterwards.
+     *
+     * Render passes that only differ in these settings are compatible, so they can share framebuffers and pipelines.
+     */
+    struct RenderPassConfiguration {
+        VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        VkImageLayout colorInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout colorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        VkImageLayout depthInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        std::vector<VkSubpassDependency> additionalDependencies;
+    };
+
     /*
      * A render pass defines a set of image resources (attachments) to be used during rendering.
      *
@@ -16,7 +33,8 @@ namespace engine::renderer {
     class RenderPass {
 
     public:
-        explicit RenderPass(const VkFormat &format, const VkFormat &depthFormat);
+        explicit RenderPass(const VkFormat &format, const VkFormat &depthFormat,
+                            const RenderPassConfiguration &configuration = {});
         ~RenderPass();
 
         VkRenderPass renderPass;
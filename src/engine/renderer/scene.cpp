@@ -1,4 +1,5 @@
 #include "scene.h"
+#include "profiler.h"
 
 #include "glm/mat4x4.hpp"
 #include "glm/gtx/quaternion.hpp"
@@ -7,6 +8,10 @@
 namespace engine::renderer {
 
     Scene::Scene(VkRenderPass renderPass) : renderPass(renderPass) {
+
+    }
+
+    void Scene::loadDemoScene() {
         // load meshes
         std::vector<std::string> meshNames{
                 "/Users/arjonagelhout/Documents/ShapeReality/2023-06-18_bgfx_test/bgfx/examples/assets/meshes/orb.obj",
@@ -50,9 +55,18 @@ namespace engine::renderer {
         };
 
         for (const auto &shaderData: shadersData) {
-            shaders.emplace_back(std::make_unique<Shader>(shaderData.vertexShaderPath, shaderData.fragmentShaderPath, renderPass)); // todo: stupid, remove renderpass argument
+            createShader(shaderData.vertexShaderPath, shaderData.fragmentShaderPath);
         }
 
+        ShaderVariants &standard = createShaderVariants("standard.vert", "standard.frag", {
+                {.name = "TEXTURED"},
+                {.name = "LIT", .type = ShaderKeywordType::SpecializationConstant, .constantId = 0},
+                {.name = "ALPHA_TEST", .discardsFragments = true},
+                {.name = ShaderVariants::bindlessKeyword},
+        });
+        // alpha tested materials discard fragments below half opacity, unless they set their own cutoff
+        standard.getVariant({"TEXTURED", "ALPHA_TEST"}).setParameterDefault("AlphaCutoff", 0.5f);
+
         // create scene with objects
         struct ObjectData {
             std::string name;
@@ -65,19 +79,26 @@ namespace engine::renderer {
         struct MaterialData {
             Shader &shader;
             Texture &texture;
+            RenderQueue queue;
+            bool doubleSided;
         };
 
+        // the leaves texture uses alpha, and leaves are seen from both sides
         std::vector<MaterialData> materialsData{
-                {*shaders[0], {*textures[0]}},
-                {*shaders[1], {*textures[0]}},
-                {*shaders[0], {*textures[1]}},
-                {*shaders[0], {*textures[2]}},
+                {*shaders[0], {*textures[0]}, RenderQueue::Transparent, true},
+                {*shaders[1], {*textures[0]}, RenderQueue::Transparent, true},
+                {*shaders[0], {*textures[1]}, RenderQueue::Opaque, false},
+                {*shaders[0], {*textures[2]}, RenderQueue::Opaque, false},
+                {standard.getVariant({"TEXTURED", "LIT"}), {*textures[1]}, RenderQueue::Opaque, false},
+                {standard.getVariant({"TEXTURED", "ALPHA_TEST"}), {*textures[0]}, RenderQueue::Opaque, true},
         };
 
         for (const auto &materialData: materialsData) {
-            materials.emplace_back(std::make_unique<Material>(materialData.shader, materialData.texture));
+            materials.emplace_back(std::make_unique<Material>(materialData.shader, materialData.texture,
+                                                              materialData.queue, materialData.doubleSided));
             const auto &mat = materials.back();
         }
+        materials[4]->setParameter("Tint", glm::vec4(1.0f, 0.6f, 0.2f, 0.25f));
 
         std::vector<ObjectData> objectsData{
                 {"Wee", {0, 0,  0}, {1,   1,    1},    *meshes[0], *materials[0]},
@@ -96,6 +117,8 @@ namespace engine::renderer {
                 {"Llalalal", {4, 10, 0}, {0.5, 0.25, 0.25}, *meshes[1], *materials[0]},
                 {"MBes", {4, 12, 0}, {0.4, 0.25, 0.25}, *meshes[1], *materials[0]},
                 {"Ke3", {4, 14, 0}, {0.3, 0.25, 0.25}, *meshes[1], *materials[0]},
+                {"Lit", {-8, 0, 0}, {1, 1, 1}, *meshes[0], *materials[4]},
+                {"Cutout", {-8, 2, 0}, {1, 1, 1}, *meshes[0], *materials[5]},
         };
 
         for (const auto &objectData: objectsData) {
@@ -103,12 +126,36 @@ namespace engine::renderer {
             const auto &obj = objects.back();
             obj->localPosition = objectData.position;
             obj->localScale = objectData.scale;
+            // solid objects hide what is behind them, objects that blend or discard fragments don't
+            obj->occluder = objectData.material.queue == RenderQueue::Opaque &&
+                            objectData.material.shader.depthPrepass;
         }
+
+        animate = true;
+        markChanged();
     }
 
     Scene::~Scene() = default;
 
+    Shader &Scene::createShader(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) {
+        shaders.emplace_back(std::make_unique<Shader>(vertexShaderPath, fragmentShaderPath, renderPass)); // todo: stupid, remove renderpass argument
+        return *shaders.back();
+    }
+
+    ShaderVariants &Scene::createShaderVariants(const std::string &vertexSourcePath,
+                                                const std::string &fragmentSourcePath,
+                                                const std::vector<ShaderKeyword> &keywords) {
+        shaderVariants.emplace_back(std::make_unique<ShaderVariants>(vertexSourcePath, fragmentSourcePath, keywords,
+                                                                     renderPass));
+        return *shaderVariants.back();
+    }
+
     void Scene::update() {
+        PROFILE_ZONE("Scene::update");
+        if (!animate) {
+            return;
+        }
+
         // update mesh transforms
         for (size_t i = 0; i < objects.size(); i++) {
             const auto &object = objects[i];
@@ -118,19 +165,52 @@ namespace engine::renderer {
         }
     }
 
-    Object::Object(const std::string &name, Mesh &mesh, Material &material) : name(name), mesh(mesh), material(material) {
+    void Scene::updateTransforms() {
+        PROFILE_ZONE("Scene::updateTransforms");
+        for (const auto &object: objects) {
+            object->updateTransform();
+        }
+    }
+
+    void Scene::markChanged() {
+        version++;
+    }
 
+    uint64_t Scene::getVersion() const {
+        return version;
+    }
+
+    Object::Object(const std::string &name, Mesh &mesh, Material &material) : name(name), mesh(mesh), material(material) {
+        calculateTransform();
     }
 
     Object::~Object() = default;
 
-    glm::mat4x4 Object::getTransform() {
+    const glm::mat4 &Object::getTransform() const {
+        return transform;
+    }
+
+    uint64_t Object::getTransformVersion() const {
+        return transformVersion;
+    }
+
+    void Object::updateTransform() {
+        if (localPosition != transformPosition || localRotation != transformRotation || localScale != transformScale) {
+            calculateTransform();
+        }
+    }
+
+    void Object::calculateTransform() {
         // calculates the transform from the position, rotation and scale
 
         glm::mat4x4 translateMatrix{glm::translate(localPosition)};
         glm::mat4x4 rotateMatrix{glm::toMat4(localRotation)};
         glm::mat4x4 scaleMatrix{glm::scale(localScale)};
 
-        return translateMatrix * rotateMatrix * scaleMatrix;
+        transform = translateMatrix * rotateMatrix * scaleMatrix;
+        transformPosition = localPosition;
+        transformRotation = localRotation;
+        transformScale = localScale;
+        transformVersion++;
     }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "glm/gtx/quaternion.hpp"
 
 #include "material_system.h"
+#include "shader_variants.h"
 #include "texture.h"
 #include "mesh.h"
 
@@ -26,15 +27,33 @@ namespace engine::renderer {
         std::string name;
         Mesh &mesh;
         Material &material; // the shader that is used for rendering this object, todo: should be replaced by Material
+        bool occluder = false; // whether this object gets rendered into the software occlusion depth buffer
+        bool occlusionQuery = false; // only draw when its bounding box passes an occlusion query, for expensive objects
 
         // todo: should be refactored out into Transform component using ECS
         glm::vec3 localPosition{0, 0, 0};
         glm::quat localRotation{0, 0, 0, 1}; // identity quaternion, otherwise multiplication always results in 0
         glm::vec3 localScale{1, 1, 1};
-        glm::mat4 getTransform();
+
+        // calculated from the position, rotation and scale by updateTransform
+        [[nodiscard]] const glm::mat4 &getTransform() const;
+
+        // incremented each time the transform changes, so that copies of the transform can be kept up to date
+        [[nodiscard]] uint64_t getTransformVersion() const;
+
+        // recalculates the transform when the position, rotation or scale changed since the last update
+        void updateTransform();
 
     private:
+        glm::mat4 transform;
+        uint64_t transformVersion = 0;
+
+        // the values the transform was calculated from
+        glm::vec3 transformPosition;
+        glm::quat transformRotation;
+        glm::vec3 transformScale;
 
+        void calculateTransform();
     };
 
     /*
@@ -44,22 +63,43 @@ namespace engine::renderer {
     class Scene {
 
     public:
+        // creates an empty scene
         explicit Scene(VkRenderPass renderPass);
         ~Scene();
 
         std::vector<std::unique_ptr<Object>> objects;
         std::vector<std::unique_ptr<Material>> materials;
+        std::vector<std::unique_ptr<Texture>> textures;
+        std::vector<std::unique_ptr<Mesh>> meshes;
+        std::vector<std::unique_ptr<Shader>> shaders;
+        std::vector<std::unique_ptr<ShaderVariants>> shaderVariants;
+
+        bool animate = false; // rotates the objects each update
+
+        void loadDemoScene();
+
+        Shader &createShader(const std::string &vertexShaderPath, const std::string &fragmentShaderPath);
+
+        // source paths are relative to the shader sources directory, e.g. "standard.vert"
+        ShaderVariants &createShaderVariants(const std::string &vertexSourcePath, const std::string &fragmentSourcePath,
+                                             const std::vector<ShaderKeyword> &keywords);
 
         // todo: refactor out
         void update();
 
+        // should be called after modifying objects, before rendering
+        void updateTransforms();
+
+        // should be called after adding or removing objects, materials, meshes or textures,
+        // so that command buffers that were recorded for the previous structure get re-recorded
+        void markChanged();
+        [[nodiscard]] uint64_t getVersion() const;
+
     private:
         // todo: stupid, refactor engine into editor so that we don't have to pass this into the scene.
         VkRenderPass renderPass;
 
-        std::vector<std::unique_ptr<Texture>> textures;
-        std::vector<std::unique_ptr<Mesh>> meshes;
-        std::vector<std::unique_ptr<Shader>> shaders;
+        uint64_t version = 0;
     };
 }
 
@@ -0,0 +1,253 @@
+#include "shader_compiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace engine::renderer {
+
+    ShaderCompiler *shaderCompiler;
+
+    /*
+     * Resolves #include "file" relative to the including file, and #include <file> relative to the source directory
+     */
+    class Includer : public shaderc::CompileOptions::IncluderInterface {
+
+    public:
+        explicit Includer(std::string sourceDirectory, std::vector<std::string> &dependencies) :
+                sourceDirectory(std::move(sourceDirectory)), dependencies(dependencies) {
+
+        }
+
+        shaderc_include_result *GetInclude(const char *requestedSource, shaderc_include_type type,
+                                           const char *requestingSource, size_t includeDepth) override {
+            std::filesystem::path path = type == shaderc_include_type_relative
+                                         ? std::filesystem::path(requestingSource).parent_path() / requestedSource
+                                         : std::filesystem::path(sourceDirectory) / requestedSource;
+            path = path.lexically_normal();
+
+            auto *include = new Include();
+            std::ifstream file(path);
+            if (file.is_open()) {
+                std::stringstream content;
+                content << file.rdbuf();
+                include->name = path.string();
+                include->content = content.str();
+                dependencies.push_back(include->name);
+            } else {
+                // an empty name signals an error, the content is the error message
+                include->content = "failed to open include: " + path.string();
+            }
+
+            include->result = {
+                    .source_name = include->name.c_str(),
+                    .source_name_length = include->name.size(),
+                    .content = include->content.c_str(),
+                    .content_length = include->content.size(),
+                    .user_data = include,
+            };
+            return &include->result;
+        }
+
+        void ReleaseInclude(shaderc_include_result *data) override {
+            delete static_cast<Include *>(data->user_data);
+        }
+
+    private:
+        struct Include {
+            std::string name;
+            std::string content;
+            shaderc_include_result result;
+        };
+
+        std::string sourceDirectory;
+        std::vector<std::string> &dependencies;
+    };
+
+    ShaderCompiler::ShaderCompiler(std::string sourceDirectory, std::string cacheDirectory) :
+            sourceDirectory(std::move(sourceDirectory)), cacheDirectory(std::move(cacheDirectory)) {
+        assert((shaderCompiler == nullptr) && "Only one shader compiler can exist at one time");
+        shaderCompiler = this;
+    }
+
+    ShaderCompiler::~ShaderCompiler() = default;
+
+    static shaderc_shader_kind getShaderKind(const std::string &sourcePath) {
+        std::string extension = sourcePath.substr(sourcePath.find_last_of('.') + 1);
+        if (extension == "vert") {
+            return shaderc_vertex_shader;
+        } else if (extension == "frag") {
+            return shaderc_fragment_shader;
+        } else if (extension == "comp") {
+            return shaderc_compute_shader;
+        }
+        throw std::runtime_error("unknown shader stage for: " + sourcePath);
+    }
+
+    // FNV-1a, which unlike std::hash is the same between runs and platforms, so that the cache stays valid
+    static uint64_t hashCode(const std::string &data, uint64_t hash = 0xcbf29ce484222325) {
+        for (char c: data) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    static std::map<std::string, std::filesystem::file_time_type> getWriteTimes(const std::vector<std::string> &files) {
+        std::map<std::string, std::filesystem::file_time_type> writeTimes;
+        for (const auto &file: files) {
+            std::error_code error;
+            writeTimes[file] = std::filesystem::last_write_time(file, error);
+        }
+        return writeTimes;
+    }
+
+    void ShaderCompiler::setOptions(shaderc::CompileOptions &options, const std::vector<std::string> &defines,
+                                    std::vector<std::string> &dependencies) const {
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        for (const auto &define: defines) {
+            options.AddMacroDefinition(define);
+        }
+        options.SetIncluder(std::make_unique<Includer>(sourceDirectory, dependencies));
+    }
+
+    std::string ShaderCompiler::readSource(const std::string &sourcePath) const {
+        std::ifstream file(sourceDirectory + sourcePath);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open shader source: " + sourceDirectory + sourcePath);
+        }
+        std::stringstream source;
+        source << file.rdbuf();
+        return source.str();
+    }
+
+    /*
+     * The module is preprocessed first, which resolves the includes and defines, so that the hash of the
+     * preprocessed source identifies the SPIR-V without compiling it.
+     */
+    void ShaderCompiler::compileModule(Module &module) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::string fileName = sourceDirectory + module.sourcePath;
+        std::vector<std::string> dependencies{fileName};
+        shaderc::CompileOptions options;
+        setOptions(options, module.defines, dependencies);
+        shaderc_shader_kind kind = getShaderKind(module.sourcePath);
+        std::string source = readSource(module.sourcePath);
+
+        shaderc::PreprocessedSourceCompilationResult preprocessed = compiler.PreprocessGlsl(source, kind,
+                                                                                             fileName.c_str(),
+                                                                                             options);
+        if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success) {
+            throw std::runtime_error("failed to preprocess shader: " + preprocessed.GetErrorMessage());
+        }
+        uint64_t hash = hashCode(std::string(preprocessed.cbegin(), preprocessed.cend()), hashCode(fileName));
+
+        // input: folder/shader.vert, output: cache/folder_shader_<hash>_vert.spv, like scripts/compile-shaders.sh
+        std::string name = module.sourcePath;
+        std::replace(name.begin(), name.end(), '/', '_');
+        std::string extension = name.substr(name.find_last_of('.') + 1);
+        name = name.substr(0, name.find_last_of('.'));
+        std::stringstream path;
+        path << cacheDirectory << name << "_" << std::hex << hash << "_" << extension << ".spv";
+
+        std::string filePath = "shaders/" + path.str();
+        if (std::filesystem::exists(filePath)) {
+            statistics.cachedModules++;
+        } else {
+            std::vector<std::string> includes; // already collected while preprocessing
+            shaderc::CompileOptions compileOptions;
+            setOptions(compileOptions, module.defines, includes);
+            shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, kind, fileName.c_str(),
+                                                                             compileOptions);
+            if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+                throw std::runtime_error("failed to compile shader: " + result.GetErrorMessage());
+            }
+
+            // written to a temporary file first, so that a crash never leaves a partial module in the cache
+            std::filesystem::create_directories(std::filesystem::path(filePath).parent_path());
+            std::string temporaryPath = filePath + ".tmp";
+            {
+                std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) {
+                    throw std::runtime_error("failed to write shader module: " + temporaryPath);
+                }
+                file.write(reinterpret_cast<const char *>(result.cbegin()),
+                           static_cast<std::streamsize>((result.cend() - result.cbegin()) * sizeof(uint32_t)));
+            }
+            std::filesystem::rename(temporaryPath, filePath);
+
+            statistics.compiledModules++;
+            std::cout << "compiled shader: " << module.sourcePath << " to: " << path.str() << std::endl;
+        }
+
+        module.path = path.str();
+        module.dependencies = getWriteTimes(dependencies);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        statistics.compileTime += std::chrono::duration<float, std::milli>(end - start).count();
+    }
+
+    std::string ShaderCompiler::getModule(const std::string &sourcePath, const std::vector<std::string> &defines) {
+        std::string key = sourcePath;
+        for (const auto &define: defines) {
+            key += ";" + define;
+        }
+
+        auto it = modules.find(key);
+        if (it != modules.end()) {
+            return it->second.path;
+        }
+
+        Module module{
+                .sourcePath = sourcePath,
+                .defines = defines,
+        };
+        compileModule(module);
+        return modules.emplace(key, std::move(module)).first->second.path;
+    }
+
+    std::vector<std::pair<std::string, std::string>> ShaderCompiler::reloadModules() {
+        std::vector<std::pair<std::string, std::string>> reloaded;
+        for (auto &[key, module]: modules) {
+            std::vector<std::string> files;
+            for (const auto &entry: module.dependencies) {
+                files.push_back(entry.first);
+            }
+            std::map<std::string, std::filesystem::file_time_type> writeTimes = getWriteTimes(files);
+            if (writeTimes == module.dependencies) {
+                continue;
+            }
+
+            std::string oldPath = module.path;
+            try {
+                compileModule(module);
+            } catch (const std::exception &e) {
+                std::cout << "failed to reload shader: " << module.sourcePath << ": " << e.what() << std::endl;
+                // retried when one of the files changes again
+                module.dependencies = writeTimes;
+                continue;
+            }
+
+            // saving a file without changing it (or only changing comments) results in the same module
+            if (module.path != oldPath) {
+                statistics.reloadedModules++;
+                reloaded.emplace_back(oldPath, module.path);
+            }
+        }
+        return reloaded;
+    }
+
+    void ShaderCompiler::printStatistics() const {
+        std::cout << "shader compiler: compiled modules: " << statistics.compiledModules
+                  << ", cached modules: " << statistics.cachedModules
+                  << ", reloaded modules: " << statistics.reloadedModules
+                  << ", compile time: " << statistics.compileTime << " ms" << std::endl;
+    }
+}
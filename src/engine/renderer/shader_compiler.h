@@ -0,0 +1,80 @@
+#ifndef SPHERE_SHADER_COMPILER_H
+#define SPHERE_SHADER_COMPILER_H
+
+#include "shaderc/shaderc.hpp"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace engine::renderer {
+
+    struct ShaderCompilerStatistics {
+        uint32_t compiledModules;
+        uint32_t cachedModules; // modules whose SPIR-V was found in the cache directory
+        uint32_t reloadedModules; // modules that were recompiled because one of their files changed
+        float compileTime; // total time spent preprocessing and compiling, in milliseconds
+    };
+
+    /*
+     * Compiles GLSL to SPIR-V at runtime using shaderc, so that shader variants can be compiled on first use
+     * instead of shipping the SPIR-V of every combination of keywords.
+     *
+     * Each module is written to the cache directory under the hash of its preprocessed source, which contains the
+     * defines and the contents of all included files. Modules that were compiled before (also in a previous run)
+     * are not compiled again.
+     *
+     * The files each module depends on are tracked, so that modules can be recompiled when one of them changes
+     * (hot reload). A changed module gets a new path, so that pipelines with the old module stay valid.
+     *
+     * The sources are copied next to the compiled shaders by scripts/compile-shaders.sh.
+     */
+    class ShaderCompiler {
+
+    public:
+        // the cache directory is relative to the shaders directory
+        explicit ShaderCompiler(std::string sourceDirectory = "shaders/source/", std::string cacheDirectory = "cache/");
+        ~ShaderCompiler();
+
+        ShaderCompilerStatistics statistics{};
+
+        // compiles the module if it is not in the cache, returns the path of the SPIR-V relative to the shaders directory.
+        // the stage is determined by the extension (.vert, .frag or .comp), throws with the compiler errors on failure
+        std::string getModule(const std::string &sourcePath, const std::vector<std::string> &defines);
+
+        // recompiles the modules of which a source or included file was modified since the last call,
+        // returns the old and new path of each module that changed. Compile errors are printed, and the old module
+        // is kept until the error has been fixed
+        std::vector<std::pair<std::string, std::string>> reloadModules();
+
+        void printStatistics() const;
+
+    private:
+        struct Module {
+            std::string sourcePath;
+            std::vector<std::string> defines;
+            std::string path; // of the SPIR-V, relative to the shaders directory
+            std::map<std::string, std::filesystem::file_time_type> dependencies; // the source and included files
+        };
+
+        std::string sourceDirectory;
+        std::string cacheDirectory;
+        shaderc::Compiler compiler;
+
+        std::map<std::string, Module> modules; // by source path and defines
+
+        // resolves includes, the included files are added to dependencies.
+        // (CompileOptions does not move its includer, so the options are set in place)
+        void setOptions(shaderc::CompileOptions &options, const std::vector<std::string> &defines,
+                        std::vector<std::string> &dependencies) const;
+        std::string readSource(const std::string &sourcePath) const;
+        // updates the path and dependencies of the module
+        void compileModule(Module &module);
+    };
+
+    extern ShaderCompiler *shaderCompiler;
+}
+
+#endif //SPHERE_SHADER_COMPILER_H
@@ -0,0 +1,429 @@
+#include "shader_reflection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+namespace engine::renderer {
+
+    // the subset of the SPIR-V specification that is used for reflection
+    namespace spirv {
+        constexpr uint32_t magicNumber = 0x07230203;
+        constexpr uint32_t headerWords = 5;
+
+        enum Op : uint32_t {
+            OpName = 5,
+            OpEntryPoint = 15,
+            OpMemberName = 6,
+            OpTypeBool = 20,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpFunction = 54,
+            OpVariable = 59,
+            OpDecorate = 71,
+            OpMemberDecorate = 72,
+        };
+
+        enum Decoration : uint32_t {
+            Block = 2,
+            BufferBlock = 3,
+            ArrayStride = 6,
+            MatrixStride = 7,
+            BuiltIn = 11,
+            Location = 30,
+            Binding = 33,
+            DescriptorSet = 34,
+            Offset = 35,
+        };
+
+        enum StorageClass : uint32_t {
+            UniformConstant = 0,
+            Input = 1,
+            Uniform = 2,
+            PushConstant = 9,
+            StorageBuffer = 12,
+        };
+
+        enum ExecutionModel : uint32_t {
+            Vertex = 0,
+            Fragment = 4,
+            GLCompute = 5,
+        };
+
+        enum Dim : uint32_t {
+            Buffer = 5,
+            SubpassData = 6,
+        };
+    }
+
+    const ReflectedMember *ReflectedStruct::getMember(const std::string &name) const {
+        for (auto const &member: members) {
+            if (member.name == name) {
+                return &member;
+            }
+        }
+        return nullptr;
+    }
+
+    static std::string readString(const uint32_t *words, size_t wordCount) {
+        const char *characters = reinterpret_cast<const char *>(words);
+        return {characters, strnlen(characters, wordCount * sizeof(uint32_t))};
+    }
+
+    ShaderReflection::ShaderReflection(const std::vector<char> &code) {
+        if (code.size() % sizeof(uint32_t) != 0 || code.size() < spirv::headerWords * sizeof(uint32_t)) {
+            throw std::runtime_error("invalid SPIR-V code size");
+        }
+        std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+        memcpy(words.data(), code.data(), code.size());
+        if (words[0] != spirv::magicNumber) {
+            throw std::runtime_error("invalid SPIR-V magic number");
+        }
+
+        size_t i = spirv::headerWords;
+        while (i < words.size()) {
+            uint32_t opcode = words[i] & 0xFFFF;
+            uint32_t wordCount = words[i] >> 16;
+            if (wordCount == 0 || i + wordCount > words.size()) {
+                throw std::runtime_error("invalid SPIR-V instruction");
+            }
+            const uint32_t *operands = &words[i + 1];
+            uint32_t operandCount = wordCount - 1;
+
+            switch (opcode) {
+                case spirv::OpEntryPoint:
+                    if (stage == 0) {
+                        switch (operands[0]) {
+                            case spirv::Vertex:
+                                stage = VK_SHADER_STAGE_VERTEX_BIT;
+                                break;
+                            case spirv::Fragment:
+                                stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+                                break;
+                            case spirv::GLCompute:
+                                stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+                    break;
+                case spirv::OpName:
+                    names[operands[0]] = readString(operands + 1, operandCount - 1);
+                    break;
+                case spirv::OpMemberName: {
+                    std::vector<std::string> &structMemberNames = memberNames[operands[0]];
+                    if (structMemberNames.size() <= operands[1]) {
+                        structMemberNames.resize(operands[1] + 1);
+                    }
+                    structMemberNames[operands[1]] = readString(operands + 2, operandCount - 2);
+                    break;
+                }
+                case spirv::OpDecorate:
+                    decorations[operands[0]][operands[1]] = operandCount > 2 ? operands[2] : 0;
+                    break;
+                case spirv::OpMemberDecorate:
+                    memberDecorations[operands[0]][operands[1]][operands[2]] = operandCount > 3 ? operands[3] : 0;
+                    break;
+                case spirv::OpTypeBool:
+                case spirv::OpTypeInt:
+                case spirv::OpTypeFloat:
+                case spirv::OpTypeVector:
+                case spirv::OpTypeMatrix:
+                case spirv::OpTypeImage:
+                case spirv::OpTypeSampler:
+                case spirv::OpTypeSampledImage:
+                case spirv::OpTypeArray:
+                case spirv::OpTypeRuntimeArray:
+                case spirv::OpTypeStruct:
+                case spirv::OpTypePointer:
+                    types[operands[0]] = Type{opcode, {operands + 1, operands + operandCount}};
+                    break;
+                case spirv::OpConstant:
+                    // result type, result id, value (the low word for 64-bit constants)
+                    constants[operands[1]] = operands[2];
+                    break;
+                case spirv::OpVariable:
+                    // result type, result id, storage class
+                    variables.push_back({operands[1], operands[0], operands[2]});
+                    break;
+                default:
+                    break;
+            }
+
+            // the types, names and decorations are all declared before the first function
+            if (opcode == spirv::OpFunction) {
+                break;
+            }
+            i += wordCount;
+        }
+    }
+
+    std::optional<ReflectedStruct> ShaderReflection::getStruct(const std::string &name) const {
+        // a struct that is also used outside a buffer is declared a second time, without offsets
+        std::optional<uint32_t> result;
+        for (auto const &[id, type]: types) {
+            auto it = names.find(id);
+            if (type.opcode != spirv::OpTypeStruct || it == names.end() || it->second != name) {
+                continue;
+            }
+            if (!result || memberDecorations.contains(id)) {
+                result = id;
+            }
+        }
+        if (!result) {
+            return std::nullopt;
+        }
+        return getStruct(*result);
+    }
+
+    ReflectedStruct ShaderReflection::getStruct(uint32_t id) const {
+        const Type &type = types.at(id);
+        auto namesIt = memberNames.find(id);
+
+        ReflectedStruct result{};
+        for (uint32_t i = 0; i < type.operands.size(); i++) {
+            uint32_t memberType = type.operands[i];
+            uint32_t size = getSize(memberType, getMemberDecoration(id, i, spirv::MatrixStride).value_or(0));
+            ReflectedMember member{
+                    .name = namesIt != memberNames.end() && i < namesIt->second.size() ? namesIt->second[i] : "",
+                    .type = getDataType(memberType),
+                    .offset = getMemberDecoration(id, i, spirv::Offset).value_or(0),
+                    .size = size,
+            };
+            result.size = std::max(result.size, member.offset + member.size);
+            result.members.push_back(member);
+        }
+
+        // when the struct is the element of an array, the stride includes the padding at the end of the struct
+        for (auto const &[arrayId, arrayType]: types) {
+            if ((arrayType.opcode == spirv::OpTypeArray || arrayType.opcode == spirv::OpTypeRuntimeArray) &&
+                arrayType.operands[0] == id) {
+                if (auto stride = getDecoration(arrayId, spirv::ArrayStride)) {
+                    result.size = *stride;
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    std::vector<ReflectedBinding> ShaderReflection::getBindings() const {
+        std::vector<ReflectedBinding> bindings;
+        for (auto const &variable: variables) {
+            auto set = getDecoration(variable.id, spirv::DescriptorSet);
+            auto binding = getDecoration(variable.id, spirv::Binding);
+            if (!set || !binding) {
+                continue;
+            }
+
+            uint32_t typeId = getVariableType(variable);
+            uint32_t count = 1;
+            const Type &type = types.at(typeId);
+            if (type.opcode == spirv::OpTypeArray) {
+                auto length = constants.find(type.operands[1]);
+                count = length != constants.end() ? length->second : 1;
+                typeId = type.operands[0];
+            } else if (type.opcode == spirv::OpTypeRuntimeArray) {
+                count = 0;
+                typeId = type.operands[0];
+            }
+
+            std::optional<VkDescriptorType> descriptorType = getDescriptorType(typeId, variable.storageClass);
+            if (!descriptorType) {
+                throw std::runtime_error("unsupported descriptor type of " +
+                                         (names.contains(variable.id) ? names.at(variable.id) : "unnamed resource"));
+            }
+            bindings.push_back({*set, *binding, *descriptorType, count, static_cast<VkShaderStageFlags>(stage)});
+        }
+        std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding &a, const ReflectedBinding &b) {
+            return std::tie(a.set, a.binding) < std::tie(b.set, b.binding);
+        });
+        return bindings;
+    }
+
+    uint32_t ShaderReflection::getPushConstantsSize() const {
+        for (auto const &variable: variables) {
+            if (variable.storageClass == spirv::PushConstant) {
+                return getStruct(getVariableType(variable)).size;
+            }
+        }
+        return 0;
+    }
+
+    std::vector<ReflectedInput> ShaderReflection::getInputs() const {
+        std::vector<ReflectedInput> inputs;
+        for (auto const &variable: variables) {
+            auto location = getDecoration(variable.id, spirv::Location);
+            if (variable.storageClass != spirv::Input || !location || getDecoration(variable.id, spirv::BuiltIn)) {
+                continue;
+            }
+            VkFormat format;
+            switch (getDataType(getVariableType(variable))) {
+                case ShaderDataType::Float:
+                    format = VK_FORMAT_R32_SFLOAT;
+                    break;
+                case ShaderDataType::Int:
+                    format = VK_FORMAT_R32_SINT;
+                    break;
+                case ShaderDataType::UInt:
+                    format = VK_FORMAT_R32_UINT;
+                    break;
+                case ShaderDataType::Vec2:
+                    format = VK_FORMAT_R32G32_SFLOAT;
+                    break;
+                case ShaderDataType::Vec3:
+                    format = VK_FORMAT_R32G32B32_SFLOAT;
+                    break;
+                case ShaderDataType::Vec4:
+                    format = VK_FORMAT_R32G32B32A32_SFLOAT;
+                    break;
+                default:
+                    format = VK_FORMAT_UNDEFINED;
+                    break;
+            }
+            inputs.push_back({*location, format});
+        }
+        std::sort(inputs.begin(), inputs.end(), [](const ReflectedInput &a, const ReflectedInput &b) {
+            return a.location < b.location;
+        });
+        return inputs;
+    }
+
+    uint32_t ShaderReflection::getVariableType(const Variable &variable) const {
+        // OpTypePointer: storage class, type
+        return types.at(variable.pointerType).operands[1];
+    }
+
+    std::optional<VkDescriptorType> ShaderReflection::getDescriptorType(uint32_t typeId, uint32_t storageClass) const {
+        const Type &type = types.at(typeId);
+        switch (type.opcode) {
+            case spirv::OpTypeSampledImage:
+                return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            case spirv::OpTypeSampler:
+                return VK_DESCRIPTOR_TYPE_SAMPLER;
+            case spirv::OpTypeImage: {
+                // sampled type, dim, depth, arrayed, multisampled, sampled (1: with a sampler, 2: storage), format
+                uint32_t dim = type.operands[1];
+                bool sampled = type.operands[5] == 1;
+                if (dim == spirv::Buffer) {
+                    return sampled ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+                }
+                if (dim == spirv::SubpassData) {
+                    return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                }
+                return sampled ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            }
+            case spirv::OpTypeStruct:
+                // before SPIR-V 1.3, storage buffers are uniform blocks decorated with BufferBlock
+                if (storageClass == spirv::StorageBuffer || getDecoration(typeId, spirv::BufferBlock)) {
+                    return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                }
+                if (storageClass == spirv::Uniform) {
+                    return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                }
+                return std::nullopt;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    ShaderDataType ShaderReflection::getDataType(uint32_t typeId) const {
+        const Type &type = types.at(typeId);
+        switch (type.opcode) {
+            case spirv::OpTypeFloat:
+                return type.operands[0] == 32 ? ShaderDataType::Float : ShaderDataType::Unknown;
+            case spirv::OpTypeInt:
+                if (type.operands[0] != 32) {
+                    return ShaderDataType::Unknown;
+                }
+                return type.operands[1] != 0 ? ShaderDataType::Int : ShaderDataType::UInt;
+            case spirv::OpTypeVector:
+                if (getDataType(type.operands[0]) != ShaderDataType::Float) {
+                    return ShaderDataType::Unknown;
+                }
+                switch (type.operands[1]) {
+                    case 2:
+                        return ShaderDataType::Vec2;
+                    case 3:
+                        return ShaderDataType::Vec3;
+                    case 4:
+                        return ShaderDataType::Vec4;
+                    default:
+                        return ShaderDataType::Unknown;
+                }
+            case spirv::OpTypeMatrix:
+                return getDataType(type.operands[0]) == ShaderDataType::Vec4 && type.operands[1] == 4
+                       ? ShaderDataType::Mat4 : ShaderDataType::Unknown;
+            default:
+                return ShaderDataType::Unknown;
+        }
+    }
+
+    uint32_t ShaderReflection::getSize(uint32_t typeId, uint32_t matrixStride) const {
+        const Type &type = types.at(typeId);
+        switch (type.opcode) {
+            case spirv::OpTypeBool:
+                return 4;
+            case spirv::OpTypeInt:
+            case spirv::OpTypeFloat:
+                return type.operands[0] / 8;
+            case spirv::OpTypeVector:
+                return getSize(type.operands[0]) * type.operands[1];
+            case spirv::OpTypeMatrix: {
+                uint32_t columnSize = matrixStride != 0 ? matrixStride : getSize(type.operands[0]);
+                return columnSize * type.operands[1];
+            }
+            case spirv::OpTypeArray: {
+                auto length = constants.find(type.operands[1]);
+                uint32_t stride = getDecoration(typeId, spirv::ArrayStride).value_or(getSize(type.operands[0]));
+                return length != constants.end() ? stride * length->second : 0;
+            }
+            case spirv::OpTypeStruct:
+                return getStruct(typeId).size;
+            default:
+                // runtime arrays, opaque types and pointers have no size
+                return 0;
+        }
+    }
+
+    std::optional<uint32_t> ShaderReflection::getDecoration(uint32_t id, uint32_t decoration) const {
+        auto it = decorations.find(id);
+        if (it == decorations.end()) {
+            return std::nullopt;
+        }
+        auto decorationIt = it->second.find(decoration);
+        if (decorationIt == it->second.end()) {
+            return std::nullopt;
+        }
+        return decorationIt->second;
+    }
+
+    std::optional<uint32_t>
+    ShaderReflection::getMemberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const {
+        auto it = memberDecorations.find(id);
+        if (it == memberDecorations.end()) {
+            return std::nullopt;
+        }
+        auto memberIt = it->second.find(member);
+        if (memberIt == it->second.end()) {
+            return std::nullopt;
+        }
+        auto decorationIt = memberIt->second.find(decoration);
+        if (decorationIt == memberIt->second.end()) {
+            return std::nullopt;
+        }
+        return decorationIt->second;
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef SPHERE_SHADER_REFLECTION_H
+#define SPHERE_SHADER_REFLECTION_H
+
+#include "vulkan.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine::renderer {
+
+    enum class ShaderDataType {
+        Unknown, // e.g. structs, arrays and booleans, which can't be set directly
+        Float,
+        Int,
+        UInt,
+        Vec2,
+        Vec3,
+        Vec4,
+        Mat4,
+    };
+
+    struct ReflectedMember {
+        std::string name;
+        ShaderDataType type;
+        uint32_t offset; // in bytes, as laid out by the shader (e.g. std430)
+        uint32_t size;
+    };
+
+    struct ReflectedStruct {
+        std::vector<ReflectedMember> members;
+        uint32_t size; // the array stride when the struct is used in an array, otherwise the end of the last member
+
+        [[nodiscard]] const ReflectedMember *getMember(const std::string &name) const;
+    };
+
+    struct ReflectedBinding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType descriptorType;
+        uint32_t descriptorCount; // 0 for runtime arrays
+        VkShaderStageFlags stageFlags;
+    };
+
+    struct ReflectedInput {
+        uint32_t location;
+        VkFormat format; // VK_FORMAT_UNDEFINED for types that can't be a vertex attribute
+    };
+
+    /*
+     * Parses the types, names and decorations of a SPIR-V module, so that the engine can read the interface of
+     * a shader instead of hard-coding it. Only the instructions that describe the interface are parsed,
+     * function bodies are skipped.
+     */
+    class ShaderReflection {
+
+    public:
+        // throws when the code is not valid SPIR-V
+        explicit ShaderReflection(const std::vector<char> &code);
+
+        // of the first entry point, 0 for stages other than vertex, fragment and compute
+        VkShaderStageFlagBits stage{};
+
+        // the struct type with the given name in the source, only structs with an explicit layout have offsets
+        [[nodiscard]] std::optional<ReflectedStruct> getStruct(const std::string &name) const;
+
+        // the resources declared with a set and binding, ordered by set and binding
+        [[nodiscard]] std::vector<ReflectedBinding> getBindings() const;
+
+        // the end of the last member of the push constant block, 0 when the module has none
+        [[nodiscard]] uint32_t getPushConstantsSize() const;
+
+        // the stage inputs with a location, built-ins are excluded
+        [[nodiscard]] std::vector<ReflectedInput> getInputs() const;
+
+    private:
+        struct Type {
+            uint32_t opcode;
+            std::vector<uint32_t> operands; // without the result id
+        };
+
+        struct Variable {
+            uint32_t id;
+            uint32_t pointerType;
+            uint32_t storageClass;
+        };
+
+        std::unordered_map<uint32_t, std::string> names;
+        std::unordered_map<uint32_t, std::vector<std::string>> memberNames;
+        // id -> decoration -> first literal (or 0 when the decoration has none)
+        std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> decorations;
+        // struct id -> member index -> decoration -> first literal
+        std::unordered_map<uint32_t, std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>>> memberDecorations;
+        std::unordered_map<uint32_t, Type> types;
+        std::unordered_map<uint32_t, uint32_t> constants; // 32-bit integer constants, for array lengths
+        std::vector<Variable> variables; // global variables, in declaration order
+
+        // the type the variable points to
+        [[nodiscard]] uint32_t getVariableType(const Variable &variable) const;
+        [[nodiscard]] std::optional<VkDescriptorType> getDescriptorType(uint32_t typeId, uint32_t storageClass) const;
+
+        [[nodiscard]] ReflectedStruct getStruct(uint32_t id) const;
+        [[nodiscard]] ShaderDataType getDataType(uint32_t typeId) const;
+        // size of a type with an explicit layout, the matrix stride is a decoration of the member that contains it
+        [[nodiscard]] uint32_t getSize(uint32_t typeId, uint32_t matrixStride = 0) const;
+        [[nodiscard]] std::optional<uint32_t> getDecoration(uint32_t id, uint32_t decoration) const;
+        [[nodiscard]] std::optional<uint32_t> getMemberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const;
+    };
+}
+
+#endif //SPHERE_SHADER_REFLECTION_H
@@ -0,0 +1,72 @@
+#include "shader_variants.h"
+
+#include "shader_compiler.h"
+#include "bindless_textures.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace engine::renderer {
+
+    ShaderVariants::ShaderVariants(std::string vertexSourcePath, std::string fragmentSourcePath,
+                                   std::vector<ShaderKeyword> keywords, VkRenderPass renderPass) :
+            vertexSourcePath(std::move(vertexSourcePath)), fragmentSourcePath(std::move(fragmentSourcePath)),
+            keywords(std::move(keywords)), renderPass(renderPass) {
+
+    }
+
+    ShaderVariants::~ShaderVariants() = default;
+
+    Shader &ShaderVariants::getVariant(const std::vector<std::string> &enabledKeywords) {
+        std::vector<std::string> sortedKeywords = enabledKeywords;
+        bool bindless = bindlessTextures != nullptr &&
+                        std::any_of(keywords.begin(), keywords.end(),
+                                    [](const ShaderKeyword &keyword) { return keyword.name == bindlessKeyword; });
+        if (bindless) {
+            sortedKeywords.emplace_back(bindlessKeyword);
+        }
+        std::sort(sortedKeywords.begin(), sortedKeywords.end());
+        sortedKeywords.erase(std::unique(sortedKeywords.begin(), sortedKeywords.end()), sortedKeywords.end());
+
+        std::string key;
+        for (const auto &keyword: sortedKeywords) {
+            key += keyword + ";";
+        }
+
+        auto it = variants.find(key);
+        if (it != variants.end()) {
+            return *it->second;
+        }
+
+        std::vector<std::string> defines;
+        uint32_t specializationConstants = 0;
+        bool discardsFragments = false;
+        for (const auto &name: sortedKeywords) {
+            auto keyword = std::find_if(keywords.begin(), keywords.end(),
+                                        [&](const ShaderKeyword &keyword) { return keyword.name == name; });
+            if (keyword == keywords.end()) {
+                throw std::runtime_error("unknown shader keyword: " + name);
+            }
+
+            if (keyword->type == ShaderKeywordType::Define) {
+                defines.push_back(keyword->name);
+            } else {
+                specializationConstants |= 1u << keyword->constantId;
+            }
+            discardsFragments |= keyword->discardsFragments;
+        }
+
+        auto shader = std::make_unique<Shader>(shaderCompiler->getModule(vertexSourcePath, defines),
+                                               shaderCompiler->getModule(fragmentSourcePath, defines),
+                                               renderPass, specializationConstants);
+        shader->depthPrepass = !discardsFragments;
+        return *variants.emplace(key, std::move(shader)).first->second;
+    }
+
+    void ShaderVariants::printStatistics() const {
+        std::cout << "shader variants (" << vertexSourcePath << ", " << fragmentSourcePath << "): "
+                  << variants.size() << " variants" << std::endl;
+    }
+}
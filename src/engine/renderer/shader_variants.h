@@ -0,0 +1,60 @@
+#ifndef SPHERE_SHADER_VARIANTS_H
+#define SPHERE_SHADER_VARIANTS_H
+
+#include "material_system.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace engine::renderer {
+
+    enum class ShaderKeywordType {
+        // #ifdef in the source, each combination of defines is compiled into its own SPIR-V module
+        Define,
+        // layout(constant_id = ...) const bool in the source, variants share the SPIR-V module
+        SpecializationConstant
+    };
+
+    struct ShaderKeyword {
+        std::string name;
+        ShaderKeywordType type = ShaderKeywordType::Define;
+        uint32_t constantId = 0; // for specialization constants, should be below 32
+        bool discardsFragments = false; // e.g. alpha testing, variants with the keyword skip the depth prepass
+    };
+
+    /*
+     * Shader variants are created from one vertex and fragment shader source with a set of keywords
+     * (e.g. textured, lit, alpha test), without shipping the SPIR-V of every combination.
+     *
+     * Variants are compiled on first use by the shader compiler, which caches the SPIR-V modules by source and defines.
+     * The shader (and therefore its pipelines) is cached by the enabled keywords.
+     *
+     * The BINDLESS keyword is not enabled by materials, but automatically when the bindless texture array exists.
+     */
+    class ShaderVariants {
+
+    public:
+        static constexpr const char *bindlessKeyword = "BINDLESS";
+
+        explicit ShaderVariants(std::string vertexSourcePath, std::string fragmentSourcePath,
+                                std::vector<ShaderKeyword> keywords, VkRenderPass renderPass);
+        ~ShaderVariants();
+
+        // returns the variant with the given keywords enabled, throws for keywords that were not declared
+        Shader &getVariant(const std::vector<std::string> &enabledKeywords);
+
+        void printStatistics() const;
+
+    private:
+        std::string vertexSourcePath;
+        std::string fragmentSourcePath;
+        std::vector<ShaderKeyword> keywords;
+        VkRenderPass renderPass;
+
+        std::map<std::string, std::unique_ptr<Shader>> variants; // by the sorted enabled keywords
+    };
+}
+
+#endif //SPHERE_SHADER_VARIANTS_H
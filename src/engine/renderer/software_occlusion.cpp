@@ -0,0 +1,435 @@
+#include "software_occlusion.h"
+
+#include "scene.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SPHERE_SIMD_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SPHERE_SIMD_NEON
+#endif
+
+namespace engine::renderer {
+
+    namespace {
+
+        /*
+         * Four floats that get processed at once, maps to SSE on x86 and NEON on ARM (e.g. Apple silicon, Android),
+         * with a scalar fallback for other platforms.
+         */
+        struct Float4 {
+#if defined(SPHERE_SIMD_SSE)
+            __m128 v;
+
+            static Float4 load(const float *p) { return {_mm_loadu_ps(p)}; }
+            static Float4 splat(float f) { return {_mm_set1_ps(f)}; }
+            static Float4 set(float a, float b, float c, float d) { return {_mm_setr_ps(a, b, c, d)}; }
+            void store(float *p) const { _mm_storeu_ps(p, v); }
+
+            friend Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+            friend Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+            friend Float4 min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+            friend Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+
+            // lanes where a >= b are all ones
+            friend Float4 greaterEqual(Float4 a, Float4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+
+            // lanes from a where the mask is set, otherwise from b
+            friend Float4 select(Float4 mask, Float4 a, Float4 b) {
+                return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+            }
+
+            [[nodiscard]] bool any() const { return _mm_movemask_ps(v) != 0; }
+#elif defined(SPHERE_SIMD_NEON)
+            float32x4_t v;
+
+            static Float4 load(const float *p) { return {vld1q_f32(p)}; }
+            static Float4 splat(float f) { return {vdupq_n_f32(f)}; }
+            static Float4 set(float a, float b, float c, float d) {
+                float values[4]{a, b, c, d};
+                return {vld1q_f32(values)};
+            }
+            void store(float *p) const { vst1q_f32(p, v); }
+
+            friend Float4 operator+(Float4 a, Float4 b) { return {vaddq_f32(a.v, b.v)}; }
+            friend Float4 operator*(Float4 a, Float4 b) { return {vmulq_f32(a.v, b.v)}; }
+            friend Float4 min(Float4 a, Float4 b) { return {vminq_f32(a.v, b.v)}; }
+            friend Float4 max(Float4 a, Float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+
+            friend Float4 greaterEqual(Float4 a, Float4 b) { return {vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v))}; }
+
+            friend Float4 select(Float4 mask, Float4 a, Float4 b) {
+                return {vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v)};
+            }
+
+            [[nodiscard]] bool any() const {
+                uint32x4_t u = vreinterpretq_u32_f32(v);
+                uint32x2_t m = vorr_u32(vget_low_u32(u), vget_high_u32(u));
+                return (vget_lane_u32(m, 0) | vget_lane_u32(m, 1)) != 0;
+            }
+#else
+            float v[4];
+
+            static Float4 load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+            static Float4 splat(float f) { return {{f, f, f, f}}; }
+            static Float4 set(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+            void store(float *p) const { std::copy(v, v + 4, p); }
+
+            template<typename Function>
+            static Float4 apply(Float4 a, Float4 b, Function function) {
+                return {{function(a.v[0], b.v[0]), function(a.v[1], b.v[1]),
+                         function(a.v[2], b.v[2]), function(a.v[3], b.v[3])}};
+            }
+
+            friend Float4 operator+(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+            friend Float4 operator*(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+            friend Float4 min(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return std::min(x, y); }); }
+            friend Float4 max(Float4 a, Float4 b) { return apply(a, b, [](float x, float y) { return std::max(x, y); }); }
+
+            // the scalar mask uses 1.0 for set lanes instead of all ones
+            friend Float4 greaterEqual(Float4 a, Float4 b) {
+                return apply(a, b, [](float x, float y) { return x >= y ? 1.0f : 0.0f; });
+            }
+
+            friend Float4 select(Float4 mask, Float4 a, Float4 b) {
+                return {{mask.v[0] != 0 ? a.v[0] : b.v[0], mask.v[1] != 0 ? a.v[1] : b.v[1],
+                         mask.v[2] != 0 ? a.v[2] : b.v[2], mask.v[3] != 0 ? a.v[3] : b.v[3]}};
+            }
+
+            [[nodiscard]] bool any() const { return v[0] != 0 || v[1] != 0 || v[2] != 0 || v[3] != 0; }
+#endif
+        };
+
+        // triangles and bounds closer than this are considered to (partially) lie behind the camera
+        constexpr float minimumW = 1e-5f;
+
+        float millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<float, std::milli>(end - start).count();
+        }
+    }
+
+    SoftwareOcclusionCuller::SoftwareOcclusionCuller(ThreadPool &threadPool, uint32_t width, uint32_t height)
+            : threadPool(threadPool) {
+        tilesX = (width + tileWidth - 1) / tileWidth;
+        tilesY = (height + tileHeight - 1) / tileHeight;
+        this->width = tilesX * tileWidth;
+        this->height = tilesY * tileHeight;
+
+        depthBuffer.resize(this->width * this->height, 1.0f);
+        tileMaxDepth.resize(tilesX * tilesY, 1.0f);
+    }
+
+    SoftwareOcclusionCuller::~SoftwareOcclusionCuller() = default;
+
+    void SoftwareOcclusionCuller::rasterize(const std::vector<Occluder> &occluders, const glm::mat4 &viewProjection) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // transform the triangles of each occluder to screen space
+        if (occluderTriangles.size() < occluders.size()) {
+            occluderTriangles.resize(occluders.size());
+        }
+        threadPool.parallelFor(occluders.size(), [&](size_t i) {
+            setupTriangles(occluders[i], viewProjection, occluderTriangles[i]);
+        });
+        for (size_t i = occluders.size(); i < occluderTriangles.size(); i++) {
+            occluderTriangles[i].clear();
+        }
+
+        // each tile gets cleared and rasterized by a single thread, so tiles don't need any synchronization
+        threadPool.parallelFor(tilesX * tilesY, [&](size_t tileIndex) {
+            rasterizeTile(static_cast<uint32_t>(tileIndex));
+        });
+
+        statistics.occluderTriangles = 0;
+        for (const auto &triangles: occluderTriangles) {
+            statistics.occluderTriangles += static_cast<uint32_t>(triangles.size());
+        }
+        statistics.rasterizeTime = millisecondsSince(start);
+    }
+
+    void SoftwareOcclusionCuller::setupTriangles(const Occluder &occluder, const glm::mat4 &viewProjection,
+                                                 std::vector<ScreenTriangle> &triangles) const {
+        triangles.clear();
+
+        const std::vector<VertexAttributes> &vertices = *occluder.vertices;
+        const std::vector<uint32_t> &indices = *occluder.indices;
+        glm::mat4 MVP = viewProjection * occluder.transform;
+
+        auto toScreen = [&](const glm::vec4 &clip) {
+            float invW = 1.0f / clip.w;
+            return glm::vec3{(clip.x * invW * 0.5f + 0.5f) * static_cast<float>(width),
+                             (clip.y * invW * 0.5f + 0.5f) * static_cast<float>(height),
+                             clip.z * invW};
+        };
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            glm::vec4 c0 = MVP * glm::vec4(vertices[indices[i]].position, 1.0f);
+            glm::vec4 c1 = MVP * glm::vec4(vertices[indices[i + 1]].position, 1.0f);
+            glm::vec4 c2 = MVP * glm::vec4(vertices[indices[i + 2]].position, 1.0f);
+
+            // no near plane clipping: triangles that cross it are skipped, which only makes the result less
+            // aggressive, never wrong.
+            if (c0.w < minimumW || c1.w < minimumW || c2.w < minimumW) {
+                continue;
+            }
+
+            ScreenTriangle triangle{toScreen(c0), toScreen(c1), toScreen(c2)};
+
+            // parts in front of the depth range get clipped by the gpu, so they can't occlude anything
+            if (triangle.v0.z < 0.0f || triangle.v1.z < 0.0f || triangle.v2.z < 0.0f) {
+                continue;
+            }
+
+            // the pipelines use clockwise front faces with back face culling, which (in framebuffer coordinates with
+            // y pointing down) is a triangle with positive area. Edge functions are positive inside these triangles.
+            float area = (triangle.v1.x - triangle.v0.x) * (triangle.v2.y - triangle.v0.y) -
+                         (triangle.v1.y - triangle.v0.y) * (triangle.v2.x - triangle.v0.x);
+            if (area <= 0.0f) {
+                continue;
+            }
+
+            float minX = std::min({triangle.v0.x, triangle.v1.x, triangle.v2.x});
+            float minY = std::min({triangle.v0.y, triangle.v1.y, triangle.v2.y});
+            float maxX = std::max({triangle.v0.x, triangle.v1.x, triangle.v2.x});
+            float maxY = std::max({triangle.v0.y, triangle.v1.y, triangle.v2.y});
+
+            // outside the screen
+            if (maxX < 0.0f || maxY < 0.0f || minX >= static_cast<float>(width) || minY >= static_cast<float>(height)) {
+                continue;
+            }
+
+            triangle.minX = static_cast<int>(std::max(minX, 0.0f));
+            triangle.minY = static_cast<int>(std::max(minY, 0.0f));
+            triangle.maxX = static_cast<int>(std::min(maxX, static_cast<float>(width - 1)));
+            triangle.maxY = static_cast<int>(std::min(maxY, static_cast<float>(height - 1)));
+            triangles.emplace_back(triangle);
+        }
+    }
+
+    void SoftwareOcclusionCuller::rasterizeTile(uint32_t tileIndex) {
+        int tileMinX = static_cast<int>((tileIndex % tilesX) * tileWidth);
+        int tileMinY = static_cast<int>((tileIndex / tilesX) * tileHeight);
+        int tileMaxX = tileMinX + static_cast<int>(tileWidth) - 1;
+        int tileMaxY = tileMinY + static_cast<int>(tileHeight) - 1;
+
+        for (int y = tileMinY; y <= tileMaxY; y++) {
+            std::fill_n(&depthBuffer[y * width + tileMinX], tileWidth, 1.0f);
+        }
+
+        for (const auto &triangles: occluderTriangles) {
+            for (const auto &triangle: triangles) {
+                if (triangle.maxX < tileMinX || triangle.minX > tileMaxX ||
+                    triangle.maxY < tileMinY || triangle.minY > tileMaxY) {
+                    continue;
+                }
+                rasterizeTriangle(triangle,
+                                  std::max(triangle.minX, tileMinX), std::max(triangle.minY, tileMinY),
+                                  std::min(triangle.maxX, tileMaxX), std::min(triangle.maxY, tileMaxY));
+            }
+        }
+
+        Float4 farthest = Float4::splat(0.0f);
+        for (int y = tileMinY; y <= tileMaxY; y++) {
+            for (int x = tileMinX; x <= tileMaxX; x += 4) {
+                farthest = max(farthest, Float4::load(&depthBuffer[y * width + x]));
+            }
+        }
+        float lanes[4];
+        farthest.store(lanes);
+        tileMaxDepth[tileIndex] = std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+    }
+
+    void SoftwareOcclusionCuller::rasterizeTriangle(const ScreenTriangle &triangle,
+                                                    int minX, int minY, int maxX, int maxY) {
+        const glm::vec3 &v0 = triangle.v0;
+        const glm::vec3 &v1 = triangle.v1;
+        const glm::vec3 &v2 = triangle.v2;
+
+        // edge function of edge ab: e(p) = (a.y - b.y) * p.x + (b.x - a.x) * p.y + (a.x * b.y - a.y * b.x)
+        auto edge = [](const glm::vec3 &a, const glm::vec3 &b) {
+            return glm::vec3{a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x};
+        };
+        glm::vec3 e0 = edge(v1, v2);
+        glm::vec3 e1 = edge(v2, v0);
+        glm::vec3 e2 = edge(v0, v1);
+
+        // depth is linear in screen space, so it can be written as a plane: z(p) = zx * p.x + zy * p.y + zc
+        float area = e0.z + e1.z + e2.z;
+        float invArea = 1.0f / area;
+        float zx = (e0.x * v0.z + e1.x * v1.z + e2.x * v2.z) * invArea;
+        float zy = (e0.y * v0.z + e1.y * v1.z + e2.y * v2.z) * invArea;
+        float zc = (e0.z * v0.z + e1.z * v1.z + e2.z * v2.z) * invArea;
+
+        // start at a multiple of 4, tiles are aligned to 4 so this stays inside the tile
+        minX &= ~3;
+
+        // pixel centers
+        Float4 px = Float4::set(0.5f, 1.5f, 2.5f, 3.5f) + Float4::splat(static_cast<float>(minX));
+        Float4 zero = Float4::splat(0.0f);
+
+        Float4 e0x = Float4::splat(e0.x), e1x = Float4::splat(e1.x), e2x = Float4::splat(e2.x);
+        Float4 e0Start = e0x * px + Float4::splat(e0.z);
+        Float4 e1Start = e1x * px + Float4::splat(e1.z);
+        Float4 e2Start = e2x * px + Float4::splat(e2.z);
+        Float4 zStart = Float4::splat(zx) * px + Float4::splat(zc);
+
+        Float4 e0Step = Float4::splat(e0.x * 4.0f);
+        Float4 e1Step = Float4::splat(e1.x * 4.0f);
+        Float4 e2Step = Float4::splat(e2.x * 4.0f);
+        Float4 zStep = Float4::splat(zx * 4.0f);
+
+        for (int y = minY; y <= maxY; y++) {
+            float py = static_cast<float>(y) + 0.5f;
+            Float4 w0 = e0Start + Float4::splat(e0.y * py);
+            Float4 w1 = e1Start + Float4::splat(e1.y * py);
+            Float4 w2 = e2Start + Float4::splat(e2.y * py);
+            Float4 z = zStart + Float4::splat(zy * py);
+
+            float *row = &depthBuffer[y * width];
+            for (int x = minX; x <= maxX; x += 4) {
+                Float4 inside = greaterEqual(min(w0, min(w1, w2)), zero);
+                if (inside.any()) {
+                    Float4 depth = Float4::load(row + x);
+                    select(inside, min(depth, z), depth).store(row + x);
+                }
+                w0 = w0 + e0Step;
+                w1 = w1 + e1Step;
+                w2 = w2 + e2Step;
+                z = z + zStep;
+            }
+        }
+    }
+
+    void SoftwareOcclusionCuller::test(const std::vector<OcclusionCandidate> &testCandidates,
+                                       const glm::mat4 &viewProjection, std::vector<uint8_t> &result) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        result.resize(testCandidates.size());
+
+        // candidates are cheap to test, so they get processed in batches to reduce the scheduling overhead
+        constexpr size_t batchSize = 64;
+        size_t batchCount = (testCandidates.size() + batchSize - 1) / batchSize;
+        threadPool.parallelFor(batchCount, [&](size_t batch) {
+            size_t end = std::min((batch + 1) * batchSize, testCandidates.size());
+            for (size_t i = batch * batchSize; i < end; i++) {
+                result[i] = isOccluded(testCandidates[i], viewProjection) ? 0 : 1;
+            }
+        });
+
+        statistics.testedObjects = static_cast<uint32_t>(testCandidates.size());
+        statistics.occludedObjects = static_cast<uint32_t>(std::count(result.begin(), result.end(), 0));
+        statistics.testTime = millisecondsSince(start);
+    }
+
+    bool SoftwareOcclusionCuller::isOccluded(const OcclusionCandidate &candidate,
+                                             const glm::mat4 &viewProjection) const {
+        glm::mat4 MVP = viewProjection * candidate.transform;
+        const glm::vec3 &boundsMin = candidate.bounds.min;
+        const glm::vec3 &boundsMax = candidate.bounds.max;
+
+        // screen space rectangle and nearest depth of the bounds
+        glm::vec3 rectMin{std::numeric_limits<float>::max()};
+        glm::vec3 rectMax{std::numeric_limits<float>::lowest()};
+        for (uint32_t corner = 0; corner < 8; corner++) {
+            glm::vec3 position{corner & 1 ? boundsMax.x : boundsMin.x,
+                               corner & 2 ? boundsMax.y : boundsMin.y,
+                               corner & 4 ? boundsMax.z : boundsMin.z};
+            glm::vec4 clip = MVP * glm::vec4(position, 1.0f);
+            if (clip.w < minimumW) {
+                return false; // intersects the near plane
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            rectMin = glm::min(rectMin, ndc);
+            rectMax = glm::max(rectMax, ndc);
+        }
+
+        float nearestDepth = rectMin.z;
+        if (nearestDepth <= 0.0f) {
+            return false;
+        }
+
+        // outside the screen, leave to frustum culling
+        if (rectMax.x < -1.0f || rectMax.y < -1.0f || rectMin.x > 1.0f || rectMin.y > 1.0f) {
+            return false;
+        }
+
+        auto toPixel = [](float ndc, uint32_t size) {
+            float pixel = (std::clamp(ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * static_cast<float>(size);
+            return std::min(static_cast<int>(pixel), static_cast<int>(size) - 1);
+        };
+        int minX = toPixel(rectMin.x, width);
+        int minY = toPixel(rectMin.y, height);
+        int maxX = toPixel(rectMax.x, width);
+        int maxY = toPixel(rectMax.y, height);
+
+        // fast path: behind the farthest depth of all tiles it overlaps
+        bool behindTiles = true;
+        for (int tileY = minY / tileHeight; behindTiles && tileY <= maxY / tileHeight; tileY++) {
+            for (int tileX = minX / tileWidth; tileX <= maxX / tileWidth; tileX++) {
+                if (tileMaxDepth[tileY * tilesX + tileX] >= nearestDepth) {
+                    behindTiles = false;
+                    break;
+                }
+            }
+        }
+        if (behindTiles) {
+            return true;
+        }
+
+        // test each pixel, the rectangle gets extended to multiples of 4, which only makes the test more conservative
+        minX &= ~3;
+        Float4 depth = Float4::splat(nearestDepth);
+        for (int y = minY; y <= maxY; y++) {
+            const float *row = &depthBuffer[y * width];
+            for (int x = minX; x <= maxX; x += 4) {
+                if (greaterEqual(Float4::load(row + x), depth).any()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void SoftwareOcclusionCuller::cull(const std::vector<std::unique_ptr<Object>> &objects,
+                                       const glm::mat4 &viewProjection) {
+        PROFILE_ZONE("SoftwareOcclusionCuller::cull");
+        occluders.clear();
+        candidates.resize(objects.size());
+        for (size_t i = 0; i < objects.size(); i++) {
+            const auto &object = objects[i];
+            glm::mat4 transform = object->getTransform();
+            if (object->occluder) {
+                occluders.emplace_back(Occluder{&object->mesh.vertices, &object->mesh.indices, transform});
+            }
+            candidates[i] = OcclusionCandidate{object->mesh.bounds, transform};
+        }
+
+        rasterize(occluders, viewProjection);
+        test(candidates, viewProjection, visibility);
+    }
+
+    bool SoftwareOcclusionCuller::isVisible(size_t objectIndex) const {
+        return objectIndex >= visibility.size() || visibility[objectIndex] != 0;
+    }
+
+    const std::vector<float> &SoftwareOcclusionCuller::getDepthBuffer() const {
+        return depthBuffer;
+    }
+
+    void SoftwareOcclusionCuller::printStatistics() const {
+        std::cout << "software occlusion culling: occluder triangles: " << statistics.occluderTriangles
+                  << ", tested objects: " << statistics.testedObjects
+                  << ", occluded: " << statistics.occludedObjects
+                  << ", rasterizing: " << statistics.rasterizeTime << " ms"
+                  << ", testing: " << statistics.testTime << " ms" << std::endl;
+    }
+}
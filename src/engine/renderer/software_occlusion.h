@@ -0,0 +1,113 @@
+#ifndef SPHERE_SOFTWARE_OCCLUSION_H
+#define SPHERE_SOFTWARE_OCCLUSION_H
+
+#include "types.h"
+#include "thread_pool.h"
+
+#include "glm/mat4x4.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace engine::renderer {
+
+    class Object;
+
+    /*
+     * A mesh that gets rendered into the software depth buffer. Should be a simplified, watertight version of
+     * large geometry such as walls and floors, as every triangle costs CPU time.
+     */
+    struct Occluder {
+        const std::vector<VertexAttributes> *vertices;
+        const std::vector<uint32_t> *indices;
+        glm::mat4 transform;
+    };
+
+    /*
+     * An object that gets tested against the software depth buffer
+     */
+    struct OcclusionCandidate {
+        Bounds bounds;
+        glm::mat4 transform;
+    };
+
+    struct SoftwareOcclusionStatistics {
+        uint32_t occluderTriangles; // triangles that were rasterized (front facing, in front of the near plane)
+        uint32_t testedObjects;
+        uint32_t occludedObjects;
+
+        // in milliseconds
+        float rasterizeTime;
+        float testTime;
+    };
+
+    /*
+     * Renders a small set of designated occluders into a low resolution depth buffer on the CPU, and tests object
+     * bounds against it before any draw commands are recorded. This works without compute support,
+     * which makes it an alternative to the Hi-Z occlusion culler for weak mobile GPUs.
+     *
+     * The depth buffer is split into tiles, and each tile is rasterized by one worker thread, so that
+     * no synchronization is required between threads. Pixels are processed four at a time using SSE or NEON.
+     *
+     * Depth is stored as normalized device coordinates z, where the buffer is cleared to the far plane (1.0)
+     * and smaller values are closer, matching the depth test of the graphics pipelines.
+     */
+    class SoftwareOcclusionCuller {
+
+    public:
+        explicit SoftwareOcclusionCuller(ThreadPool &threadPool, uint32_t width = 320, uint32_t height = 192);
+        ~SoftwareOcclusionCuller();
+
+        SoftwareOcclusionStatistics statistics{};
+
+        // rasterizes the occluders into the depth buffer, after clearing it
+        void rasterize(const std::vector<Occluder> &occluders, const glm::mat4 &viewProjection);
+
+        // writes 1 into visibility for each candidate that is (potentially) visible, and 0 if it is occluded
+        void test(const std::vector<OcclusionCandidate> &candidates, const glm::mat4 &viewProjection,
+                  std::vector<uint8_t> &visibility);
+
+        // rasterizes objects marked as occluder and tests all objects in the scene
+        void cull(const std::vector<std::unique_ptr<Object>> &objects, const glm::mat4 &viewProjection);
+
+        // result of the last call to cull, indexed the same as the objects
+        [[nodiscard]] bool isVisible(size_t objectIndex) const;
+
+        [[nodiscard]] const std::vector<float> &getDepthBuffer() const;
+
+        void printStatistics() const;
+
+    private:
+        struct ScreenTriangle {
+            glm::vec3 v0;
+            glm::vec3 v1;
+            glm::vec3 v2;
+            int minX = 0, minY = 0, maxX = 0, maxY = 0;
+        };
+
+        static constexpr int tileWidth = 64; // multiple of 4 (the SIMD width)
+        static constexpr int tileHeight = 32;
+
+        ThreadPool &threadPool;
+        uint32_t width; // rounded up to a multiple of the tile width
+        uint32_t height;
+        uint32_t tilesX;
+        uint32_t tilesY;
+
+        std::vector<float> depthBuffer;
+        std::vector<float> tileMaxDepth; // farthest depth in each tile, for quickly rejecting candidates
+
+        std::vector<std::vector<ScreenTriangle>> occluderTriangles; // one list per occluder, reused between frames
+        std::vector<Occluder> occluders;
+        std::vector<OcclusionCandidate> candidates;
+        std::vector<uint8_t> visibility;
+
+        void setupTriangles(const Occluder &occluder, const glm::mat4 &viewProjection,
+                            std::vector<ScreenTriangle> &triangles) const;
+        void rasterizeTile(uint32_t tileIndex);
+        void rasterizeTriangle(const ScreenTriangle &triangle, int minX, int minY, int maxX, int maxY);
+        [[nodiscard]] bool isOccluded(const OcclusionCandidate &candidate, const glm::mat4 &viewProjection) const;
+    };
+}
+
+#endif //SPHERE_SOFTWARE_OCCLUSION_H
@@ -1,14 +1,28 @@
 #include "swapchain.h"
 
 #include "vulkan_context.h"
+#include "deletion_queue.h"
+#include "buffer.h"
 #include <vulkan/vk_enum_string_helper.h>
 
+#include <algorithm>
 #include <iostream>
 
 namespace engine::renderer {
 
-    static VkPresentModeKHR pickSwapchainPresentMode(std::vector<VkPresentModeKHR> &surfacePresentModes) {
-        return VK_PRESENT_MODE_FIFO_KHR; // high performance, default
+    /*
+     * FIFO waits for the vertical blank and is always supported. MAILBOX replaces the queued image instead of waiting,
+     * and IMMEDIATE presents without waiting for the vertical blank (tearing), both lower the latency
+     */
+    static VkPresentModeKHR pickSwapchainPresentMode(const std::vector<VkPresentModeKHR> &surfacePresentModes,
+                                                     VkPresentModeKHR preferredPresentMode) {
+        if (std::find(surfacePresentModes.begin(), surfacePresentModes.end(), preferredPresentMode) !=
+            surfacePresentModes.end()) {
+            return preferredPresentMode;
+        }
+        std::cout << "present mode " << string_VkPresentModeKHR(preferredPresentMode)
+                  << " is not supported, using FIFO" << std::endl;
+        return VK_PRESENT_MODE_FIFO_KHR;
     }
 
     /*
@@ -56,20 +70,57 @@ namespace engine::renderer {
         return actualExtent;
     }
 
-    Swapchain::Swapchain(const std::vector<VkSurfaceFormatKHR> &preferredSurfaceFormats) {
+    Swapchain::Swapchain(const std::vector<VkSurfaceFormatKHR> &preferredSurfaceFormats,
+                         VkPresentModeKHR preferredPresentMode) : preferredPresentMode(preferredPresentMode) {
         SurfaceData surfaceData = context->surfaceData;
         surfaceFormat = pickSwapchainSurfaceFormat(surfaceData.surfaceFormats, preferredSurfaceFormats);
-        createSwapchain();
+        imageLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        createSwapchain(VK_NULL_HANDLE);
         createImageViews();
     }
 
+    Swapchain::Swapchain(VkFormat format, VkExtent2D extent, uint32_t imageCount) :
+            surfaceFormat({format, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR}),
+            // nothing waits for a display
+            preferredPresentMode(VK_PRESENT_MODE_IMMEDIATE_KHR),
+            presentMode(VK_PRESENT_MODE_IMMEDIATE_KHR),
+            extent(extent),
+            imageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        createOffscreenImages(imageCount);
+        createImageViews();
+
+        std::cout << "created headless swapchain: " << extent.width << "x" << extent.height << std::endl;
+    }
+
     Swapchain::~Swapchain() {
-        cleanup();
+        for (auto const &framebuffer: framebuffers) {
+            vkDestroyFramebuffer(context->device, framebuffer, nullptr);
+        }
+
+        for (auto const &imageView: imageViews) {
+            vkDestroyImageView(context->device, imageView, nullptr);
+        }
+
+        for (size_t i = 0; i < imageAllocations.size(); i++) {
+            vmaDestroyImage(context->allocator, images[i], imageAllocations[i]);
+        }
+
+        if (swapchain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(context->device, swapchain, nullptr);
+        }
     }
 
-    void Swapchain::createSwapchain() {
+    bool Swapchain::isHeadless() const {
+        return swapchain == VK_NULL_HANDLE;
+    }
+
+    void Swapchain::createSwapchain(VkSwapchainKHR oldSwapchain) {
+        // the surface capabilities contain the current extent of the window, which changes when it is resized
+        checkResult(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(context->physicalDevice, context->surface,
+                                                              &context->surfaceData.surfaceCapabilities));
         SurfaceData surfaceData = context->surfaceData;
         extent = pickSwapchainExtent(context->configuration.window, surfaceData.surfaceCapabilities);
+        presentMode = pickSwapchainPresentMode(surfaceData.surfacePresentModes, preferredPresentMode);
 
         // from vulkan-tutorial.com
         // Sticking to this minimum means that we may sometimes have to wait on the driver to complete internal
@@ -105,9 +156,10 @@ namespace engine::renderer {
                 .pQueueFamilyIndices = oneFamily ? nullptr : queueFamilyIndices,
                 .preTransform = surfaceData.surfaceCapabilities.currentTransform,
                 .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, // ignores the alpha channel when compositing the window with other surfaces on certain window systems.
-                .presentMode = pickSwapchainPresentMode(surfaceData.surfacePresentModes),
+                .presentMode = presentMode,
                 .clipped = VK_TRUE,
-                .oldSwapchain = VK_NULL_HANDLE,
+                // allows the presentation engine to reuse resources of the old swapchain, which gets retired
+                .oldSwapchain = oldSwapchain,
         };
 
         checkResult(vkCreateSwapchainKHR(context->device, &swapchainCreateInfo, nullptr, &swapchain));
@@ -121,6 +173,22 @@ namespace engine::renderer {
         vkGetSwapchainImagesKHR(context->device, swapchain, &swapchainImagesCount, images.data());
     }
 
+    void Swapchain::createOffscreenImages(uint32_t imageCount) {
+        VkImageCreateInfo imageInfo = vk_create::image(surfaceFormat.format, toExtent3D(extent),
+                                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        VmaAllocationCreateInfo allocationInfo{
+                .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+        };
+
+        images.resize(imageCount);
+        imageAllocations.resize(imageCount);
+        for (uint32_t i = 0; i < imageCount; i++) {
+            checkResult(vmaCreateImage(context->allocator, &imageInfo, &allocationInfo,
+                                       &images[i], &imageAllocations[i], nullptr));
+        }
+    }
+
     void Swapchain::createImageViews() {
         imageViews.resize(images.size());
 
@@ -133,19 +201,40 @@ namespace engine::renderer {
         }
     }
 
-    void Swapchain::cleanup() {
-        for (auto const &framebuffer: framebuffers) {
-            vkDestroyFramebuffer(context->device, framebuffer, nullptr);
-        }
+    /*
+     * The commands of the frames in flight could still render into the framebuffers, and their images could
+     * still be queued for presentation, so they get destroyed once those frames have completed
+     */
+    void Swapchain::retire() {
+        retireFramebuffers();
+        deletionQueue->push([oldSwapchain = swapchain, oldImageViews = imageViews]() {
+            for (auto const &imageView: oldImageViews) {
+                vkDestroyImageView(context->device, imageView, nullptr);
+            }
 
-        for (auto const &imageView: imageViews) {
-            vkDestroyImageView(context->device, imageView, nullptr);
-        }
+            vkDestroySwapchainKHR(context->device, oldSwapchain, nullptr);
+        });
+        imageViews.clear();
+    }
 
-        vkDestroySwapchainKHR(context->device, swapchain, nullptr);
+    void Swapchain::retireFramebuffers() {
+        if (framebuffers.empty()) {
+            return;
+        }
+        deletionQueue->push([oldFramebuffers = framebuffers]() {
+            for (auto const &framebuffer: oldFramebuffers) {
+                vkDestroyFramebuffer(context->device, framebuffer, nullptr);
+            }
+        });
+        framebuffers.clear();
     }
 
     void Swapchain::recreate() {
+        if (isHeadless()) {
+            throw std::runtime_error("a headless swapchain has a fixed size and can't be recreated");
+        }
+
+        // a minimized window has no size, there is nothing to present until it is restored
         int width = 0, height = 0;
         glfwGetFramebufferSize(context->configuration.window, &width, &height);
         while (width == 0 || height == 0) {
@@ -153,31 +242,97 @@ namespace engine::renderer {
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(context->device);
-        cleanup();
-        createSwapchain();
+        // the old swapchain is only destroyed later, so it can still be passed to the new swapchain
+        VkSwapchainKHR oldSwapchain = swapchain;
+        retire();
+        createSwapchain(oldSwapchain);
         createImageViews();
-        createFramebuffers();
     }
 
-    void Swapchain::createFramebuffers() {
+    void Swapchain::createFramebuffers(const VkRenderPass &renderPass, const VkImageView &depthImageView) {
         framebuffers.resize(images.size());
 
         for (size_t i = 0; i < imageViews.size(); i++) {
             std::vector<VkImageView> attachments{
                     imageViews[i],
-                    cachedData.depthImageView
+                    depthImageView
             };
-            VkFramebufferCreateInfo framebufferInfo = vk_create::framebuffer(cachedData.renderPass, attachments, extent);
+            VkFramebufferCreateInfo framebufferInfo = vk_create::framebuffer(renderPass, attachments, extent);
             checkResult(vkCreateFramebuffer(context->device, &framebufferInfo, nullptr, &framebuffers[i]));
         }
 
         // std::cout << "created frame buffers" << std::endl;
     }
 
-    void Swapchain::createFramebuffers(const VkRenderPass &renderPass, const VkImageView &depthImageView) {
-        cachedData.renderPass = renderPass;
-        cachedData.depthImageView = depthImageView;
-        createFramebuffers();
+    uint32_t Swapchain::getImageCount() const {
+        return static_cast<uint32_t>(images.size());
+    }
+
+    VkImage Swapchain::getImage(uint32_t imageIndex) const {
+        return images[imageIndex];
+    }
+
+    std::vector<uint8_t> Swapchain::readImage(uint32_t imageIndex) {
+        if (!isHeadless()) {
+            throw std::runtime_error("only the images of a headless swapchain can be read");
+        }
+
+        size_t size = static_cast<size_t>(extent.width) * extent.height * 4;
+        Buffer buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+        context->uploadContext->submit([&](VkCommandBuffer cmd) {
+            // the render pass left the image in the transfer layout, only its writes have to be made visible
+            VkImageMemoryBarrier renderedBarrier{
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                    .oldLayout = imageLayout,
+                    .newLayout = imageLayout,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = images[imageIndex],
+                    .subresourceRange = {
+                            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                            .baseMipLevel = 0,
+                            .levelCount = 1,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1,
+                    },
+            };
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &renderedBarrier);
+
+            VkBufferImageCopy region{
+                    .bufferOffset = 0,
+                    .bufferRowLength = 0, // tightly packed
+                    .bufferImageHeight = 0,
+                    .imageSubresource = {
+                            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                            .mipLevel = 0,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1,
+                    },
+                    .imageOffset = {0, 0, 0},
+                    .imageExtent = toExtent3D(extent),
+            };
+            vkCmdCopyImageToBuffer(cmd, images[imageIndex], imageLayout, buffer.buffer, 1, &region);
+
+            VkBufferMemoryBarrier copiedBarrier{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = buffer.buffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE,
+            };
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                                 0, 0, nullptr, 1, &copiedBarrier, 0, nullptr);
+        });
+
+        std::vector<uint8_t> pixels(size);
+        buffer.read(pixels.data());
+        return pixels;
     }
 }
\ No newline at end of file
@@ -2,7 +2,9 @@
 #define SPHERE_SWAPCHAIN_H
 
 #include "vulkan.h"
+#include "vma.h"
 
+#include <cstdint>
 #include <vector>
 
 namespace engine::renderer {
@@ -24,41 +26,58 @@ namespace engine::renderer {
      *
      * Only one active swapchain can be bound to a surface.
      *
-     * The swapchain should be recreated when the window is resized. For performance, we can use the old swapchain as
-     * a basis for the new swapchain using creatInfo.oldSwapchain.
+     * The swapchain should be recreated when the window is resized. The old swapchain is used as a basis for the new
+     * swapchain using createInfo.oldSwapchain, and is destroyed once the frames in flight are done with it.
      *
      * The application acquires VkImages from the *presentation engine*, which is the platform's compositor or display engine.
      *
      * use presentable image only after vkAcquireNextImageKHR, and before vkQueuePresentKHR
+     *
+     * When headless, there is no surface. The swapchain then owns offscreen images that are rendered into in turn,
+     * and that are read back instead of presented.
      */
     class Swapchain{
 
     public:
-        explicit Swapchain(const std::vector<VkSurfaceFormatKHR> &preferredSurfaceFormats);
+        explicit Swapchain(const std::vector<VkSurfaceFormatKHR> &preferredSurfaceFormats,
+                           VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_FIFO_KHR);
+        // headless, one image per frame in flight, so that no image is rendered into while it is being read
+        explicit Swapchain(VkFormat format, VkExtent2D extent, uint32_t imageCount);
         ~Swapchain();
 
-        VkSwapchainKHR swapchain;
+        VkSwapchainKHR swapchain = VK_NULL_HANDLE; // VK_NULL_HANDLE when headless
         VkSurfaceFormatKHR surfaceFormat;
+        VkPresentModeKHR preferredPresentMode; // used when the swapchain is recreated
+        VkPresentModeKHR presentMode;
         VkExtent2D extent;
+        VkImageLayout imageLayout; // the layout the rendered images are left in, in which they are presented or read
         std::vector<VkFramebuffer> framebuffers;
 
-        void cleanup();
+        [[nodiscard]] bool isHeadless() const;
+
+        // retires the swapchain, its image views and framebuffers to the deletion queue instead of waiting for the
+        // device, the framebuffers should be created again with the resized attachments
         void recreate();
         void createFramebuffers(const VkRenderPass &renderPass, const VkImageView &depthImageView);
+        // e.g. when the depth image is replaced, the frames in flight could still render into the framebuffers
+        void retireFramebuffers();
 
-    private:
-        struct CachedData {
-            VkRenderPass renderPass;
-            VkImageView depthImageView;
-        };
+        [[nodiscard]] uint32_t getImageCount() const;
 
+        [[nodiscard]] VkImage getImage(uint32_t imageIndex) const;
+
+        // headless only, waits for the device and returns the pixels of the image, 4 bytes per pixel without padding
+        std::vector<uint8_t> readImage(uint32_t imageIndex);
+
+    private:
         std::vector<VkImage> images;
         std::vector<VkImageView> imageViews;
-        CachedData cachedData;
+        std::vector<VmaAllocation> imageAllocations; // headless only, otherwise the images are owned by the swapchain
 
-        void createSwapchain();
+        void createSwapchain(VkSwapchainKHR oldSwapchain);
+        void createOffscreenImages(uint32_t imageCount);
         void createImageViews();
-        void createFramebuffers();
+        void retire();
     };
 }
 
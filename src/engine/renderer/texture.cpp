@@ -11,27 +11,34 @@ namespace engine::renderer {
 
     Texture::Texture(const std::string &filePath) {
         int x, y, channelAmount;
-        data = stbi_load(filePath.data(), &x, &y, &channelAmount, STBI_rgb_alpha); // forces 4 8-bit components per pixel
+        unsigned char *data = stbi_load(filePath.data(), &x, &y, &channelAmount, STBI_rgb_alpha); // forces 4 8-bit components per pixel
         // channelAmount will be the original value if it was not forced.
 
         if (data == NULL) {
-            const char *reason = stbi_failure_reason();
-            std::cout << reason << std::endl;
+            throw std::runtime_error(std::string("failed to load image: ") + stbi_failure_reason());
         }
 
-        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
-
         std::cout << "loaded image at: " << filePath << std::endl;
-        std::cout << "x: " << x << ", y: " << y << ", channelAmount: " << channelAmount << ", VkFormat: "
-                  << string_VkFormat(format) << std::endl;
+        std::cout << "x: " << x << ", y: " << y << ", channelAmount: " << channelAmount << std::endl;
+
+        create(data, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+        stbi_image_free(data);
+    }
+
+    Texture::Texture(const unsigned char *pixels, uint32_t width, uint32_t height) {
+        create(pixels, width, height);
+    }
+
+    void Texture::create(const unsigned char *pixels, uint32_t width, uint32_t height) {
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
 
         VkExtent3D extent{
-                .width = static_cast<uint32_t>(x),
-                .height = static_cast<uint32_t>(y),
+                .width = width,
+                .height = height,
                 .depth = 1
         };
 
-        VkDeviceSize sizeInBytes = x * y * 4;//channelAmount; channelAmount is still the original amount instead of the forced 4 channels.
+        VkDeviceSize sizeInBytes = static_cast<VkDeviceSize>(width) * height * 4;
 
         VkBuffer stagingBuffer;
         VmaAllocation stagingBufferAllocation;
@@ -54,10 +61,9 @@ namespace engine::renderer {
 
         void *mappedData;
         vmaMapMemory(context->allocator, stagingBufferAllocation, &mappedData);
-        memcpy(mappedData, data, static_cast<size_t>(sizeInBytes));
+        memcpy(mappedData, pixels, static_cast<size_t>(sizeInBytes));
         //vmaFlushAllocation(allocator, stagingBufferAllocation, 0, VK_WHOLE_SIZE);
         vmaUnmapMemory(context->allocator, stagingBufferAllocation);
-        stbi_image_free(data);
 
         std::cout << "copied data into staging buffer" << std::endl;
 
@@ -216,7 +222,7 @@ namespace engine::renderer {
 
         std::cout << "destroyed staging buffer" << std::endl;
 
-        std::cout << "created texture" << std::endl;
+        std::cout << "created texture with VkFormat: " << string_VkFormat(format) << std::endl;
     }
 
     Texture::~Texture() {
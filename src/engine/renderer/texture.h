@@ -56,6 +56,8 @@ namespace engine::renderer {
 
     public:
         explicit Texture(const std::string &filePath);
+        // pixels should contain width * height RGBA values with 8 bits per channel
+        explicit Texture(const unsigned char *pixels, uint32_t width, uint32_t height);
         ~Texture();
 
         VkImage image;
@@ -63,8 +65,9 @@ namespace engine::renderer {
         VkSampler sampler;
 
     private:
-        unsigned char *data;
         VmaAllocation allocation;
+
+        void create(const unsigned char *pixels, uint32_t width, uint32_t height);
     };
 }
 
@@ -0,0 +1,96 @@
+#include "transform_buffer.h"
+
+#include "vulkan_context.h"
+#include "descriptor_sets.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace engine::renderer {
+
+    TransformBuffer *transformBuffer;
+
+    TransformBuffer::TransformBuffer(uint32_t framesInFlight, size_t initialCapacity) {
+        assert((transformBuffer == nullptr) && "Only one transform buffer can exist at one time");
+        transformBuffer = this;
+
+        descriptorSetLayout = descriptorSetBuilder->getDescriptorSetLayout({
+                {
+                        .binding = 0,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                },
+        });
+
+        std::vector<VkDescriptorSet> descriptorSets = descriptorSetBuilder->createDescriptorSets(descriptorSetLayout,
+                                                                                                 framesInFlight);
+        frames.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            frames[i].descriptorSet = descriptorSets[i];
+            createBuffer(frames[i], std::max(initialCapacity, static_cast<size_t>(1)));
+        }
+
+        std::cout << "created transform buffer" << std::endl;
+    }
+
+    TransformBuffer::~TransformBuffer() {
+        frames.clear();
+    }
+
+    void TransformBuffer::createBuffer(FrameResources &frame, size_t capacity) {
+        frame.buffer = std::make_unique<Buffer>(capacity * sizeof(glm::mat4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                                                VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        frame.transforms = static_cast<glm::mat4 *>(frame.buffer->getMappedData());
+        frame.capacity = capacity;
+
+        // everything has to be written again
+        frame.writtenObjects.assign(capacity, nullptr);
+        frame.writtenVersions.assign(capacity, 0);
+
+        bindBuffer(frame.descriptorSet, frame.buffer->buffer, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+
+    void TransformBuffer::update(uint32_t frameIndex, const std::vector<std::unique_ptr<Object>> &objects) {
+        FrameResources &frame = frames[frameIndex];
+        if (objects.size() > frame.capacity) {
+            // the descriptor set of this frame is not in use, as its commands have completed
+            createBuffer(frame, std::max(objects.size(), frame.capacity * 2));
+        }
+
+        statistics.objects = static_cast<uint32_t>(objects.size());
+        statistics.writtenTransforms = 0;
+        statistics.writtenRanges = 0;
+
+        bool previousWritten = false;
+        for (size_t i = 0; i < objects.size(); i++) {
+            const Object *object = objects[i].get();
+            uint64_t version = object->getTransformVersion();
+            bool changed = frame.writtenObjects[i] != object || frame.writtenVersions[i] != version;
+            if (changed) {
+                // host coherent memory, so no flush is required
+                frame.transforms[i] = object->getTransform();
+                frame.writtenObjects[i] = object;
+                frame.writtenVersions[i] = version;
+
+                statistics.writtenTransforms++;
+                if (!previousWritten) {
+                    statistics.writtenRanges++;
+                }
+            }
+            previousWritten = changed;
+        }
+    }
+
+    VkDescriptorSet TransformBuffer::getDescriptorSet(uint32_t frameIndex) const {
+        return frames[frameIndex].descriptorSet;
+    }
+
+    void TransformBuffer::printStatistics() const {
+        std::cout << "transform buffer: objects: " << statistics.objects
+                  << ", written transforms: " << statistics.writtenTransforms
+                  << " in " << statistics.writtenRanges << " ranges" << std::endl;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef SPHERE_TRANSFORM_BUFFER_H
+#define SPHERE_TRANSFORM_BUFFER_H
+
+#include "vulkan.h"
+#include "buffer.h"
+#include "scene.h"
+
+#include <memory>
+#include <vector>
+
+namespace engine::renderer {
+
+    struct TransformBufferStatistics {
+        uint32_t objects;
+        uint32_t writtenTransforms; // transforms that changed since they were last written into the frame's buffer
+        uint32_t writtenRanges; // contiguous runs of written transforms
+    };
+
+    /*
+     * Contains the transform of each object in a persistently mapped storage buffer, indexed by the object's index
+     * in the scene. Vertex shaders read their transform using the object index in the push constants, so that
+     * drawing an object only pushes 4 bytes instead of a matrix.
+     *
+     * Each frame in flight has its own buffer, as the gpu could still read the buffer of the other frame.
+     * Only the transforms that changed since the buffer was last written are copied.
+     *
+     * The buffer is bound at descriptor set 2 of the material pipelines.
+     */
+    class TransformBuffer {
+
+    public:
+        explicit TransformBuffer(uint32_t framesInFlight, size_t initialCapacity = 1024);
+        ~TransformBuffer();
+
+        VkDescriptorSetLayout descriptorSetLayout; // (owned by the descriptor set builder)
+        TransformBufferStatistics statistics{};
+
+        // should only be called when the commands of the given frame have completed, grows the buffer when required
+        void update(uint32_t frameIndex, const std::vector<std::unique_ptr<Object>> &objects);
+
+        [[nodiscard]] VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const;
+
+        void printStatistics() const;
+
+    private:
+        struct FrameResources {
+            std::unique_ptr<Buffer> buffer;
+            glm::mat4 *transforms = nullptr; // persistently mapped
+            size_t capacity = 0;
+            VkDescriptorSet descriptorSet;
+
+            // what is currently written in each slot, to detect changed transforms and objects
+            std::vector<const Object *> writtenObjects;
+            std::vector<uint64_t> writtenVersions;
+        };
+
+        std::vector<FrameResources> frames;
+
+        static void createBuffer(FrameResources &frame, size_t capacity);
+    };
+
+    extern TransformBuffer *transformBuffer;
+}
+
+#endif //SPHERE_TRANSFORM_BUFFER_H
@@ -10,6 +10,14 @@ namespace engine {
         glm::vec2 uv;
         glm::vec3 normal;
     };
+
+    /*
+     * Axis aligned bounding box in object space
+     */
+    struct Bounds {
+        glm::vec3 min{0, 0, 0};
+        glm::vec3 max{0, 0, 0};
+    };
 }
 
 #endif //SPHERE_TYPES_H
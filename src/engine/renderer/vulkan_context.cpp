@@ -2,7 +2,10 @@
 
 #include "vulkan_context.h"
 #include "utils.h"
+#include "profiler.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <map>
 
@@ -29,9 +32,11 @@ namespace engine::renderer {
 
         createInstance(allRequiredInstanceExtensions, allRequiredInstanceLayers);
         createDebugMessenger();
-        createSurface();
+        if (!isHeadless()) {
+            createSurface();
+        }
         pickPhysicalDevice(configuration.requiredDeviceExtensions);
-        createDevice(configuration.requiredDeviceExtensions);
+        createDevice(configuration.requiredDeviceExtensions, configuration.optionalDeviceExtensions);
         createAllocator();
         uploadContext = std::make_unique<UploadContext>();
         destroyQueue.push([&]() { uploadContext.reset(); });
@@ -42,6 +47,17 @@ namespace engine::renderer {
         context = nullptr;
     }
 
+    bool VulkanContext::isDeviceExtensionEnabled(const char *extensionName) const {
+        return std::any_of(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(),
+                           [extensionName](const char *enabledExtension) -> bool {
+                               return strcmp(enabledExtension, extensionName) == 0;
+                           });
+    }
+
+    bool VulkanContext::isHeadless() const {
+        return configuration.window == nullptr;
+    }
+
     void VulkanContext::createAllocator() {
         VmaAllocatorCreateInfo allocatorInfo{
                 .physicalDevice = physicalDevice,
@@ -76,6 +92,7 @@ namespace engine::renderer {
     }
 
     void UploadContext::submit(std::function<void(VkCommandBuffer)> &&function) {
+        PROFILE_ZONE("UploadContext::submit");
         const VkCommandBuffer &cmd = commandBuffer;
 
         vkDeviceWaitIdle(context->device);
@@ -11,7 +11,7 @@
 namespace engine::renderer {
 
     struct VulkanConfiguration {
-        GLFWwindow *window;
+        GLFWwindow *window; // nullptr for headless rendering, which creates no surface and requires no present support
 
         std::string engineName;
         std::string applicationName;
@@ -24,6 +24,7 @@ namespace engine::renderer {
         std::vector<const char *> requiredInstanceExtensions;
         std::vector<const char *> requiredInstanceLayers;
         std::vector<const char *> requiredDeviceExtensions;
+        std::vector<const char *> optionalDeviceExtensions; // only enabled when supported by the physical device
     };
 
     struct QueueFamilyData {
@@ -38,8 +39,8 @@ namespace engine::renderer {
         std::optional<QueueFamilyData> graphicsQueueFamilyData;
         std::optional<QueueFamilyData> presentQueueFamilyData;
 
-        bool isComplete() {
-            return graphicsQueueFamilyData.has_value() && presentQueueFamilyData.has_value();
+        bool isComplete(bool requiresPresent = true) {
+            return graphicsQueueFamilyData.has_value() && (presentQueueFamilyData.has_value() || !requiresPresent);
         }
     };
 
@@ -49,6 +50,22 @@ namespace engine::renderer {
         std::vector<VkSurfaceFormatKHR> surfaceFormats;
     };
 
+    /*
+     * Optional device features, these are only true when both supported by the physical device and enabled
+     */
+    struct DeviceFeatures {
+        bool conditionalRendering = false; // VK_EXT_conditional_rendering
+        bool occlusionQueryPrecise = false; // core, occlusion queries that return the exact amount of samples
+        bool pipelineStatisticsQuery = false; // core, queries that count vertices, primitives and shader invocations
+        bool graphicsPipelineLibrary = false; // VK_EXT_graphics_pipeline_library (requires VK_KHR_pipeline_library)
+        bool extendedDynamicState = false; // VK_EXT_extended_dynamic_state, for the cull mode and depth state
+        bool extendedDynamicState3Blend = false; // VK_EXT_extended_dynamic_state3, blend enable and color write mask
+        // VK_EXT_descriptor_indexing, for a partially bound, update-after-bind array of sampled images
+        bool descriptorIndexing = false;
+        // VK_KHR_present_wait (requires VK_KHR_present_id), for waiting until a present has been presented
+        bool presentWait = false;
+    };
+
     class UploadContext {
     public:
         explicit UploadContext();
@@ -76,10 +93,17 @@ namespace engine::renderer {
         SurfaceData surfaceData;
         VkDevice device;
         VkQueue graphicsQueue;
-        VkQueue presentQueue;
-        VkSurfaceKHR surface;
+        VkQueue presentQueue = VK_NULL_HANDLE; // VK_NULL_HANDLE when headless
+        VkSurfaceKHR surface = VK_NULL_HANDLE; // VK_NULL_HANDLE when headless
         VmaAllocator allocator;
         std::unique_ptr<UploadContext> uploadContext;
+        std::vector<const char *> enabledDeviceExtensions;
+        DeviceFeatures features;
+
+        [[nodiscard]] bool isDeviceExtensionEnabled(const char *extensionName) const;
+
+        // rendering into offscreen images instead of presenting to a window
+        [[nodiscard]] bool isHeadless() const;
 
     private:
         DestroyQueue destroyQueue;
@@ -88,7 +112,8 @@ namespace engine::renderer {
         void createDebugMessenger();
         void createSurface();
         void pickPhysicalDevice(const std::vector<const char *> &requiredExtensions);
-        void createDevice(const std::vector<const char *> &requiredExtensions);
+        void createDevice(const std::vector<const char *> &requiredExtensions,
+                          const std::vector<const char *> &optionalExtensions);
         void createAllocator();
     };
 
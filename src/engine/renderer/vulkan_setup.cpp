@@ -12,11 +12,12 @@ namespace engine::renderer {
 
     /*
      * Returns the enabled instance extension names based on the required glfw extensions
-     * and custom supplied extensions
+     * and custom supplied extensions. The glfw extensions are not required when headless
      *
      * Also sets flags
      */
     static std::vector<const char *> getEnabledInstanceExtensions(const std::vector<const char *> &requiredExtensions,
+                                                                  bool headless,
                                                                   VkInstanceCreateFlags &flags) {
         std::vector<const char *> enabledExtensions(0);
 
@@ -26,8 +27,11 @@ namespace engine::renderer {
         vkEnumerateInstanceExtensionProperties(nullptr, &extensionsCount, extensions.data());
 
         // vulkan instance extensions required for creating vulkan surfaces for glfw windows.
-        uint32_t glfwRequiredExtensionsCount;
-        const char **glfwRequiredExtensionsArray = glfwGetRequiredInstanceExtensions(&glfwRequiredExtensionsCount);
+        uint32_t glfwRequiredExtensionsCount = 0;
+        const char **glfwRequiredExtensionsArray = nullptr;
+        if (!headless) {
+            glfwRequiredExtensionsArray = glfwGetRequiredInstanceExtensions(&glfwRequiredExtensionsCount);
+        }
 
         std::vector<const char *> allRequiredExtensions;
         allRequiredExtensions.reserve(requiredExtensions.size() + glfwRequiredExtensionsCount);
@@ -100,11 +104,11 @@ namespace engine::renderer {
                 .applicationVersion = configuration.applicationVersion,
                 .pEngineName = configuration.engineName.data(),
                 .engineVersion = configuration.engineVersion,
-                .apiVersion = VK_API_VERSION_1_0,
+                .apiVersion = VK_API_VERSION_1_1, // 1.1 for querying and enabling extension features
         };
 
         VkInstanceCreateFlags flags{};
-        std::vector<const char *> enabledExtensions = getEnabledInstanceExtensions(requiredExtensions, flags);
+        std::vector<const char *> enabledExtensions = getEnabledInstanceExtensions(requiredExtensions, isHeadless(), flags);
         std::vector<const char *> enabledLayers = getEnabledInstanceLayers(requiredLayers);
 
         for (const auto &enabledLayer: enabledLayers) {
@@ -205,6 +209,8 @@ namespace engine::renderer {
      *
      * This could later be refactored to be smarter about which queue to use depending on which one has better performance
      * for that specific supported operation. Also use separate queues for graphics and compute or transfering.
+     *
+     * Without a surface (headless), only the graphics queue family is looked up.
      */
     QueueFamiliesData getQueueFamiliesData(const VkPhysicalDevice &physicalDevice, const VkSurfaceKHR &surface) {
 
@@ -226,8 +232,10 @@ namespace engine::renderer {
                 queueFamiliesData.graphicsQueueFamilyData = data;
             }
 
-            VkBool32 presentSupport;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+            VkBool32 presentSupport = VK_FALSE;
+            if (surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+            }
 
             if (presentSupport) {
                 QueueFamilyData data{};
@@ -237,7 +245,7 @@ namespace engine::renderer {
             }
 
             // if both the present queue index and the graphics queue index are set, stop enumerating.
-            if (queueFamiliesData.isComplete()) {
+            if (queueFamiliesData.isComplete(surface != VK_NULL_HANDLE)) {
                 break;
             }
         }
@@ -271,6 +279,9 @@ namespace engine::renderer {
      *
      * Todo: a list of required / preferred features should be supplied.
      *
+     * Software implementations such as lavapipe are valid, but score lower than any gpu.
+     * When headless (surface is VK_NULL_HANDLE), present support is not required.
+     *
      * @param errorMessage When the physical device does not support a required feature, this string will be populated with the error message.
      * @returns The score. 0 if not valid.
      */
@@ -288,24 +299,31 @@ namespace engine::renderer {
             score += 2000;
         } else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
             score += 1000;
+        } else {
+            score += 1; // e.g. a cpu implementation, which is still better than no device
         }
 
+        bool headless = surface == VK_NULL_HANDLE;
+
         // we need a present and a graphics queue
         QueueFamiliesData queueFamiliesData = getQueueFamiliesData(physicalDevice, surface);
-        if (!queueFamiliesData.isComplete()) {
-            errorMessage = "physical device does not contain both a present and a graphics queue";
+        if (!queueFamiliesData.isComplete(!headless)) {
+            errorMessage = headless ? "physical device does not contain a graphics queue"
+                                    : "physical device does not contain both a present and a graphics queue";
             return 0; // early return
         }
 
         // make sure physical device has support for drawing onto the given surface
-        SurfaceData surfaceData = getSurfaceData(physicalDevice, surface);
+        if (!headless) {
+            SurfaceData surfaceData = getSurfaceData(physicalDevice, surface);
 
-        if (surfaceData.surfaceFormats.empty()) {
-            errorMessage = "physical device has no supported surface formats";
-            return 0;
-        } else if (surfaceData.surfacePresentModes.empty()) {
-            errorMessage = "physical device has no supported present modes";
-            return 0;
+            if (surfaceData.surfaceFormats.empty()) {
+                errorMessage = "physical device has no supported surface formats";
+                return 0;
+            } else if (surfaceData.surfacePresentModes.empty()) {
+                errorMessage = "physical device has no supported present modes";
+                return 0;
+            }
         }
 
         // get physical device features, e.g. robustBufferAccess or geometryShader (all VkBool32)
@@ -391,7 +409,9 @@ namespace engine::renderer {
 
         // cache data
         queueFamiliesData = getQueueFamiliesData(physicalDevice, surface);
-        surfaceData = getSurfaceData(physicalDevice, surface);
+        if (!isHeadless()) {
+            surfaceData = getSurfaceData(physicalDevice, surface);
+        }
 
         // print picked device
         VkPhysicalDeviceProperties properties;
@@ -400,7 +420,8 @@ namespace engine::renderer {
     }
 
     std::vector<const char *>
-    getEnabledDeviceExtensions(VkPhysicalDevice &physicalDevice, const std::vector<const char *> &requiredExtensions) {
+    getEnabledDeviceExtensions(VkPhysicalDevice &physicalDevice, const std::vector<const char *> &requiredExtensions,
+                               const std::vector<const char *> &optionalExtensions) {
 
         // add the required device extensions
         std::vector<const char *> enabledDeviceExtensions(0);
@@ -424,6 +445,17 @@ namespace engine::renderer {
             }
         }
 
+        // add optional device extensions if supported
+        for (const auto &optionalExtension: optionalExtensions) {
+            if (std::any_of(deviceExtensions.begin(),
+                            deviceExtensions.end(),
+                            [&optionalExtension](const VkExtensionProperties &extension) -> bool {
+                                return strcmp(extension.extensionName, optionalExtension) == 0;
+                            })) {
+                enabledDeviceExtensions.push_back(optionalExtension);
+            }
+        }
+
         // VUID-VkDeviceCreateInfo-pProperties-04451: if a physical device supports VK_KHR_portability_subset, it should be added to the ppEnabledExtensionNames.
         if (*std::find_if(
                 deviceExtensions.begin(),
@@ -441,16 +473,20 @@ namespace engine::renderer {
      * Creates a logical device based on the chosen physical device.
      * This is the end of the responsibilities of the device class.
      */
-    void VulkanContext::createDevice(const std::vector<const char *> &requiredExtensions) {
+    void VulkanContext::createDevice(const std::vector<const char *> &requiredExtensions,
+                                     const std::vector<const char *> &optionalExtensions) {
 
         // first create a queue create info for each queue family
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos{};
 
         // uses a map so that no duplicate entries can exist.
         std::map<uint32_t, QueueFamilyData> queueFamilyDataMap = {
-                {queueFamiliesData.presentQueueFamilyData.value().index,  queueFamiliesData.presentQueueFamilyData.value()},
                 {queueFamiliesData.graphicsQueueFamilyData.value().index, queueFamiliesData.graphicsQueueFamilyData.value()}
         };
+        if (queueFamiliesData.presentQueueFamilyData.has_value()) {
+            queueFamilyDataMap.emplace(queueFamiliesData.presentQueueFamilyData->index,
+                                       queueFamiliesData.presentQueueFamilyData.value());
+        }
 
         // Within the same device, queues with higher priority may be allotted more processing time than queues
         // with lower priority, the higher priority queue may also execute fully before executing the lower
@@ -468,16 +504,109 @@ namespace engine::renderer {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        std::vector<const char *> enabledDeviceExtensions = getEnabledDeviceExtensions(physicalDevice,
-                                                                                       requiredExtensions);
+        enabledDeviceExtensions = getEnabledDeviceExtensions(physicalDevice, requiredExtensions, optionalExtensions);
 
         // print enabled device extensions
         for (const auto &enabledDeviceExtension: enabledDeviceExtensions) {
             std::cout << "enabled device extension: " << enabledDeviceExtension << std::endl;
         }
 
+        // query the features of the enabled extensions, the structs are chained into the pNext of features2
+        VkPhysicalDeviceFeatures2 features2{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = nullptr,
+        };
+        VkPhysicalDeviceConditionalRenderingFeaturesEXT conditionalRenderingFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT,
+        };
+        if (isDeviceExtensionEnabled(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME)) {
+            conditionalRenderingFeatures.pNext = features2.pNext;
+            features2.pNext = &conditionalRenderingFeatures;
+        }
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+        };
+        if (isDeviceExtensionEnabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+            isDeviceExtensionEnabled(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+            graphicsPipelineLibraryFeatures.pNext = features2.pNext;
+            features2.pNext = &graphicsPipelineLibraryFeatures;
+        }
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+        };
+        if (isDeviceExtensionEnabled(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+            extendedDynamicStateFeatures.pNext = features2.pNext;
+            features2.pNext = &extendedDynamicStateFeatures;
+        }
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+        };
+        if (isDeviceExtensionEnabled(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+            extendedDynamicState3Features.pNext = features2.pNext;
+            features2.pNext = &extendedDynamicState3Features;
+        }
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+        };
+        if (isDeviceExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+            descriptorIndexingFeatures.pNext = features2.pNext;
+            features2.pNext = &descriptorIndexingFeatures;
+        }
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        };
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        };
+        if (isDeviceExtensionEnabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            isDeviceExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+            presentIdFeatures.pNext = features2.pNext;
+            presentWaitFeatures.pNext = &presentIdFeatures;
+            features2.pNext = &presentWaitFeatures;
+        }
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        // only enable what gets used, as some features (e.g. robustBufferAccess) have a performance cost
+        VkPhysicalDeviceFeatures supportedFeatures = features2.features;
+        features2.features = {};
+        features2.features.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+        features.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise == VK_TRUE;
+        features2.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+        conditionalRenderingFeatures.inheritedConditionalRendering = VK_FALSE;
+        features.conditionalRendering = conditionalRenderingFeatures.conditionalRendering == VK_TRUE;
+        features.graphicsPipelineLibrary = graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+        features.extendedDynamicState = extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+        features.extendedDynamicState3Blend = extendedDynamicState3Features.extendedDynamicState3ColorBlendEnable &&
+                                              extendedDynamicState3Features.extendedDynamicState3ColorWriteMask;
+        // only enable the extended dynamic state 3 features that are used
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT usedExtendedDynamicState3Features{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+                .pNext = extendedDynamicState3Features.pNext,
+                .extendedDynamicState3ColorBlendEnable = extendedDynamicState3Features.extendedDynamicState3ColorBlendEnable,
+                .extendedDynamicState3ColorWriteMask = extendedDynamicState3Features.extendedDynamicState3ColorWriteMask,
+        };
+        extendedDynamicState3Features = usedExtendedDynamicState3Features;
+        // only enable the descriptor indexing features that are used by the bindless texture array
+        features.descriptorIndexing = descriptorIndexingFeatures.runtimeDescriptorArray &&
+                                      descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+                                      descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT usedDescriptorIndexingFeatures{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+                .pNext = descriptorIndexingFeatures.pNext,
+                .descriptorBindingSampledImageUpdateAfterBind = features.descriptorIndexing,
+                .descriptorBindingPartiallyBound = features.descriptorIndexing,
+                .runtimeDescriptorArray = features.descriptorIndexing,
+        };
+        descriptorIndexingFeatures = usedDescriptorIndexingFeatures;
+        // present wait waits for present ids, so it can only be used when both are supported
+        features.presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        presentIdFeatures.presentId = features.presentWait;
+        presentWaitFeatures.presentWait = features.presentWait;
+
         VkDeviceCreateInfo deviceCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+                .pNext = &features2, // replaces pEnabledFeatures
                 .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
                 .pQueueCreateInfos = queueCreateInfos.data(),
                 .enabledExtensionCount = static_cast<uint32_t>(enabledDeviceExtensions.size()),
@@ -493,7 +622,9 @@ namespace engine::renderer {
 
         // get the first queues of the queue families for now.
         vkGetDeviceQueue(device, queueFamiliesData.graphicsQueueFamilyData->index, 0, &graphicsQueue);
-        vkGetDeviceQueue(device, queueFamiliesData.presentQueueFamilyData->index, 0, &presentQueue);
+        if (queueFamiliesData.presentQueueFamilyData.has_value()) {
+            vkGetDeviceQueue(device, queueFamiliesData.presentQueueFamilyData->index, 0, &presentQueue);
+        }
 
         destroyQueue.push([&]() { vkDestroyDevice(device, nullptr); });
 